@@ -1,11 +1,15 @@
 #include "error.h"
 #include "net_socket.h"
+#include "wire_protocol.h"
 #include <fcntl.h>
+#include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
-#define SERV_PORT 20727
+#define SERV_PORT       20727
+#define SERV_LOCAL_PATH "@jfs-server"
 
 struct test_data {
     int  a;
@@ -23,17 +27,86 @@ void print_test_data(const struct test_data *data) {
     printf("}\n");
 }
 
-void run(jfs_err_t *err) { // NOLINT
-    jfs_ns_socket_t *client = jfs_ns_socket_create(err);
+void send_test_data(const jfs_ns_socket_t *sock, const struct test_data *data, jfs_err_t *err) {
+    jfs_wp_meta_t  meta;
+    jfs_wp_frame_t frame;
+
+    jfs_wp_meta_init(&meta);
+    jfs_wp_meta_put_int(&meta, data->a, err);
+    VOID_CHECK_ERR;
+    jfs_wp_meta_put_int(&meta, data->b, err);
+    VOID_CHECK_ERR;
+    jfs_wp_meta_put_int(&meta, data->c, err);
+    VOID_CHECK_ERR;
+    jfs_wp_meta_put_bytes(&meta, data->str, strnlen(data->str, sizeof(data->str)), err);
+    VOID_CHECK_ERR;
+
+    jfs_wp_frame_init(&frame, JFS_WP_META, 0, 0);
+    jfs_wp_frame_add(&frame, meta.buf, meta.len, err);
+    VOID_CHECK_ERR;
+
+    jfs_wp_frame_send(&frame, sock, err);
+    VOID_CHECK_ERR;
+}
+
+void recv_test_data(const jfs_ns_socket_t *sock, struct test_data *data_out, jfs_err_t *err) {
+    jfs_wp_header_t      header;
+    jfs_wp_meta_reader_t reader;
+    uint8_t              body[JFS_WP_META_CAPACITY];
+
+    jfs_wp_recv_header(sock, &header, err);
+    VOID_CHECK_ERR;
+    VOID_FAIL_IF(header.type != JFS_WP_META || header.length > sizeof(body), JFS_ERR_WP_BAD_FRAME);
+
+    (void) jfs_ns_socket_recv(sock, body, header.length, err);
+    VOID_CHECK_ERR;
+
+    size_t str_len = 0;
+    jfs_wp_meta_reader_init(&reader, body, header.length);
+    data_out->a = (int) jfs_wp_meta_get_int(&reader, err);
+    VOID_CHECK_ERR;
+    data_out->b = (int) jfs_wp_meta_get_int(&reader, err);
+    VOID_CHECK_ERR;
+    data_out->c = (int) jfs_wp_meta_get_int(&reader, err);
+    VOID_CHECK_ERR;
+    const uint8_t *str = jfs_wp_meta_get_bytes(&reader, &str_len, err);
+    VOID_CHECK_ERR;
+    VOID_FAIL_IF(str_len >= sizeof(data_out->str), JFS_ERR_WP_BAD_FRAME);
+
+    memcpy(data_out->str, str, str_len);
+    data_out->str[str_len] = '\0';
+}
+
+jfs_ns_socket_t *server_connect(bool local, jfs_err_t *err) {
+    jfs_ns_socket_t *sock = jfs_ns_socket_create(err);
+    NULL_CHECK_ERR;
+
+    if (local) {
+        jfs_ns_socket_set_unix(sock, SERV_LOCAL_PATH, err);
+    } else {
+        jfs_ns_socket_set_hostname(sock, SERV_PORT, "jmax-server.local", err);
+    }
     GOTO_IF_ERR(cleanup);
 
-    jfs_ns_socket_open(client, err);
+    jfs_ns_socket_open(sock, err);
     GOTO_IF_ERR(cleanup);
 
-    jfs_ns_socket_set_hostname(client, SERV_PORT, "jmax-server.local", err);
+    jfs_ns_socket_connect(sock, err);
     GOTO_IF_ERR(cleanup);
 
-    jfs_ns_socket_connect(client, err);
+    return sock;
+cleanup:
+    jfs_ns_socket_destroy(&sock);
+    NULL_RETURN_ERR;
+}
+
+void run(jfs_err_t *err) { // NOLINT
+    // a server on this host is reached over its unix socket, TCP only when there is none
+    jfs_ns_socket_t *client = server_connect(true, err);
+    if (*err != JFS_OK) {
+        IGNORE_ERR;
+        client = server_connect(false, err);
+    }
     GOTO_IF_ERR(cleanup);
     printf("connected\n");
 
@@ -44,11 +117,11 @@ void run(jfs_err_t *err) { // NOLINT
         .str = "hi from over there",
     };
 
-    jfs_ns_socket_send(client, &send_data, sizeof(send_data), 0, err);
+    send_test_data(client, &send_data, err);
     GOTO_IF_ERR(cleanup);
 
     struct test_data recv_data = {0};
-    jfs_ns_socket_recv(client, &recv_data, sizeof(recv_data), err);
+    recv_test_data(client, &recv_data, err);
     GOTO_IF_ERR(cleanup);
     print_test_data(&recv_data);
 
@@ -56,7 +129,7 @@ void run(jfs_err_t *err) { // NOLINT
     GOTO_IF_ERR(cleanup);
 
     while (1) {
-        jfs_ns_socket_recv(client, &recv_data, sizeof(recv_data), err);
+        recv_test_data(client, &recv_data, err);
         if (*err == JFS_ERR_NS_CONNECTION_CLOSE) {
             printf("safe shutdown\n");
             RES_ERR;
@@ -0,0 +1,47 @@
+#ifndef JFS_BLOCK_COMPRESS_H
+#define JFS_BLOCK_COMPRESS_H
+
+#include "error.h"
+#include "net_socket.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define JFS_BC_HEADER_SIZE 9
+
+typedef struct jfs_bc_ctx   jfs_bc_ctx_t;
+typedef struct jfs_bc_block jfs_bc_block_t;
+
+typedef enum {
+    JFS_BC_RAW = 0,
+    JFS_BC_LZ,
+} jfs_bc_kind_t;
+
+struct jfs_bc_ctx {
+    size_t    block_size;
+    size_t    out_capacity;
+    uint8_t  *out_buf;
+    uint32_t *hash_table;
+};
+
+// data points into either the source or the ctx out_buf, valid until the next encode
+struct jfs_bc_block {
+    jfs_bc_kind_t  kind;
+    uint32_t       raw_size;
+    uint32_t       size;
+    const uint8_t *data;
+};
+
+void   jfs_bc_ctx_init(jfs_bc_ctx_t *ctx_init, size_t block_size, jfs_err_t *err);
+void   jfs_bc_ctx_free(jfs_bc_ctx_t *ctx_free);
+size_t jfs_bc_bound(size_t size) WUR;
+
+void   jfs_bc_encode(jfs_bc_ctx_t *ctx, const void *src, size_t size, jfs_bc_block_t *block_out, jfs_err_t *err);
+size_t jfs_bc_decode(const jfs_bc_block_t *block, void *dest, size_t dest_size, jfs_err_t *err);
+
+void   jfs_bc_header_pack(const jfs_bc_block_t *block, uint8_t header[JFS_BC_HEADER_SIZE]);
+void   jfs_bc_header_unpack(jfs_bc_block_t *block_out, const uint8_t header[JFS_BC_HEADER_SIZE], jfs_err_t *err);
+
+void   jfs_bc_send_block(const jfs_ns_socket_t *sock, jfs_bc_ctx_t *ctx, const void *src, size_t size, jfs_err_t *err);
+size_t jfs_bc_recv_block(const jfs_ns_socket_t *sock, jfs_bc_ctx_t *ctx, void *dest, size_t dest_size, jfs_err_t *err);
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef JFS_BUFFER_POOL_H
+#define JFS_BUFFER_POOL_H
+
+#include "error.h"
+#include "file_io_ring.h"
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define JFS_BP_MAX_CLASSES 8
+
+typedef struct jfs_bp      jfs_bp_t; // defined in c file
+typedef struct jfs_bp_conf jfs_bp_conf_t;
+typedef struct jfs_bp_buf  jfs_bp_buf_t;
+
+struct jfs_bp;
+
+// the pool never grows, so the sum of size * count is a hard memory cap
+struct jfs_bp_conf {
+    uint32_t class_count;
+    size_t   size_array[JFS_BP_MAX_CLASSES];  // ascending, rounded up to whole pages
+    uint32_t count_array[JFS_BP_MAX_CLASSES]; // buffers per class
+};
+
+// refcounted view of pool memory, the last jfs_bp_release hands it back
+struct jfs_bp_buf {
+    uint8_t      *data;        // page aligned
+    size_t        capacity;
+    size_t        len;         // bytes in use, set by the holder
+    uint16_t      buf_index;   // JFS_FIO_RING_NO_BUF_INDEX until jfs_bp_register
+    uint8_t       class_index;
+    atomic_uint   refs;
+    jfs_bp_t     *pool;
+    jfs_bp_buf_t *next;        // free list link while pooled
+};
+
+jfs_bp_t *jfs_bp_create(const jfs_bp_conf_t *conf, jfs_err_t *err) WUR;
+void      jfs_bp_destroy(jfs_bp_t *bp_move); // MUST ENSURE every buffer has been released
+void      jfs_bp_register(jfs_bp_t *bp, jfs_fio_ring_t *ring, jfs_err_t *err);
+
+jfs_bp_buf_t *jfs_bp_acquire(jfs_bp_t *bp, size_t size, jfs_err_t *err) WUR;                                // blocks until a buffer is released
+jfs_bp_buf_t *jfs_bp_acquire_unless(jfs_bp_t *bp, size_t size, const atomic_bool *stop, jfs_err_t *err) WUR; // JFS_ERR_EMPTY once stop is set and jfs_bp_wake ran
+jfs_bp_buf_t *jfs_bp_try_acquire(jfs_bp_t *bp, size_t size, jfs_err_t *err) WUR;                            // JFS_ERR_EMPTY when nothing fits
+void          jfs_bp_wake(jfs_bp_t *bp); // waiters look at their stop flag again
+void          jfs_bp_ref(jfs_bp_buf_t *buf);
+void          jfs_bp_release(jfs_bp_buf_t *buf_move);
+void          jfs_bp_ring_req(const jfs_bp_buf_t *buf, jfs_fio_ring_req_t *req);
+
+#endif
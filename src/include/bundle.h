@@ -0,0 +1,56 @@
+#ifndef JFS_BUNDLE_H
+#define JFS_BUNDLE_H
+
+#include "error.h"
+#include "file_io.h"
+#include "file_walk.h"
+#include "net_socket.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define JFS_BD_SEGMENT_HEADER_SIZE 8
+#define JFS_BD_MEMBER_HEADER_SIZE  7
+#define JFS_BD_SMALL_FILE_MAX      ((size_t) 65536) // 64 kb
+
+typedef struct jfs_bd_writer jfs_bd_writer_t;
+typedef struct jfs_bd_reader jfs_bd_reader_t;
+typedef struct jfs_bd_member jfs_bd_member_t;
+
+// segment: u32 member count, u32 payload length, then members
+// member: u8 name length, u32 size, u16 mode, name, data
+struct jfs_bd_writer {
+    size_t   len;
+    size_t   capacity;
+    uint32_t count;
+    uint8_t *buf;
+};
+
+struct jfs_bd_reader {
+    const uint8_t *buf;
+    size_t         len;
+    size_t         cursor;
+    uint32_t       remaining;
+};
+
+struct jfs_bd_member {
+    char           name[NAME_MAX + 1];
+    size_t         name_len;
+    uint32_t       size;
+    mode_t         mode;
+    const uint8_t *data;
+};
+
+void jfs_bd_writer_init(jfs_bd_writer_t *writer_init, size_t capacity, jfs_err_t *err);
+void jfs_bd_writer_free(jfs_bd_writer_t *writer_free);
+void jfs_bd_writer_reset(jfs_bd_writer_t *writer);
+void jfs_bd_writer_add(jfs_bd_writer_t *writer, int dir_fd, const jfs_fio_name_t *name, jfs_err_t *err);
+void jfs_bd_writer_send(jfs_bd_writer_t *writer, const jfs_ns_socket_t *sock, jfs_err_t *err);
+
+void jfs_bd_reader_init(jfs_bd_reader_t *reader_init, const uint8_t *buf, size_t len, jfs_err_t *err);
+int  jfs_bd_reader_next(jfs_bd_reader_t *reader, jfs_bd_member_t *member_out, jfs_err_t *err) WUR;
+void jfs_bd_unpack(jfs_bd_reader_t *reader, const jfs_fio_path_t *dir_path, jfs_err_t *err); // published in batches, atomic per member only
+
+size_t jfs_bd_recv(const jfs_ns_socket_t *sock, uint8_t *buf, size_t capacity, jfs_err_t *err);
+void   jfs_bd_sort_files(jfs_fw_file_t *file_array, size_t file_count);
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef JFS_DURABILITY_H
+#define JFS_DURABILITY_H
+
+#include "error.h"
+#include "file_io.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+typedef struct jfs_dm      jfs_dm_t;
+typedef struct jfs_dm_conf jfs_dm_conf_t;
+typedef struct jfs_dm_file jfs_dm_file_t;
+
+// called once per file after its batch is durable, or with the error that stopped it
+typedef void (*jfs_dm_ack_fn)(void *file_ctx, jfs_err_t file_err, void *ctx);
+
+struct jfs_dm_conf {
+    uint32_t      batch_count;  // zero for default, files held before an automatic commit
+    uint32_t      syncfs_count; // zero for a full batch, batches this big use one syncfs per filesystem, at most batch_count
+    jfs_dm_ack_fn ack;
+    void         *ack_ctx;      // can null
+};
+
+struct jfs_dm_file {
+    int             fd;       // the stage's fd for a staged file
+    int             dir_fd;   // -1 when the directory entry needs no sync
+    bool            own_dir;  // dir_fd was opened for the commit rather than borrowed
+    bool            staged;   // published from stage once its data is durable
+    dev_t           dev;
+    ino_t           dir_ino;  // directories are told apart by inode, staged files each hold their own dir fd
+    jfs_err_t       err;
+    void           *file_ctx;
+    jfs_fio_stage_t stage;
+};
+
+struct jfs_dm {
+    jfs_dm_conf_t  conf;
+    size_t         count;
+    size_t         capacity;
+    jfs_dm_file_t *file_array;
+};
+
+void jfs_dm_init(jfs_dm_t *dm_init, const jfs_dm_conf_t *conf, jfs_err_t *err);
+void jfs_dm_free(jfs_dm_t *dm_free); // MUST ENSURE the last batch was committed
+void jfs_dm_add(jfs_dm_t *dm, int fd_give, int dir_fd, void *file_ctx, jfs_err_t *err);
+void jfs_dm_add_stage(jfs_dm_t *dm, jfs_fio_stage_t *stage_give, void *file_ctx, jfs_err_t *err); // committed by the batch
+void jfs_dm_commit(jfs_dm_t *dm);
+
+#endif
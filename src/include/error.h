@@ -4,9 +4,17 @@
 #include <dirent.h>
 #include <errno.h>
 #include <netdb.h>
+#include <stdint.h>
 #include <string.h>
 #include <sys/stat.h>
 
+struct epoll_event;
+struct io_uring_params;
+struct iovec;
+struct msghdr;
+struct pollfd;
+struct file_clone_range;
+
 // TEMP TEMP TEMP TEMP TEMP TEMP TEMP TEMP TEMP TEMP TEMP TEMP
 #include <stdio.h>
 #define LOG_STR "\033[1;31m%s\033[0m: \033[35m%s\033[0m  errno: %s\n"
@@ -118,6 +126,8 @@
     X(JFS_ERR_ARG)                 \
     X(JFS_ERR_EMPTY)               \
     X(JFS_ERR_FULL)                \
+    X(JFS_ERR_EXIST)               \
+    X(JFS_ERR_IO)                  \
     X(JFS_ERR_BAD_CONF)            \
     X(JFS_ERR_GETADDRINFO)         \
     X(JFS_ERR_LAN_HOST_UNREACH)    \
@@ -131,6 +141,8 @@
     X(JFS_ERR_FIO_NAME_LEN)        \
     X(JFS_ERR_FIO_PATH_OVERFLOW)   \
     X(JFS_ERR_FIO_FILE_END)        \
+    X(JFS_ERR_FIO_RING_BUSY)       \
+    X(JFS_ERR_FIO_UNSUPPORTED)     \
     X(JFS_ERR_FW_STATE)            \
     X(JFS_ERR_FW_SKIP)             \
     X(JFS_ERR_FW_FAIL)             \
@@ -139,7 +151,11 @@
     X(JFS_ERR_NS_BAD_ACCEPT)       \
     X(JFS_ERR_NS_BAD_ADDR)         \
     X(JFS_ERR_NS_CONNECTION_CLOSE) \
-    X(JFS_ERR_BST_BAD_KEY)
+    X(JFS_ERR_BST_BAD_KEY)         \
+    X(JFS_ERR_BC_CORRUPT)          \
+    X(JFS_ERR_BD_CORRUPT)          \
+    X(JFS_ERR_FI_CORRUPT)          \
+    X(JFS_ERR_WP_BAD_FRAME)
 
 typedef enum {
 #define X(name) name,
@@ -152,6 +168,7 @@ const char *jfs_err_str(const jfs_err_t *err);
 void            *jfs_malloc(size_t size, jfs_err_t *err) WUR;
 void            *jfs_realloc(void *ptr, size_t size, jfs_err_t *err) WUR;
 void             jfs_lstat(const char *path, struct stat *stat_init, jfs_err_t *err);
+void             jfs_fstat(int fd, struct stat *stat_init, jfs_err_t *err);
 DIR             *jfs_opendir(const char *path, jfs_err_t *err) WUR;
 void             jfs_shutdown(int sock_fd, int how, jfs_err_t *err);
 struct addrinfo *jfs_getaddrinfo(const char *name, const char *port_str, const struct addrinfo *hints, jfs_err_t *err) WUR;
@@ -161,17 +178,53 @@ int              jfs_accept(int sock_fd, struct sockaddr *addr, socklen_t *addrl
 void             jfs_connect(int sock_fd, const struct sockaddr *addr, socklen_t addrlen, jfs_err_t *err);
 size_t           jfs_recv(int sock_fd, void *buf, size_t size, int flags, jfs_err_t *err) WUR;
 size_t           jfs_send(int sock_fd, const void *buf, size_t size, int flags, jfs_err_t *err) WUR;
+size_t           jfs_sendmsg(int sock_fd, const struct msghdr *msg, int flags, jfs_err_t *err) WUR;
+size_t           jfs_recvmsg(int sock_fd, struct msghdr *msg, int flags, jfs_err_t *err);
 int              jfs_socket(int domain, int type, int protocol, jfs_err_t *err) WUR;
 void             jfs_close(int close_fd, jfs_err_t *err);
 void             jfs_mutex_init(pthread_mutex_t *mutex, const pthread_mutexattr_t *attr, jfs_err_t *err);
 void             jfs_mutex_destroy(pthread_mutex_t *mutex, jfs_err_t *err);
 void             jfs_mutex_trylock(pthread_mutex_t *mutex, jfs_err_t *err);
+void             jfs_pthread_create(pthread_t *thread, const pthread_attr_t *attr, void *(*start)(void *), void *arg, jfs_err_t *err);
+void             jfs_cond_init(pthread_cond_t *cond, const pthread_condattr_t *attr, jfs_err_t *err);
 void             jfs_cond_destroy(pthread_cond_t *cond, jfs_err_t *err);
 void             jfs_cond_timedwait(pthread_cond_t *cond, pthread_mutex_t *mutex, const struct timespec *time, jfs_err_t *err);
 int              jfs_eventfd(unsigned int initval, int flags, jfs_err_t *err) WUR;
+int              jfs_epoll_create1(int flags, jfs_err_t *err) WUR;
+void             jfs_epoll_ctl(int epoll_fd, int op, int fd, struct epoll_event *event, jfs_err_t *err);
+uint32_t         jfs_epoll_wait(int epoll_fd, struct epoll_event *event_array, int max_events, int timeout_ms, jfs_err_t *err) WUR;
+uint32_t         jfs_poll(struct pollfd *poll_array, size_t poll_count, int timeout_ms, jfs_err_t *err) WUR;
+void             jfs_setsockopt(int sock_fd, int level, int name, const void *val, socklen_t val_len, jfs_err_t *err);
+void             jfs_getsockopt(int sock_fd, int level, int name, void *val, socklen_t *val_len, jfs_err_t *err);
 size_t           jfs_read(int fd, void *buf, size_t size, jfs_err_t *err) WUR;
 size_t           jfs_write(int fd, const void *buf, size_t size, jfs_err_t *err) WUR;
+size_t           jfs_pread(int fd, void *buf, size_t size, off_t off, jfs_err_t *err) WUR;
+size_t           jfs_preadv2(int fd, const struct iovec *iov, int iov_count, off_t off, int flags, jfs_err_t *err) WUR;
+size_t           jfs_pwrite(int fd, const void *buf, size_t size, off_t off, jfs_err_t *err) WUR;
+size_t           jfs_copy_file_range(int in_fd, off_t *in_off, int out_fd, off_t *out_off, size_t size, jfs_err_t *err) WUR;
+size_t           jfs_sendfile(int out_fd, int in_fd, off_t *in_off, size_t size, jfs_err_t *err) WUR;
+size_t           jfs_splice(int in_fd, off_t *in_off, int out_fd, off_t *out_off, size_t size, unsigned int flags, jfs_err_t *err) WUR;
+void             jfs_pipe2(int pipe_fd[2], int flags, jfs_err_t *err);
+void             jfs_ficlonerange(int dest_fd, const struct file_clone_range *range, jfs_err_t *err);
+int              jfs_open(const char *path, int flags, mode_t mode, jfs_err_t *err) WUR;
+int              jfs_fcntl(int fd, int cmd, int arg, jfs_err_t *err);
+void             jfs_posix_fadvise(int fd, off_t off, off_t len, int advice, jfs_err_t *err);
+int              jfs_openat(int dir_fd, const char *path, int flags, mode_t mode, jfs_err_t *err) WUR;
+void             jfs_fallocate(int fd, int mode, off_t off, off_t len, jfs_err_t *err);
+void             jfs_ftruncate(int fd, off_t size, jfs_err_t *err);
+void             jfs_fchmod(int fd, mode_t mode, jfs_err_t *err);
+void             jfs_linkat(int old_dir_fd, const char *old_path, int new_dir_fd, const char *new_path, int flags, jfs_err_t *err);
+void             jfs_renameat(int old_dir_fd, const char *old_path, int new_dir_fd, const char *new_path, jfs_err_t *err);
+void             jfs_unlinkat(int dir_fd, const char *path, int flags, jfs_err_t *err);
+off_t            jfs_lseek(int fd, off_t off, int whence, jfs_err_t *err);
+void             jfs_sync_file_range(int fd, off_t off, off_t len, unsigned int flags, jfs_err_t *err);
+void             jfs_fdatasync(int fd, jfs_err_t *err);
+void             jfs_fsync(int fd, jfs_err_t *err);
+void             jfs_syncfs(int fd, jfs_err_t *err);
 void            *jfs_mmap(void *addr, size_t len, int prot, int flags, int fd, off_t off, jfs_err_t *err) WUR;
 void            *jfs_aligned_alloc(size_t align, size_t size, jfs_err_t *err) WUR;
+int              jfs_io_uring_setup(uint32_t entries, struct io_uring_params *params, jfs_err_t *err) WUR;
+uint32_t         jfs_io_uring_enter(int ring_fd, uint32_t to_submit, uint32_t min_complete, uint32_t flags, jfs_err_t *err);
+void             jfs_io_uring_register(int ring_fd, uint32_t opcode, const void *arg, uint32_t nr_args, jfs_err_t *err);
 
 #endif
@@ -0,0 +1,77 @@
+#ifndef JFS_FILE_INDEX_H
+#define JFS_FILE_INDEX_H
+
+#include "error.h"
+#include "file_io.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+#define JFS_FI_HASH_SIZE    32
+#define JFS_FI_HEADER_SIZE  16
+#define JFS_FI_RECORD_SIZE  76
+#define JFS_FI_STATE_MAX    256 // room for a streaming hash midstate and its partial block
+
+typedef struct jfs_fi       jfs_fi_t;
+typedef struct jfs_fi_stat  jfs_fi_stat_t;
+typedef struct jfs_fi_entry jfs_fi_entry_t;
+
+typedef enum { JFS_FI_NEW, JFS_FI_UNCHANGED, JFS_FI_APPENDED, JFS_FI_MODIFIED } jfs_fi_change_t;
+
+struct jfs_fi_stat {
+    uint64_t size;
+    int64_t  mtime_ns;
+    int64_t  ctime_ns;
+    uint64_t inode;
+};
+
+struct jfs_fi_entry {
+    uint64_t      path_offset;
+    uint16_t      path_len;
+    uint16_t      state_len; // stored right after the path, zero when the caller kept none
+    bool          removed;   // dropped on the next commit
+    jfs_fi_stat_t stat;
+    uint8_t       hash[JFS_FI_HASH_SIZE];
+    uint64_t      sample; // jfs_fi_sample of the file at stat.size
+};
+
+// file: u32 magic, u32 version, u64 entry count, then records sorted by path
+// record: u16 path length, u16 state length, u64 size, i64 mtime_ns, i64 ctime_ns, u64 inode, hash, u64 sample, path, state
+// entries [0, sorted_count) are ordered by path, anything after is pending until commit
+struct jfs_fi {
+    size_t          count;
+    size_t          sorted_count;
+    size_t          capacity;
+    jfs_fi_entry_t *entry_array;
+    size_t          path_len;
+    size_t          path_capacity;
+    char           *path_array; // each path followed by its hash state
+    size_t         *slot_array;    // pending entries by path hash, index + 1 with zero for an empty slot
+    size_t          slot_capacity; // power of two, kept at least twice the pending count
+    int64_t         saved_ns;      // when the loaded index was written
+};
+
+void jfs_fi_init(jfs_fi_t *fi_init, jfs_err_t *err);
+void jfs_fi_free(jfs_fi_t *fi_free);
+void jfs_fi_load(jfs_fi_t *fi_init, const char *index_path, jfs_err_t *err);
+void jfs_fi_save(jfs_fi_t *fi, const jfs_fio_path_t *dir_path, const jfs_fio_name_t *name, jfs_err_t *err);
+
+void                  jfs_fi_stat_from(jfs_fi_stat_t *fi_stat_out, const struct stat *sys_stat);
+const jfs_fi_entry_t *jfs_fi_lookup(const jfs_fi_t *fi, const char *path_str, size_t path_len) WUR;
+bool                  jfs_fi_unchanged(const jfs_fi_t *fi, const jfs_fio_path_buf_t *path, const jfs_fi_stat_t *fi_stat, uint8_t *hash_out) WUR;
+uint64_t              jfs_fi_sample(int fd, uint64_t size, jfs_err_t *err) WUR;
+// hash_out is only filled for JFS_FI_UNCHANGED, append_from_out only for JFS_FI_APPENDED
+// JFS_FI_APPENDED trusts sampled blocks of the old range, an edit between them that also grows the file passes for an append
+jfs_fi_change_t jfs_fi_classify(const jfs_fi_t *fi, const jfs_fio_path_buf_t *path, int fd, const jfs_fi_stat_t *fi_stat, uint64_t *append_from_out,
+                                uint8_t *hash_out, jfs_err_t *err) WUR;
+// the hash state stored with the old length, NULL when there is none, resume it over [append_from, size) instead of rehashing the file
+const uint8_t *jfs_fi_hash_state(const jfs_fi_t *fi, const jfs_fio_path_buf_t *path, uint64_t append_from, size_t *state_len_out) WUR;
+
+// state is the caller's resumable hash state after the last byte, NULL with zero length to keep none
+void jfs_fi_update(jfs_fi_t *fi, const jfs_fio_path_buf_t *path, const jfs_fi_stat_t *fi_stat, const uint8_t *hash, uint64_t sample,
+                   const uint8_t *state, size_t state_len, jfs_err_t *err);
+void jfs_fi_remove(jfs_fi_t *fi, const char *path_str, size_t path_len);
+void jfs_fi_commit(jfs_fi_t *fi, jfs_err_t *err);
+
+#endif
@@ -3,11 +3,17 @@
 
 #include "error.h"
 #include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <sys/types.h>
 
 typedef struct jfs_fio_path_buf jfs_fio_path_buf_t;
 typedef struct jfs_fio_path     jfs_fio_path_t;
 typedef struct jfs_fio_name     jfs_fio_name_t;
+typedef struct jfs_fio_bulk     jfs_fio_bulk_t;
+typedef struct jfs_fio_stage    jfs_fio_stage_t;
+typedef struct jfs_fio_extent   jfs_fio_extent_t;
+typedef struct jfs_fio_sparse   jfs_fio_sparse_t;
 
 struct jfs_fio_path_buf {
     size_t len;
@@ -24,8 +30,59 @@ struct jfs_fio_name {
     char  *str;
 };
 
+struct jfs_fio_bulk {
+    int      fd;
+    bool     direct;  // O_DIRECT reads, otherwise buffered with fadvise
+    off_t    offset;  // read cursor
+    off_t    dropped; // pages before this have been dropped from the page cache
+    size_t   buf_size;
+    uint8_t *buf;
+};
+
+struct jfs_fio_stage {
+    int   fd;
+    int   dir_fd;
+    bool  anonymous; // O_TMPFILE with no name until commit
+    bool  own_dir;   // dir_fd is closed with the stage, not for stages made with jfs_fio_stage_init_at
+    off_t size;      // final size, set again on commit in case nothing was preallocated
+    char  name[NAME_MAX + 1];
+    char  tmp_name[NAME_MAX + 1];
+};
+
+struct jfs_fio_extent {
+    off_t offset;
+    off_t len;
+};
+
+struct jfs_fio_sparse {
+    int   fd;
+    off_t cursor;
+    off_t size;
+};
+
 size_t jfs_fio_write(int fd, const void *buf, size_t size, jfs_err_t *err);
 size_t jfs_fio_read(int fd, void *buf, size_t size, jfs_err_t *err);
+size_t jfs_fio_pwrite(int fd, const void *buf, size_t size, off_t off, jfs_err_t *err);
+size_t jfs_fio_pread(int fd, void *buf, size_t size, off_t off, jfs_err_t *err);
+size_t jfs_fio_pread_nowait(int fd, void *buf, size_t size, off_t off, jfs_err_t *err);
+size_t jfs_fio_copy(int dest_fd, off_t dest_off, int src_fd, off_t src_off, size_t size, jfs_err_t *err);
+
+void   jfs_fio_bulk_init(jfs_fio_bulk_t *bulk_init, const char *path_str, size_t buf_size, jfs_err_t *err);
+void   jfs_fio_bulk_free(jfs_fio_bulk_t *bulk_free);
+size_t jfs_fio_bulk_read(jfs_fio_bulk_t *bulk, const uint8_t **data_out, jfs_err_t *err); // JFS_ERR_FIO_FILE_END once drained
+
+void   jfs_fio_stage_init(jfs_fio_stage_t *stage_init, const jfs_fio_path_t *dir_path, const jfs_fio_name_t *name, off_t size, mode_t mode,
+                          jfs_err_t *err);
+// stages against a directory the caller keeps open until the stage is committed or aborted
+void   jfs_fio_stage_init_at(jfs_fio_stage_t *stage_init, int dir_fd, const jfs_fio_name_t *name, off_t size, mode_t mode, jfs_err_t *err);
+void   jfs_fio_stage_finish(const jfs_fio_stage_t *stage, jfs_err_t *err); // sets the final size, commit does it too
+void   jfs_fio_stage_commit(jfs_fio_stage_t *stage_free, jfs_err_t *err);
+void   jfs_fio_stage_abort(jfs_fio_stage_t *stage_free);
+size_t jfs_fio_stage_write(const jfs_fio_stage_t *stage, const void *buf, size_t size, off_t off, jfs_err_t *err);
+void   jfs_fio_stage_hole(const jfs_fio_stage_t *stage, off_t off, off_t len, jfs_err_t *err);
+
+void jfs_fio_sparse_init(jfs_fio_sparse_t *sparse_init, int fd, off_t size);
+int  jfs_fio_sparse_next(jfs_fio_sparse_t *sparse, jfs_fio_extent_t *extent_out, jfs_err_t *err) WUR;
 
 void jfs_fio_path_init(jfs_fio_path_t *path_init, const char *path_str, jfs_err_t *err);
 void jfs_fio_path_free(jfs_fio_path_t *path_free);
@@ -38,5 +95,7 @@ void jfs_fio_name_transfer(jfs_fio_name_t *name_init, jfs_fio_name_t *name_free)
 void jfs_fio_path_buf_clear(jfs_fio_path_buf_t *buf);
 void jfs_fio_path_buf_copy(jfs_fio_path_buf_t *buf, const jfs_fio_path_t *path, jfs_err_t *err);
 void jfs_fio_path_buf_compose(jfs_fio_path_buf_t *buf, const jfs_fio_path_t *path, const jfs_fio_name_t *name, jfs_err_t *err);
+void jfs_fio_path_buf_push(jfs_fio_path_buf_t *buf, const jfs_fio_name_t *name, jfs_err_t *err);
+void jfs_fio_path_buf_pop(jfs_fio_path_buf_t *buf, jfs_err_t *err);
 
 #endif
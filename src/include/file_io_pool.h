@@ -0,0 +1,39 @@
+#ifndef JFS_FILE_IO_POOL_H
+#define JFS_FILE_IO_POOL_H
+
+#include "error.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+typedef struct jfs_fio_pool      jfs_fio_pool_t; // defined in c file
+typedef struct jfs_fio_pool_conf jfs_fio_pool_conf_t;
+typedef struct jfs_fio_pool_req  jfs_fio_pool_req_t;
+
+typedef void (*jfs_fio_pool_done_fn)(jfs_fio_pool_req_t *req, void *ctx);
+
+struct jfs_fio_pool;
+
+struct jfs_fio_pool_conf {
+    uint32_t             thread_count; // zero for default
+    jfs_fio_pool_done_fn done;         // runs on a worker thread for every read that was handed off
+    void                *done_ctx;     // can null
+};
+
+// caller owns the request until it is handed back by done
+struct jfs_fio_pool_req {
+    int                 fd;
+    void               *buf;
+    size_t              size;
+    off_t               offset;
+    size_t              result;   // set on completion
+    jfs_err_t           err;      // set on completion
+    void               *user_ctx; // can null
+    jfs_fio_pool_req_t *next;     // queue link, owned by the pool
+};
+
+jfs_fio_pool_t *jfs_fio_pool_create(const jfs_fio_pool_conf_t *conf, jfs_err_t *err) WUR;
+void            jfs_fio_pool_destroy(jfs_fio_pool_t *pool_move); // finishes queued reads first
+bool            jfs_fio_pool_read(jfs_fio_pool_t *pool, jfs_fio_pool_req_t *req) WUR; // true when served inline, req is filled in either way
+
+#endif
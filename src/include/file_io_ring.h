@@ -0,0 +1,51 @@
+#ifndef JFS_FILE_IO_RING_H
+#define JFS_FILE_IO_RING_H
+
+#include "error.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#define JFS_FIO_RING_NO_BUF_INDEX UINT16_MAX
+
+typedef struct jfs_fio_ring      jfs_fio_ring_t; // defined in c file
+typedef struct jfs_fio_ring_conf jfs_fio_ring_conf_t;
+typedef struct jfs_fio_ring_req  jfs_fio_ring_req_t;
+
+typedef void (*jfs_fio_ring_done_fn)(jfs_fio_ring_req_t *req, void *ctx);
+
+typedef enum { JFS_FIO_RING_READ, JFS_FIO_RING_WRITE } jfs_fio_ring_op_t;
+
+struct jfs_fio_ring;
+
+struct jfs_fio_ring_conf {
+    uint32_t             entries;  // zero for default
+    jfs_fio_ring_done_fn done;     // runs from jfs_fio_ring_reap
+    void                *done_ctx; // can null
+};
+
+// caller owns the request until it is handed back by done
+struct jfs_fio_ring_req {
+    jfs_fio_ring_op_t op;
+    int               fd;         // index into registered files when fixed_file is set
+    bool              fixed_file;
+    uint16_t          buf_index;  // JFS_FIO_RING_NO_BUF_INDEX when buf is not registered
+    void             *buf;
+    size_t            size;
+    off_t             offset;
+    size_t            result;     // set on completion
+    jfs_err_t         err;        // set on completion
+    void             *user_ctx;   // can null
+};
+
+jfs_fio_ring_t *jfs_fio_ring_create(const jfs_fio_ring_conf_t *conf, jfs_err_t *err) WUR;
+void            jfs_fio_ring_destroy(jfs_fio_ring_t *ring_move); // MUST ENSURE nothing is in flight
+void            jfs_fio_ring_register_buffers(jfs_fio_ring_t *ring, const struct iovec *iov_array, uint32_t iov_count, jfs_err_t *err);
+void            jfs_fio_ring_register_files(jfs_fio_ring_t *ring, const int *fd_array, uint32_t fd_count, jfs_err_t *err);
+void            jfs_fio_ring_queue(jfs_fio_ring_t *ring, jfs_fio_ring_req_t *req, jfs_err_t *err);
+uint32_t        jfs_fio_ring_submit(jfs_fio_ring_t *ring, uint32_t wait_count, jfs_err_t *err);
+uint32_t        jfs_fio_ring_reap(jfs_fio_ring_t *ring); // runs done for every completion, never fails
+uint32_t        jfs_fio_ring_in_flight(const jfs_fio_ring_t *ring) WUR;
+
+#endif
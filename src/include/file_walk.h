@@ -2,6 +2,7 @@
 #define JFS_FILE_WALK_H
 
 #include "file_io.h"
+#include "path_table.h"
 #include <dirent.h>
 #include <limits.h>
 #include <sys/types.h>
@@ -23,12 +24,13 @@ struct jfs_fw_file {
 };
 
 struct jfs_fw_dir {
-    jfs_fio_path_t path;
+    jfs_pt_id_t    path_id;
     jfs_fw_file_t *files;
     size_t         file_count;
 };
 
 struct jfs_fw_record {
+    jfs_pt_t      paths;
     size_t        dir_count;
     jfs_fw_dir_t *dir_array;
 };
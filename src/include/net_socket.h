@@ -3,24 +3,158 @@
 
 #include "error.h"
 #include <arpa/inet.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/uio.h>
 
-typedef struct jfs_ns_socket jfs_ns_socket_t;
+#define JFS_NS_EV_READ   0x1U
+#define JFS_NS_EV_WRITE  0x2U
+#define JFS_NS_EV_HANGUP 0x4U // peer closed, readable data may still be pending
+#define JFS_NS_EV_ERROR  0x8U // socket error or error queue data such as zerocopy completions
+
+#define JFS_NS_ZC_MIN_SIZE (16 * 1024) // smaller sends are copied, pinning pages costs more than the copy
+
+typedef struct jfs_ns_socket       jfs_ns_socket_t;
+typedef struct jfs_ns_reactor      jfs_ns_reactor_t; // defined in c file
+typedef struct jfs_ns_read_cursor  jfs_ns_read_cursor_t;
+typedef struct jfs_ns_write_cursor jfs_ns_write_cursor_t;
+typedef struct jfs_ns_splice       jfs_ns_splice_t;
+typedef struct jfs_ns_zc           jfs_ns_zc_t;
+typedef struct jfs_ns_zc_send      jfs_ns_zc_send_t;
+typedef struct jfs_ns_tcp_info     jfs_ns_tcp_info_t;
+typedef struct jfs_ns_tune         jfs_ns_tune_t;
+
+typedef enum {
+    JFS_NS_PHASE_META, // small request / reply exchanges, every write leaves at once
+    JFS_NS_PHASE_BULK, // large transfers, only full segments leave until the phase ends
+} jfs_ns_phase_t;
+
+typedef void (*jfs_ns_event_fn)(jfs_ns_reactor_t *reactor, jfs_ns_socket_t *sock, uint32_t events, void *ctx);
+typedef void (*jfs_ns_timer_fn)(jfs_ns_reactor_t *reactor, void *ctx);
+typedef void (*jfs_ns_zc_done_fn)(void *ctx);
 
 struct jfs_ns_socket;
+struct jfs_ns_reactor;
+
+// resumable receive into one caller buffer, survives any number of JFS_ERR_AGAIN returns
+struct jfs_ns_read_cursor {
+    uint8_t *buf;
+    size_t   size;
+    size_t   received;
+};
+
+// per connection pipe for moving socket data into files without a user space copy
+struct jfs_ns_splice {
+    int    pipe_fd[2];
+    size_t pipe_size;
+};
+
+struct jfs_ns_zc_send {
+    uint32_t          first_id;
+    uint32_t          id_count;
+    uint32_t          remaining;
+    jfs_ns_zc_done_fn done; // can null
+    void             *ctx;
+};
+
+// MSG_ZEROCOPY bookkeeping for one socket, done callbacks run in send order once the kernel lets go of the pages
+struct jfs_ns_zc {
+    bool              enabled; // SO_ZEROCOPY is on, without it the kernel ignores MSG_ZEROCOPY and never notifies
+    uint32_t          next_id; // notification id the kernel gives the next zerocopy sendmsg
+    size_t            head;
+    size_t            count;
+    size_t            capacity;
+    jfs_ns_zc_send_t *send_array; // ring, oldest first
+    uint64_t          copied_count; // sends the kernel ended up copying, loopback always does
+};
+
+// one TCP_INFO sample
+struct jfs_ns_tcp_info {
+    uint32_t rtt_us;
+    uint32_t rtt_var_us;
+    uint32_t mss;
+    uint32_t cwnd;          // segments
+    uint64_t delivery_rate; // bytes per second, zero until the kernel has a sample
+};
 
+// bandwidth-delay product buffer sizing for one connection, kept between samples
+struct jfs_ns_tune {
+    uint32_t          max_buf;      // zero for default
+    uint32_t          buf_size;     // last size applied, zero while the kernel autotuning is still ahead
+    uint32_t          sys_max_buf;  // net.core.wmem_max, read on the first sample
+    uint32_t          sample_count;
+    jfs_ns_tcp_info_t info; // last sample
+};
+
+// resumable gathered send, iov_array is caller memory and is advanced in place
+struct jfs_ns_write_cursor {
+    struct iovec *iov_array;
+    size_t        iov_count;
+    size_t        sent;
+};
+
+// set the address before open, the socket is opened in its family, IPv4 when none is set yet
 jfs_ns_socket_t *jfs_ns_socket_create(jfs_err_t *err) WUR;
 void             jfs_ns_socket_open(jfs_ns_socket_t *sock, jfs_err_t *err);
 void             jfs_ns_socket_close(jfs_ns_socket_t *sock, jfs_err_t *err);
 void             jfs_ns_socket_destroy(jfs_ns_socket_t **sock_give);
 
 void             jfs_ns_socket_shutdown(const jfs_ns_socket_t *sock, jfs_err_t *err);
-void             jfs_ns_socket_set_ip(jfs_ns_socket_t *sock, uint16_t server_port, const char *server_ip, jfs_err_t *err);
+void             jfs_ns_socket_wait_close(const jfs_ns_socket_t *sock, jfs_err_t *err); // after shutdown, blocks until the peer closes too, data from it is an error
+void             jfs_ns_socket_set_ip(jfs_ns_socket_t *sock, uint16_t server_port, const char *server_ip, jfs_err_t *err); // IPv4 or IPv6 literal, "::" listens dual stack
 void             jfs_ns_socket_set_hostname(jfs_ns_socket_t *sock, uint16_t server_port, const char *hostname, jfs_err_t *err);
+void             jfs_ns_socket_set_unix(jfs_ns_socket_t *sock, const char *path, jfs_err_t *err); // leading '@' for the abstract namespace, a stale path has to be unlinked before bind
 void             jfs_ns_socket_bind(const jfs_ns_socket_t *sock, jfs_err_t *err);
+void             jfs_ns_socket_set_nonblock(const jfs_ns_socket_t *sock, jfs_err_t *err);
+void             jfs_ns_socket_set_reuse_port(const jfs_ns_socket_t *sock, jfs_err_t *err); // before bind, lets one listener per thread share a port
 void             jfs_ns_socket_listen(const jfs_ns_socket_t *sock, jfs_err_t *err);
 jfs_ns_socket_t *jfs_ns_socket_accept(const jfs_ns_socket_t *sock, jfs_err_t *err) WUR;
 void             jfs_ns_socket_connect(const jfs_ns_socket_t *sock, jfs_err_t *err);
 size_t           jfs_ns_socket_recv(const jfs_ns_socket_t *sock, void *buf, size_t buf_size, jfs_err_t *err);
 size_t           jfs_ns_socket_send(const jfs_ns_socket_t *sock, const void *buf, size_t buf_size, int flags, jfs_err_t *err);
+size_t           jfs_ns_socket_sendv(const jfs_ns_socket_t *sock, struct iovec *iov_array, size_t iov_count, int flags, jfs_err_t *err);
+size_t           jfs_ns_socket_sendfile(const jfs_ns_socket_t *sock, int file_fd, off_t offset, size_t size, jfs_err_t *err); // partial count on error, resume at offset + count
+
+void   jfs_ns_splice_init(jfs_ns_splice_t *splice_init, jfs_err_t *err);
+void   jfs_ns_splice_free(jfs_ns_splice_t *splice_free);
+size_t jfs_ns_socket_recv_file(const jfs_ns_socket_t *sock, jfs_ns_splice_t *splice, int file_fd, off_t offset, size_t size, jfs_err_t *err); // partial count on error, the splice is unusable after a file error
+
+// the buffer must stay untouched until done runs, a short return does not attach done so pass it again when resuming
+void   jfs_ns_socket_set_zerocopy(const jfs_ns_socket_t *sock, jfs_ns_zc_t *zc, jfs_err_t *err); // send_zc copies until this succeeds
+void   jfs_ns_zc_init(jfs_ns_zc_t *zc_init, size_t capacity, jfs_err_t *err);
+void   jfs_ns_zc_free(jfs_ns_zc_t *zc_free); // pending done callbacks are dropped, wait first
+size_t jfs_ns_socket_send_zc(const jfs_ns_socket_t *sock, jfs_ns_zc_t *zc, const void *buf, size_t buf_size, jfs_ns_zc_done_fn done, void *ctx, jfs_err_t *err);
+void   jfs_ns_zc_reap(const jfs_ns_socket_t *sock, jfs_ns_zc_t *zc, jfs_err_t *err); // on JFS_NS_EV_ERROR, never blocks
+void   jfs_ns_zc_wait(const jfs_ns_socket_t *sock, jfs_ns_zc_t *zc, jfs_err_t *err); // blocks until every send is done
+
+// never block, even on a blocking socket: transfer what the kernel takes now and return JFS_ERR_AGAIN for the rest
+size_t jfs_ns_socket_try_recv(const jfs_ns_socket_t *sock, void *buf, size_t buf_size, jfs_err_t *err);
+size_t jfs_ns_socket_try_send(const jfs_ns_socket_t *sock, const void *buf, size_t buf_size, int flags, jfs_err_t *err);
+size_t jfs_ns_socket_try_sendv(const jfs_ns_socket_t *sock, struct iovec *iov_array, size_t iov_count, int flags, jfs_err_t *err);
+
+// JFS_OK once the whole transfer is done, JFS_ERR_AGAIN to call again on the next readiness event
+void jfs_ns_read_cursor_init(jfs_ns_read_cursor_t *cursor_init, void *buf, size_t size);
+void jfs_ns_read_cursor_recv(const jfs_ns_socket_t *sock, jfs_ns_read_cursor_t *cursor, jfs_err_t *err);
+void jfs_ns_write_cursor_init(jfs_ns_write_cursor_t *cursor_init, struct iovec *iov_array, size_t iov_count);
+void jfs_ns_write_cursor_send(const jfs_ns_socket_t *sock, jfs_ns_write_cursor_t *cursor, int flags, jfs_err_t *err);
+
+// the sending side calls tune every so often during bulk transfers, buffers only ever grow
+void jfs_ns_socket_tcp_info(const jfs_ns_socket_t *sock, jfs_ns_tcp_info_t *info_out, jfs_err_t *err);
+void jfs_ns_tune_init(jfs_ns_tune_t *tune_init, uint32_t max_buf);
+void jfs_ns_socket_tune(const jfs_ns_socket_t *sock, jfs_ns_tune_t *tune, jfs_err_t *err);
+void jfs_ns_socket_set_phase(const jfs_ns_socket_t *sock, jfs_ns_phase_t phase, jfs_err_t *err); // switching to META flushes a held back partial segment
+
+// edge triggered: a callback has to read / write until JFS_ERR_AGAIN before it waits again
+// a socket may only be removed and destroyed from its own callback or from a timer
+jfs_ns_reactor_t *jfs_ns_reactor_create(jfs_err_t *err) WUR;
+void              jfs_ns_reactor_destroy(jfs_ns_reactor_t *reactor_move); // registered sockets are left open
+void              jfs_ns_reactor_add(jfs_ns_reactor_t *reactor, jfs_ns_socket_t *sock, jfs_ns_event_fn on_event, void *ctx, jfs_err_t *err);
+void              jfs_ns_reactor_remove(jfs_ns_reactor_t *reactor, jfs_ns_socket_t *sock, jfs_err_t *err);
+uint64_t          jfs_ns_reactor_timer_add(jfs_ns_reactor_t *reactor, uint64_t delay_ms, jfs_ns_timer_fn on_timer, void *ctx, jfs_err_t *err) WUR; // one shot, ids are never zero
+void              jfs_ns_reactor_timer_cancel(jfs_ns_reactor_t *reactor, uint64_t timer_id); // fired or zero ids are ignored
+void              jfs_ns_reactor_run(jfs_ns_reactor_t *reactor, jfs_err_t *err);             // returns on stop or error
+void              jfs_ns_reactor_stop(jfs_ns_reactor_t *reactor);                            // safe from any thread
 
 #endif
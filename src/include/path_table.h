@@ -0,0 +1,43 @@
+#ifndef JFS_PATH_TABLE_H
+#define JFS_PATH_TABLE_H
+
+#include "error.h"
+#include "file_io.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define JFS_PT_ROOT ((jfs_pt_id_t) 0)
+#define JFS_PT_NONE ((jfs_pt_id_t) UINT32_MAX)
+
+typedef uint32_t          jfs_pt_id_t;
+typedef struct jfs_pt     jfs_pt_t;
+typedef struct jfs_pt_node jfs_pt_node_t;
+
+struct jfs_pt_node {
+    jfs_pt_id_t parent;
+    uint32_t    name_offset;
+    uint16_t    name_len;
+    uint16_t    path_len;
+};
+
+struct jfs_pt {
+    size_t         node_count;
+    size_t         node_capacity;
+    jfs_pt_node_t *node_array;
+    size_t         name_len;
+    size_t         name_capacity;
+    char          *name_array;
+    size_t         slot_capacity; // always a power of two
+    jfs_pt_id_t   *slot_array;
+};
+
+void jfs_pt_init(jfs_pt_t *pt_init, const jfs_fio_path_t *root_path, jfs_err_t *err);
+void jfs_pt_free(jfs_pt_t *pt_free);
+void jfs_pt_transfer(jfs_pt_t *pt_init, jfs_pt_t *pt_free);
+
+jfs_pt_id_t jfs_pt_intern(jfs_pt_t *pt, jfs_pt_id_t parent, const jfs_fio_name_t *name, jfs_err_t *err) WUR;
+jfs_pt_id_t jfs_pt_lookup(const jfs_pt_t *pt, jfs_pt_id_t parent, const jfs_fio_name_t *name) WUR;
+jfs_pt_id_t jfs_pt_parent(const jfs_pt_t *pt, jfs_pt_id_t id) WUR;
+void        jfs_pt_path_buf(const jfs_pt_t *pt, jfs_pt_id_t id, jfs_fio_path_buf_t *buf, jfs_err_t *err);
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef JFS_READ_AHEAD_H
+#define JFS_READ_AHEAD_H
+
+#include "buffer_pool.h"
+#include "error.h"
+#include <stdint.h>
+#include <sys/types.h>
+
+typedef struct jfs_ra      jfs_ra_t; // defined in c file
+typedef struct jfs_ra_conf jfs_ra_conf_t;
+
+struct jfs_ra;
+
+struct jfs_ra_conf {
+    int       fd;         // caller keeps ownership
+    off_t     offset;
+    off_t     size;       // bytes from offset to read
+    size_t    chunk_size; // must fit a pool class
+    uint32_t  depth;      // chunks kept ready ahead of the consumer, zero for default
+    jfs_bp_t *pool;
+};
+
+jfs_ra_t     *jfs_ra_create(const jfs_ra_conf_t *conf, jfs_err_t *err) WUR;
+void          jfs_ra_destroy(jfs_ra_t *ra_move); // MUST ENSURE buffers taken from jfs_ra_next can still be released
+jfs_bp_buf_t *jfs_ra_next(jfs_ra_t *ra, off_t *offset_out, jfs_err_t *err) WUR; // JFS_ERR_FIO_FILE_END once drained
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef JFS_STREAM_MUX_H
+#define JFS_STREAM_MUX_H
+
+#include "error.h"
+#include "net_socket.h"
+#include "wire_protocol.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define JFS_MX_FRAME_MAX (256 * 1024) // largest DATA body either end accepts, whatever its own frame_size
+
+typedef struct jfs_mx       jfs_mx_t; // defined in c file
+typedef struct jfs_mx_conf  jfs_mx_conf_t;
+typedef struct jfs_mx_write jfs_mx_write_t;
+
+typedef void (*jfs_mx_frame_fn)(jfs_mx_t *mx, uint32_t stream_id, jfs_wp_type_t type, const uint8_t *body, size_t len, void *ctx);
+typedef void (*jfs_mx_done_fn)(jfs_mx_t *mx, jfs_mx_write_t *write, void *ctx);
+
+struct jfs_mx;
+
+struct jfs_mx_conf {
+    bool            client;      // the two ends open streams from separate id ranges
+    uint32_t        max_streams; // zero for default, both ends must agree
+    uint32_t        window;      // zero for default, per stream DATA credit, both ends must agree
+    uint32_t        frame_size;  // zero for default, largest DATA body sent, up to JFS_MX_FRAME_MAX, the ends may differ
+    jfs_mx_frame_fn on_frame;    // body is only valid during the call
+    jfs_mx_done_fn  on_done;     // can null
+    void           *ctx;         // can null
+};
+
+// caller owns the write and buf until on_done hands them back
+struct jfs_mx_write {
+    uint32_t        stream_id;
+    jfs_wp_type_t   type; // META, DATA or END, META has to fit one frame
+    const void     *buf;
+    size_t          size;
+    size_t          sent;     // owned by the mux
+    void           *user_ctx; // can null
+    jfs_mx_write_t *next;     // owned by the mux
+};
+
+jfs_mx_t *jfs_mx_create(const jfs_mx_conf_t *conf, jfs_err_t *err) WUR;
+void      jfs_mx_destroy(jfs_mx_t *mx_move); // queued writes are dropped without on_done
+uint32_t  jfs_mx_open(jfs_mx_t *mx, jfs_err_t *err) WUR;
+void      jfs_mx_write(jfs_mx_t *mx, jfs_mx_write_t *write, jfs_err_t *err);
+void      jfs_mx_consume(jfs_mx_t *mx, uint32_t stream_id, size_t size); // received DATA is processed, its credit goes back to the peer
+void      jfs_mx_flush(jfs_mx_t *mx, const jfs_ns_socket_t *sock, jfs_err_t *err); // JFS_ERR_AGAIN when the socket is full
+void      jfs_mx_recv(jfs_mx_t *mx, const jfs_ns_socket_t *sock, jfs_err_t *err);  // JFS_ERR_AGAIN once the socket is drained
+size_t    jfs_mx_stream_count(const jfs_mx_t *mx) WUR;
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef JFS_STRIPE_H
+#define JFS_STRIPE_H
+
+#include "error.h"
+#include "net_socket.h"
+#include <stdint.h>
+
+typedef struct jfs_st_conf  jfs_st_conf_t;
+typedef struct jfs_st_stats jfs_st_stats_t;
+typedef struct jfs_st_hello jfs_st_hello_t;
+
+struct jfs_st_conf {
+    const char *server_ip; // IPv4 or IPv6 literal
+    uint16_t    server_port;
+    int         file_fd;
+    uint64_t    size;
+    uint32_t    transfer_id;
+    uint32_t    min_conns;  // zero for default
+    uint32_t    max_conns;  // zero for default
+    uint64_t    chunk_size; // zero for default, ranges are claimed one chunk at a time
+    uint32_t    sample_ms;  // zero for default, shortest throughput window, stretched to a few round trips
+};
+
+struct jfs_st_stats {
+    uint32_t conn_count; // connections opened, some may have been parked
+    uint64_t sent;
+    uint64_t elapsed_ns;
+};
+
+// first frame on every stripe connection
+struct jfs_st_hello {
+    uint32_t transfer_id;
+    uint64_t size;
+};
+
+// sender: blocks until every range is written and each receiver connection has closed
+void jfs_st_send(const jfs_st_conf_t *conf, jfs_st_stats_t *stats_out, jfs_err_t *err);
+
+// receiver, one thread per accepted connection: hello first, then ranges until END
+void   jfs_st_recv_hello(const jfs_ns_socket_t *sock, jfs_st_hello_t *hello_out, jfs_err_t *err);
+size_t jfs_st_recv_ranges(const jfs_ns_socket_t *sock, jfs_ns_splice_t *splice, int file_fd, uint64_t size, jfs_err_t *err);
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef JFS_WIRE_PROTOCOL_H
+#define JFS_WIRE_PROTOCOL_H
+
+#include "error.h"
+#include "net_socket.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#define JFS_WP_VERSION       1
+#define JFS_WP_HEADER_SIZE   12
+#define JFS_WP_MAX_IOV       8
+#define JFS_WP_META_CAPACITY 4096
+#define JFS_WP_VARINT_MAX    10
+
+typedef struct jfs_wp_header      jfs_wp_header_t;
+typedef struct jfs_wp_frame       jfs_wp_frame_t;
+typedef struct jfs_wp_meta        jfs_wp_meta_t;
+typedef struct jfs_wp_meta_reader jfs_wp_meta_reader_t;
+
+typedef enum { JFS_WP_HELLO = 1, JFS_WP_META, JFS_WP_DATA, JFS_WP_END, JFS_WP_WINDOW } jfs_wp_type_t;
+
+// header: u8 version, u8 type, u16 flags, u32 stream id, u32 body length
+struct jfs_wp_header {
+    uint8_t  version;
+    uint8_t  type;
+    uint16_t flags;
+    uint32_t stream_id;
+    uint32_t length;
+};
+
+// payload iovecs point at caller memory and are only read during jfs_wp_frame_send
+struct jfs_wp_frame {
+    jfs_wp_header_t header;
+    uint8_t         header_buf[JFS_WP_HEADER_SIZE];
+    size_t          iov_count;
+    struct iovec    iov_array[JFS_WP_MAX_IOV + 1]; // the first is always the header
+};
+
+// metadata body: varints, zigzag varints and varint length prefixed bytes
+struct jfs_wp_meta {
+    size_t  len;
+    uint8_t buf[JFS_WP_META_CAPACITY];
+};
+
+struct jfs_wp_meta_reader {
+    const uint8_t *buf;
+    size_t         len;
+    size_t         cursor;
+};
+
+void jfs_wp_header_pack(const jfs_wp_header_t *header, uint8_t *buf);
+void jfs_wp_header_unpack(jfs_wp_header_t *header_out, const uint8_t *buf, jfs_err_t *err);
+void jfs_wp_recv_header(const jfs_ns_socket_t *sock, jfs_wp_header_t *header_out, jfs_err_t *err);
+
+void jfs_wp_frame_init(jfs_wp_frame_t *frame_init, jfs_wp_type_t type, uint32_t stream_id, uint16_t flags);
+void jfs_wp_frame_add(jfs_wp_frame_t *frame, const void *buf, size_t size, jfs_err_t *err);
+void jfs_wp_frame_send(jfs_wp_frame_t *frame, const jfs_ns_socket_t *sock, jfs_err_t *err);
+void jfs_wp_frame_cursor(jfs_wp_frame_t *frame, jfs_ns_write_cursor_t *cursor_init); // for non-blocking sends, frame has to outlive the cursor
+void jfs_wp_frame_send_file(jfs_wp_frame_t *frame, const jfs_ns_socket_t *sock, int file_fd, off_t offset, size_t size, jfs_err_t *err); // file range is the body tail
+
+size_t jfs_wp_varint_put(uint8_t *buf, uint64_t val) WUR; // buf needs JFS_WP_VARINT_MAX bytes
+size_t jfs_wp_varint_get(const uint8_t *buf, size_t len, uint64_t *val_out, jfs_err_t *err) WUR;
+
+void           jfs_wp_meta_init(jfs_wp_meta_t *meta_init);
+void           jfs_wp_meta_put_uint(jfs_wp_meta_t *meta, uint64_t val, jfs_err_t *err);
+void           jfs_wp_meta_put_int(jfs_wp_meta_t *meta, int64_t val, jfs_err_t *err);
+void           jfs_wp_meta_put_bytes(jfs_wp_meta_t *meta, const void *buf, size_t size, jfs_err_t *err);
+void           jfs_wp_meta_reader_init(jfs_wp_meta_reader_t *reader_init, const uint8_t *buf, size_t len);
+uint64_t       jfs_wp_meta_get_uint(jfs_wp_meta_reader_t *reader, jfs_err_t *err) WUR;
+int64_t        jfs_wp_meta_get_int(jfs_wp_meta_reader_t *reader, jfs_err_t *err) WUR;
+const uint8_t *jfs_wp_meta_get_bytes(jfs_wp_meta_reader_t *reader, size_t *size_out, jfs_err_t *err) WUR;
+
+#endif
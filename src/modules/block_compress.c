@@ -0,0 +1,311 @@
+#include "block_compress.h"
+#include "error.h"
+#include "net_socket.h"
+#include <stdlib.h>
+#include <string.h>
+
+// lz4 block format: token, literals, 16 bit offset, match length
+#define BC_HASH_BITS     12
+#define BC_HASH_SIZE     ((size_t) 1 << BC_HASH_BITS)
+#define BC_MIN_MATCH     4
+#define BC_LAST_LITERALS 5
+#define BC_MF_LIMIT      12
+#define BC_MAX_OFFSET    65535
+#define BC_RUN_MASK      15
+#define BC_SKIP_TRIGGER  6
+#define BC_SAMPLE_SIZE   ((size_t) 4096)
+#define BC_MAX_BLOCK     ((size_t) UINT32_MAX / 2)
+
+static size_t   bc_lz_compress(uint32_t *table, const uint8_t *src, size_t size, uint8_t *dest, size_t dest_capacity);
+static size_t   bc_lz_decompress(const uint8_t *src, size_t size, uint8_t *dest, size_t dest_capacity, jfs_err_t *err);
+static int      bc_sample_pays(jfs_bc_ctx_t *ctx, const uint8_t *src, size_t size) WUR;
+static uint8_t *bc_put_length(uint8_t *op, size_t len);
+static uint32_t bc_read32(const uint8_t *ptr) WUR;
+static uint32_t bc_hash(uint32_t seq) WUR;
+static void     bc_put_u32(uint8_t *ptr, uint32_t val);
+static uint32_t bc_get_u32(const uint8_t *ptr) WUR;
+
+void jfs_bc_ctx_init(jfs_bc_ctx_t *ctx_init, size_t block_size, jfs_err_t *err) {
+    VOID_FAIL_IF(block_size == 0 || block_size > BC_MAX_BLOCK, JFS_ERR_ARG);
+
+    const size_t new_capacity = jfs_bc_bound(block_size);
+    uint8_t     *new_out_buf = jfs_malloc(new_capacity, err);
+    VOID_CHECK_ERR;
+
+    uint32_t *new_table = jfs_malloc(sizeof(*new_table) * BC_HASH_SIZE, err);
+    if (*err != JFS_OK) {
+        free(new_out_buf);
+        VOID_RETURN_ERR;
+    }
+
+    ctx_init->block_size = block_size;
+    ctx_init->out_capacity = new_capacity;
+    ctx_init->out_buf = new_out_buf;
+    ctx_init->hash_table = new_table;
+}
+
+void jfs_bc_ctx_free(jfs_bc_ctx_t *ctx_free) {
+    free(ctx_free->out_buf);
+    free(ctx_free->hash_table);
+    memset(ctx_free, 0, sizeof(*ctx_free));
+}
+
+size_t jfs_bc_bound(size_t size) {
+    return size + (size / 255) + 16; // NOLINT
+}
+
+void jfs_bc_encode(jfs_bc_ctx_t *ctx, const void *src, size_t size, jfs_bc_block_t *block_out, jfs_err_t *err) {
+    VOID_FAIL_IF(size > ctx->block_size, JFS_ERR_ARG);
+
+    const uint8_t *src_bytes = src;
+    block_out->kind = JFS_BC_RAW;
+    block_out->raw_size = (uint32_t) size;
+    block_out->size = (uint32_t) size;
+    block_out->data = src_bytes;
+
+    if (!bc_sample_pays(ctx, src_bytes, size)) return;
+
+    // anything that doesn't shrink is sent raw, so the output is capped below the input size
+    const size_t packed = bc_lz_compress(ctx->hash_table, src_bytes, size, ctx->out_buf, size - 1);
+    if (packed == 0) return;
+
+    block_out->kind = JFS_BC_LZ;
+    block_out->size = (uint32_t) packed;
+    block_out->data = ctx->out_buf;
+}
+
+size_t jfs_bc_decode(const jfs_bc_block_t *block, void *dest, size_t dest_size, jfs_err_t *err) {
+    VAL_FAIL_IF(block->raw_size > dest_size, JFS_ERR_ARG, 0);
+
+    switch (block->kind) {
+        case JFS_BC_RAW:
+            VAL_FAIL_IF(block->size != block->raw_size, JFS_ERR_BC_CORRUPT, 0);
+            if (block->data != dest) memmove(dest, block->data, block->size);
+            return block->size;
+        case JFS_BC_LZ: {
+            const size_t out = bc_lz_decompress(block->data, block->size, dest, block->raw_size, err);
+            VAL_CHECK_ERR(0);
+            VAL_FAIL_IF(out != block->raw_size, JFS_ERR_BC_CORRUPT, 0);
+            return out;
+        }
+        default: *err = JFS_ERR_BC_CORRUPT; VAL_RETURN_ERR(0);
+    }
+}
+
+void jfs_bc_header_pack(const jfs_bc_block_t *block, uint8_t header[JFS_BC_HEADER_SIZE]) {
+    header[0] = (uint8_t) block->kind;
+    bc_put_u32(header + 1, block->raw_size);
+    bc_put_u32(header + 5, block->size); // NOLINT
+}
+
+void jfs_bc_header_unpack(jfs_bc_block_t *block_out, const uint8_t header[JFS_BC_HEADER_SIZE], jfs_err_t *err) {
+    VOID_FAIL_IF(header[0] != JFS_BC_RAW && header[0] != JFS_BC_LZ, JFS_ERR_BC_CORRUPT);
+
+    block_out->kind = (jfs_bc_kind_t) header[0];
+    block_out->raw_size = bc_get_u32(header + 1);
+    block_out->size = bc_get_u32(header + 5); // NOLINT
+    block_out->data = NULL;
+}
+
+void jfs_bc_send_block(const jfs_ns_socket_t *sock, jfs_bc_ctx_t *ctx, const void *src, size_t size, jfs_err_t *err) {
+    jfs_bc_block_t block = {0};
+    uint8_t        header[JFS_BC_HEADER_SIZE];
+
+    jfs_bc_encode(ctx, src, size, &block, err);
+    VOID_CHECK_ERR;
+    jfs_bc_header_pack(&block, header);
+
+    jfs_ns_socket_send(sock, header, sizeof(header), MSG_MORE, err);
+    VOID_CHECK_ERR;
+
+    jfs_ns_socket_send(sock, block.data, block.size, 0, err);
+    VOID_CHECK_ERR;
+}
+
+size_t jfs_bc_recv_block(const jfs_ns_socket_t *sock, jfs_bc_ctx_t *ctx, void *dest, size_t dest_size, jfs_err_t *err) {
+    jfs_bc_block_t block = {0};
+    uint8_t        header[JFS_BC_HEADER_SIZE];
+
+    jfs_ns_socket_recv(sock, header, sizeof(header), err);
+    VAL_CHECK_ERR(0);
+
+    jfs_bc_header_unpack(&block, header, err);
+    VAL_CHECK_ERR(0);
+    VAL_FAIL_IF(block.raw_size > dest_size || block.raw_size > ctx->block_size, JFS_ERR_ARG, 0);
+    VAL_FAIL_IF(block.size > ctx->out_capacity, JFS_ERR_BC_CORRUPT, 0);
+    // a raw payload is received straight into dest, so its size has to be checked before the recv
+    VAL_FAIL_IF(block.kind == JFS_BC_RAW && block.size != block.raw_size, JFS_ERR_BC_CORRUPT, 0);
+
+    // raw blocks land directly in dest, compressed ones go through the ctx buffer
+    uint8_t *payload = block.kind == JFS_BC_RAW ? dest : ctx->out_buf;
+    jfs_ns_socket_recv(sock, payload, block.size, err);
+    VAL_CHECK_ERR(0);
+    block.data = payload;
+
+    const size_t out = jfs_bc_decode(&block, dest, dest_size, err);
+    VAL_CHECK_ERR(0);
+    return out;
+}
+
+static size_t bc_lz_compress(uint32_t *table, const uint8_t *src, size_t size, uint8_t *dest, size_t dest_capacity) { // NOLINT
+    const uint8_t *ip = src;
+    const uint8_t *anchor = src;
+    const uint8_t *const end = src + size;
+    uint8_t             *op = dest;
+    uint8_t *const       op_end = dest + dest_capacity;
+
+    if (size > BC_MF_LIMIT) {
+        const uint8_t *const match_limit = end - BC_LAST_LITERALS;
+        const uint8_t *const mf_limit = end - BC_MF_LIMIT;
+        uint32_t             search_count = 1 << BC_SKIP_TRIGGER;
+
+        memset(table, 0, sizeof(*table) * BC_HASH_SIZE);
+        while (ip < mf_limit) {
+            const uint32_t seq = bc_read32(ip);
+            const uint32_t hash = bc_hash(seq);
+            const uint8_t *ref = src + table[hash];
+            table[hash] = (uint32_t) (ip - src);
+
+            if (ref >= ip || ip - ref > BC_MAX_OFFSET || bc_read32(ref) != seq) {
+                // step further the longer nothing matches so incompressible runs stay cheap
+                ip += search_count++ >> BC_SKIP_TRIGGER;
+                continue;
+            }
+            search_count = 1 << BC_SKIP_TRIGGER;
+
+            while (ip > anchor && ref > src && ip[-1] == ref[-1]) {
+                ip--;
+                ref--;
+            }
+
+            const uint8_t *match_end = ip + BC_MIN_MATCH;
+            const uint8_t *ref_end = ref + BC_MIN_MATCH;
+            while (match_end < match_limit && *match_end == *ref_end) {
+                match_end++;
+                ref_end++;
+            }
+
+            const size_t lit_len = (size_t) (ip - anchor);
+            const size_t match_len = (size_t) (match_end - ip) - BC_MIN_MATCH;
+            if ((size_t) (op_end - op) < 1 + (lit_len / 255) + 1 + lit_len + 2 + (match_len / 255) + 1) return 0; // NOLINT
+
+            uint8_t *token = op++;
+            *token = (uint8_t) ((lit_len >= BC_RUN_MASK ? BC_RUN_MASK : lit_len) << 4);
+            if (lit_len >= BC_RUN_MASK) op = bc_put_length(op, lit_len - BC_RUN_MASK);
+            memcpy(op, anchor, lit_len);
+            op += lit_len;
+
+            const size_t offset = (size_t) (ip - ref);
+            *op++ = (uint8_t) (offset & 0xFF);  // NOLINT
+            *op++ = (uint8_t) (offset >> 8);    // NOLINT
+            *token |= (uint8_t) (match_len >= BC_RUN_MASK ? BC_RUN_MASK : match_len);
+            if (match_len >= BC_RUN_MASK) op = bc_put_length(op, match_len - BC_RUN_MASK);
+
+            ip = match_end;
+            anchor = ip;
+        }
+    }
+
+    const size_t lit_len = (size_t) (end - anchor);
+    if ((size_t) (op_end - op) < 1 + (lit_len / 255) + 1 + lit_len) return 0; // NOLINT
+
+    uint8_t *token = op++;
+    *token = (uint8_t) ((lit_len >= BC_RUN_MASK ? BC_RUN_MASK : lit_len) << 4);
+    if (lit_len >= BC_RUN_MASK) op = bc_put_length(op, lit_len - BC_RUN_MASK);
+    memcpy(op, anchor, lit_len);
+    op += lit_len;
+
+    return (size_t) (op - dest);
+}
+
+static size_t bc_lz_decompress(const uint8_t *src, size_t size, uint8_t *dest, size_t dest_capacity, jfs_err_t *err) { // NOLINT
+    const uint8_t *ip = src;
+    const uint8_t *const ip_end = src + size;
+    uint8_t             *op = dest;
+    uint8_t *const       op_end = dest + dest_capacity;
+
+    while (ip < ip_end) {
+        const uint8_t token = *ip++;
+
+        size_t lit_len = token >> 4;
+        if (lit_len == BC_RUN_MASK) {
+            uint8_t extra = 0;
+            do {
+                VAL_FAIL_IF(ip >= ip_end, JFS_ERR_BC_CORRUPT, 0);
+                extra = *ip++;
+                lit_len += extra;
+            } while (extra == 255); // NOLINT
+        }
+        VAL_FAIL_IF(lit_len > (size_t) (ip_end - ip) || lit_len > (size_t) (op_end - op), JFS_ERR_BC_CORRUPT, 0);
+        memcpy(op, ip, lit_len);
+        ip += lit_len;
+        op += lit_len;
+
+        if (ip == ip_end) break; // the last sequence only has literals
+
+        VAL_FAIL_IF(ip_end - ip < 2, JFS_ERR_BC_CORRUPT, 0);
+        const size_t offset = (size_t) ip[0] | ((size_t) ip[1] << 8); // NOLINT
+        ip += 2;
+        VAL_FAIL_IF(offset == 0 || offset > (size_t) (op - dest), JFS_ERR_BC_CORRUPT, 0);
+
+        size_t match_len = token & BC_RUN_MASK;
+        if (match_len == BC_RUN_MASK) {
+            uint8_t extra = 0;
+            do {
+                VAL_FAIL_IF(ip >= ip_end, JFS_ERR_BC_CORRUPT, 0);
+                extra = *ip++;
+                match_len += extra;
+            } while (extra == 255); // NOLINT
+        }
+        match_len += BC_MIN_MATCH;
+        VAL_FAIL_IF(match_len > (size_t) (op_end - op), JFS_ERR_BC_CORRUPT, 0);
+
+        const uint8_t *ref = op - offset;
+        for (size_t i = 0; i < match_len; i++) { // matches may overlap their own output
+            op[i] = ref[i];
+        }
+        op += match_len;
+    }
+
+    return (size_t) (op - dest);
+}
+
+static int bc_sample_pays(jfs_bc_ctx_t *ctx, const uint8_t *src, size_t size) {
+    if (size <= BC_MF_LIMIT) return 0;
+    if (size <= BC_SAMPLE_SIZE) return 1;
+
+    // already compressed data won't save an eighth of the sample, so skip the full pass
+    const size_t sample_limit = BC_SAMPLE_SIZE - (BC_SAMPLE_SIZE / 8); // NOLINT
+    const size_t packed = bc_lz_compress(ctx->hash_table, src, BC_SAMPLE_SIZE, ctx->out_buf, sample_limit);
+    return packed != 0;
+}
+
+static uint8_t *bc_put_length(uint8_t *op, size_t len) {
+    while (len >= 255) { // NOLINT
+        *op++ = 255;     // NOLINT
+        len -= 255;      // NOLINT
+    }
+    *op++ = (uint8_t) len;
+    return op;
+}
+
+static uint32_t bc_read32(const uint8_t *ptr) {
+    uint32_t val = 0;
+    memcpy(&val, ptr, sizeof(val));
+    return val;
+}
+
+static uint32_t bc_hash(uint32_t seq) {
+    return (seq * 2654435761U) >> (32 - BC_HASH_BITS); // NOLINT
+}
+
+static void bc_put_u32(uint8_t *ptr, uint32_t val) {
+    ptr[0] = (uint8_t) val;
+    ptr[1] = (uint8_t) (val >> 8);  // NOLINT
+    ptr[2] = (uint8_t) (val >> 16); // NOLINT
+    ptr[3] = (uint8_t) (val >> 24); // NOLINT
+}
+
+static uint32_t bc_get_u32(const uint8_t *ptr) {
+    return (uint32_t) ptr[0] | ((uint32_t) ptr[1] << 8) | ((uint32_t) ptr[2] << 16) | ((uint32_t) ptr[3] << 24); // NOLINT
+}
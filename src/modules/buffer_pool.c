@@ -0,0 +1,199 @@
+#include "buffer_pool.h"
+#include "error.h"
+#include "file_io_ring.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#define BP_PAGE_SIZE ((size_t) 4096) // 4 kb
+
+struct jfs_bp {
+    pthread_mutex_t lock;
+    pthread_cond_t  released;
+    uint32_t        class_count;
+    size_t          class_size_array[JFS_BP_MAX_CLASSES];
+    jfs_bp_buf_t   *free_array[JFS_BP_MAX_CLASSES];
+    size_t          buf_count;
+    jfs_bp_buf_t   *buf_array;
+    uint8_t        *region;
+    size_t          region_size;
+};
+
+static jfs_bp_buf_t *bp_take(jfs_bp_t *bp, size_t size) WUR;
+
+jfs_bp_t *jfs_bp_create(const jfs_bp_conf_t *conf, jfs_err_t *err) {
+    NULL_FAIL_IF(conf->class_count == 0 || conf->class_count > JFS_BP_MAX_CLASSES, JFS_ERR_ARG);
+
+    size_t page_size = (size_t) sysconf(_SC_PAGESIZE);
+    if (page_size == 0 || page_size == (size_t) -1) page_size = BP_PAGE_SIZE;
+
+    jfs_bp_t *bp = jfs_malloc(sizeof(*bp), err);
+    NULL_CHECK_ERR;
+    memset(bp, 0, sizeof(*bp));
+    bp->class_count = conf->class_count;
+
+    for (uint32_t i = 0; i < conf->class_count; i++) {
+        if (conf->size_array[i] > SIZE_MAX - page_size) GOTO_WITH_ERR(cleanup_bp, JFS_ERR_ARG);
+        const size_t size = (conf->size_array[i] + page_size - 1) & ~(page_size - 1);
+        if (size == 0 || conf->count_array[i] == 0) GOTO_WITH_ERR(cleanup_bp, JFS_ERR_ARG);
+        if (i > 0 && size <= bp->class_size_array[i - 1]) GOTO_WITH_ERR(cleanup_bp, JFS_ERR_ARG);
+        // the region is sized from these, a wrapped total would map less than the buffers cover
+        if (conf->count_array[i] > (SIZE_MAX - bp->region_size) / size) GOTO_WITH_ERR(cleanup_bp, JFS_ERR_ARG);
+        bp->class_size_array[i] = size;
+        bp->buf_count += conf->count_array[i];
+        bp->region_size += size * conf->count_array[i];
+    }
+
+    bp->buf_array = jfs_malloc(sizeof(*bp->buf_array) * bp->buf_count, err);
+    GOTO_IF_ERR(cleanup_bp);
+
+    // one mapping keeps every buffer page aligned and lets io_uring pin it in one go
+    bp->region = jfs_mmap(NULL, bp->region_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0, err);
+    GOTO_IF_ERR(cleanup_bufs);
+
+    jfs_mutex_init(&bp->lock, NULL, err);
+    GOTO_IF_ERR(cleanup_region);
+    jfs_cond_init(&bp->released, NULL, err);
+    GOTO_IF_ERR(cleanup_lock);
+
+    size_t   index = 0;
+    uint8_t *data = bp->region;
+    for (uint32_t i = 0; i < bp->class_count; i++) {
+        for (uint32_t j = 0; j < conf->count_array[i]; j++) {
+            jfs_bp_buf_t *buf = &bp->buf_array[index++];
+            buf->data = data;
+            buf->capacity = bp->class_size_array[i];
+            buf->len = 0;
+            buf->buf_index = JFS_FIO_RING_NO_BUF_INDEX;
+            buf->class_index = (uint8_t) i;
+            atomic_init(&buf->refs, 0);
+            buf->pool = bp;
+            buf->next = bp->free_array[i];
+            bp->free_array[i] = buf;
+            data += buf->capacity;
+        }
+    }
+
+    return bp;
+cleanup_lock:
+    pthread_mutex_destroy(&bp->lock);
+cleanup_region:
+    munmap(bp->region, bp->region_size);
+cleanup_bufs:
+    free(bp->buf_array);
+cleanup_bp:
+    free(bp);
+    NULL_RETURN_ERR;
+}
+
+void jfs_bp_destroy(jfs_bp_t *bp_move) {
+    pthread_cond_destroy(&bp_move->released);
+    pthread_mutex_destroy(&bp_move->lock);
+    munmap(bp_move->region, bp_move->region_size);
+    free(bp_move->buf_array);
+    free(bp_move);
+}
+
+void jfs_bp_register(jfs_bp_t *bp, jfs_fio_ring_t *ring, jfs_err_t *err) {
+    VOID_FAIL_IF(bp->buf_count >= JFS_FIO_RING_NO_BUF_INDEX, JFS_ERR_ARG);
+
+    struct iovec *iov_array = jfs_malloc(sizeof(*iov_array) * bp->buf_count, err);
+    VOID_CHECK_ERR;
+
+    for (size_t i = 0; i < bp->buf_count; i++) {
+        iov_array[i].iov_base = bp->buf_array[i].data;
+        iov_array[i].iov_len = bp->buf_array[i].capacity;
+    }
+
+    jfs_fio_ring_register_buffers(ring, iov_array, (uint32_t) bp->buf_count, err);
+    free(iov_array);
+    VOID_CHECK_ERR;
+
+    // buffers can be out on loan here, buf_index is only read by whoever holds a reference
+    for (size_t i = 0; i < bp->buf_count; i++) {
+        bp->buf_array[i].buf_index = (uint16_t) i;
+    }
+}
+
+jfs_bp_buf_t *jfs_bp_acquire(jfs_bp_t *bp, size_t size, jfs_err_t *err) {
+    return jfs_bp_acquire_unless(bp, size, NULL, err);
+}
+
+jfs_bp_buf_t *jfs_bp_acquire_unless(jfs_bp_t *bp, size_t size, const atomic_bool *stop, jfs_err_t *err) {
+    NULL_FAIL_IF(size > bp->class_size_array[bp->class_count - 1], JFS_ERR_ARG);
+
+    // stop is read under the lock, a jfs_bp_wake after setting it cannot slip in before the wait
+    pthread_mutex_lock(&bp->lock);
+    jfs_bp_buf_t *buf = bp_take(bp, size);
+    while (buf == NULL && (stop == NULL || !atomic_load(stop))) {
+        pthread_cond_wait(&bp->released, &bp->lock);
+        buf = bp_take(bp, size);
+    }
+    pthread_mutex_unlock(&bp->lock);
+
+    NULL_FAIL_IF(buf == NULL, JFS_ERR_EMPTY);
+    return buf;
+}
+
+jfs_bp_buf_t *jfs_bp_try_acquire(jfs_bp_t *bp, size_t size, jfs_err_t *err) {
+    NULL_FAIL_IF(size > bp->class_size_array[bp->class_count - 1], JFS_ERR_ARG);
+
+    pthread_mutex_lock(&bp->lock);
+    jfs_bp_buf_t *buf = bp_take(bp, size);
+    pthread_mutex_unlock(&bp->lock);
+
+    NULL_FAIL_IF(buf == NULL, JFS_ERR_EMPTY);
+    return buf;
+}
+
+void jfs_bp_wake(jfs_bp_t *bp) {
+    pthread_mutex_lock(&bp->lock);
+    pthread_cond_broadcast(&bp->released);
+    pthread_mutex_unlock(&bp->lock);
+}
+
+void jfs_bp_ref(jfs_bp_buf_t *buf) {
+    atomic_fetch_add_explicit(&buf->refs, 1, memory_order_relaxed);
+}
+
+void jfs_bp_release(jfs_bp_buf_t *buf_move) {
+    // acq_rel so every holder's writes are visible before the buffer is handed out again
+    if (atomic_fetch_sub_explicit(&buf_move->refs, 1, memory_order_acq_rel) != 1) return;
+
+    jfs_bp_t *bp = buf_move->pool;
+    pthread_mutex_lock(&bp->lock);
+    buf_move->next = bp->free_array[buf_move->class_index];
+    bp->free_array[buf_move->class_index] = buf_move;
+    pthread_cond_broadcast(&bp->released);
+    pthread_mutex_unlock(&bp->lock);
+}
+
+void jfs_bp_ring_req(const jfs_bp_buf_t *buf, jfs_fio_ring_req_t *req) {
+    req->buf = buf->data;
+    req->buf_index = buf->buf_index;
+    if (req->op == JFS_FIO_RING_READ) {
+        req->size = buf->capacity;
+    } else {
+        req->size = buf->len;
+    }
+}
+
+static jfs_bp_buf_t *bp_take(jfs_bp_t *bp, size_t size) {
+    // smallest class that fits, spilling into larger ones before making the caller wait
+    for (uint32_t i = 0; i < bp->class_count; i++) {
+        if (bp->class_size_array[i] < size || bp->free_array[i] == NULL) continue;
+
+        jfs_bp_buf_t *buf = bp->free_array[i];
+        bp->free_array[i] = buf->next;
+        buf->next = NULL;
+        buf->len = 0;
+        atomic_store_explicit(&buf->refs, 1, memory_order_relaxed);
+        return buf;
+    }
+    return NULL;
+}
@@ -0,0 +1,238 @@
+#include "bundle.h"
+#include "error.h"
+#include "file_io.h"
+#include "net_socket.h"
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define BD_MODE_MASK    07777
+#define BD_UNPACK_BATCH 32 // members staged before the batch is published
+
+static void     bd_put_u16(uint8_t *ptr, uint16_t val);
+static void     bd_put_u32(uint8_t *ptr, uint32_t val);
+static uint16_t bd_get_u16(const uint8_t *ptr) WUR;
+static uint32_t bd_get_u32(const uint8_t *ptr) WUR;
+static int      bd_inode_cmp(const void *lhs, const void *rhs) WUR;
+static void     bd_stage_member(jfs_fio_stage_t *stage_init, int dir_fd, jfs_bd_member_t *member, jfs_err_t *err);
+static void     bd_commit_batch(jfs_fio_stage_t *stage_array, size_t stage_count, jfs_err_t *err);
+
+void jfs_bd_writer_init(jfs_bd_writer_t *writer_init, size_t capacity, jfs_err_t *err) {
+    VOID_FAIL_IF(capacity <= JFS_BD_SEGMENT_HEADER_SIZE || capacity > UINT32_MAX, JFS_ERR_ARG);
+
+    uint8_t *new_buf = jfs_malloc(capacity, err);
+    VOID_CHECK_ERR;
+
+    writer_init->buf = new_buf;
+    writer_init->capacity = capacity;
+    jfs_bd_writer_reset(writer_init);
+}
+
+void jfs_bd_writer_free(jfs_bd_writer_t *writer_free) {
+    free(writer_free->buf);
+    memset(writer_free, 0, sizeof(*writer_free));
+}
+
+void jfs_bd_writer_reset(jfs_bd_writer_t *writer) {
+    writer->len = JFS_BD_SEGMENT_HEADER_SIZE;
+    writer->count = 0;
+}
+
+void jfs_bd_writer_add(jfs_bd_writer_t *writer, int dir_fd, const jfs_fio_name_t *name, jfs_err_t *err) {
+    VOID_FAIL_IF(name->len == 0 || name->len > NAME_MAX, JFS_ERR_ARG);
+
+    struct stat file_stat;
+    int         fd = -1;
+    do {
+        if (*err == JFS_ERR_INTER) RES_ERR;
+        fd = jfs_openat(dir_fd, name->str, O_RDONLY | O_NOFOLLOW | O_CLOEXEC, 0, err);
+    } while (*err == JFS_ERR_INTER);
+    VOID_CHECK_ERR;
+
+    jfs_fstat(fd, &file_stat, err);
+    GOTO_IF_ERR(cleanup);
+    if (!S_ISREG(file_stat.st_mode) || (size_t) file_stat.st_size > JFS_BD_SMALL_FILE_MAX) GOTO_WITH_ERR(cleanup, JFS_ERR_ARG);
+
+    // the member is only committed once the data is in, so a full segment is left untouched
+    const size_t header_len = JFS_BD_MEMBER_HEADER_SIZE + name->len;
+    const size_t size = (size_t) file_stat.st_size;
+    if (writer->len + header_len + size > writer->capacity) GOTO_WITH_ERR(cleanup, JFS_ERR_FULL);
+
+    uint8_t     *member = writer->buf + writer->len;
+    const size_t read = jfs_fio_read(fd, member + header_len, size, err);
+    if (*err == JFS_ERR_FIO_FILE_END) RES_ERR; // shrank since the stat
+    GOTO_IF_ERR(cleanup);
+
+    member[0] = (uint8_t) name->len;
+    bd_put_u32(member + 1, (uint32_t) read);
+    bd_put_u16(member + 5, (uint16_t) (file_stat.st_mode & BD_MODE_MASK)); // NOLINT
+    memcpy(member + JFS_BD_MEMBER_HEADER_SIZE, name->str, name->len);
+
+    writer->len += header_len + read;
+    writer->count += 1;
+    close(fd);
+    return;
+cleanup:
+    close(fd);
+    VOID_RETURN_ERR;
+}
+
+void jfs_bd_writer_send(jfs_bd_writer_t *writer, const jfs_ns_socket_t *sock, jfs_err_t *err) {
+    if (writer->count == 0) return;
+
+    bd_put_u32(writer->buf, writer->count);
+    bd_put_u32(writer->buf + 4, (uint32_t) (writer->len - JFS_BD_SEGMENT_HEADER_SIZE));
+
+    jfs_ns_socket_send(sock, writer->buf, writer->len, 0, err);
+    VOID_CHECK_ERR;
+
+    jfs_bd_writer_reset(writer);
+}
+
+void jfs_bd_reader_init(jfs_bd_reader_t *reader_init, const uint8_t *buf, size_t len, jfs_err_t *err) {
+    VOID_FAIL_IF(len < JFS_BD_SEGMENT_HEADER_SIZE, JFS_ERR_BD_CORRUPT);
+    VOID_FAIL_IF(bd_get_u32(buf + 4) != len - JFS_BD_SEGMENT_HEADER_SIZE, JFS_ERR_BD_CORRUPT);
+
+    reader_init->buf = buf;
+    reader_init->len = len;
+    reader_init->cursor = JFS_BD_SEGMENT_HEADER_SIZE;
+    reader_init->remaining = bd_get_u32(buf);
+}
+
+int jfs_bd_reader_next(jfs_bd_reader_t *reader, jfs_bd_member_t *member_out, jfs_err_t *err) {
+    if (reader->remaining == 0) {
+        VAL_FAIL_IF(reader->cursor != reader->len, JFS_ERR_BD_CORRUPT, 0);
+        return 0;
+    }
+
+    const size_t left = reader->len - reader->cursor;
+    VAL_FAIL_IF(left < JFS_BD_MEMBER_HEADER_SIZE, JFS_ERR_BD_CORRUPT, 0);
+
+    const uint8_t *member = reader->buf + reader->cursor;
+    const size_t   name_len = member[0];
+    const uint32_t size = bd_get_u32(member + 1);
+    VAL_FAIL_IF(name_len == 0 || JFS_BD_MEMBER_HEADER_SIZE + name_len + size > left, JFS_ERR_BD_CORRUPT, 0);
+
+    const char *name_str = (const char *) member + JFS_BD_MEMBER_HEADER_SIZE;
+    VAL_FAIL_IF(memchr(name_str, '/', name_len) != NULL || memchr(name_str, '\0', name_len) != NULL, JFS_ERR_BD_CORRUPT, 0);
+    VAL_FAIL_IF(name_str[0] == '.' && (name_len == 1 || (name_len == 2 && name_str[1] == '.')), JFS_ERR_BD_CORRUPT, 0);
+
+    memcpy(member_out->name, name_str, name_len);
+    member_out->name[name_len] = '\0';
+    member_out->name_len = name_len;
+    member_out->size = size;
+    member_out->mode = bd_get_u16(member + 5); // NOLINT
+    member_out->data = member + JFS_BD_MEMBER_HEADER_SIZE + name_len;
+
+    reader->cursor += JFS_BD_MEMBER_HEADER_SIZE + name_len + size;
+    reader->remaining -= 1;
+    return 1;
+}
+
+void jfs_bd_unpack(jfs_bd_reader_t *reader, const jfs_fio_path_t *dir_path, jfs_err_t *err) {
+    jfs_fio_stage_t stage_array[BD_UNPACK_BATCH];
+    size_t          stage_count = 0;
+    jfs_bd_member_t member;
+
+    VOID_FAIL_IF(dir_path->len == 0, JFS_ERR_ARG);
+    const int dir_fd = jfs_open(dir_path->str, O_PATH | O_DIRECTORY | O_CLOEXEC, 0, err);
+    VOID_CHECK_ERR;
+
+    // each member appears whole or not at all, all writes of a batch land before any of it is published
+    // a failure keeps the members published before it, earlier batches and the start of the failing one
+    while (jfs_bd_reader_next(reader, &member, err)) {
+        bd_stage_member(&stage_array[stage_count], dir_fd, &member, err);
+        GOTO_IF_ERR(cleanup);
+        stage_count += 1;
+
+        if (stage_count == BD_UNPACK_BATCH) {
+            bd_commit_batch(stage_array, stage_count, err);
+            GOTO_IF_ERR(cleanup);
+            stage_count = 0;
+        }
+    }
+    GOTO_IF_ERR(cleanup);
+
+    bd_commit_batch(stage_array, stage_count, err);
+    GOTO_IF_ERR(cleanup);
+    close(dir_fd);
+    return;
+cleanup:
+    for (size_t i = 0; i < stage_count; i++) jfs_fio_stage_abort(&stage_array[i]);
+    close(dir_fd);
+    VOID_RETURN_ERR;
+}
+
+size_t jfs_bd_recv(const jfs_ns_socket_t *sock, uint8_t *buf, size_t capacity, jfs_err_t *err) {
+    VAL_FAIL_IF(capacity < JFS_BD_SEGMENT_HEADER_SIZE, JFS_ERR_ARG, 0);
+
+    jfs_ns_socket_recv(sock, buf, JFS_BD_SEGMENT_HEADER_SIZE, err);
+    VAL_CHECK_ERR(0);
+
+    const size_t payload_len = bd_get_u32(buf + 4);
+    VAL_FAIL_IF(payload_len > capacity - JFS_BD_SEGMENT_HEADER_SIZE, JFS_ERR_BD_CORRUPT, 0);
+
+    jfs_ns_socket_recv(sock, buf + JFS_BD_SEGMENT_HEADER_SIZE, payload_len, err);
+    VAL_CHECK_ERR(0);
+
+    return JFS_BD_SEGMENT_HEADER_SIZE + payload_len;
+}
+
+void jfs_bd_sort_files(jfs_fw_file_t *file_array, size_t file_count) {
+    // inode order tracks on-disk layout closely enough to turn the reads mostly sequential
+    qsort(file_array, file_count, sizeof(*file_array), bd_inode_cmp);
+}
+
+static void bd_put_u16(uint8_t *ptr, uint16_t val) {
+    ptr[0] = (uint8_t) val;
+    ptr[1] = (uint8_t) (val >> 8); // NOLINT
+}
+
+static void bd_put_u32(uint8_t *ptr, uint32_t val) {
+    ptr[0] = (uint8_t) val;
+    ptr[1] = (uint8_t) (val >> 8);  // NOLINT
+    ptr[2] = (uint8_t) (val >> 16); // NOLINT
+    ptr[3] = (uint8_t) (val >> 24); // NOLINT
+}
+
+static uint16_t bd_get_u16(const uint8_t *ptr) {
+    return (uint16_t) (ptr[0] | (ptr[1] << 8)); // NOLINT
+}
+
+static uint32_t bd_get_u32(const uint8_t *ptr) {
+    return (uint32_t) ptr[0] | ((uint32_t) ptr[1] << 8) | ((uint32_t) ptr[2] << 16) | ((uint32_t) ptr[3] << 24); // NOLINT
+}
+
+static int bd_inode_cmp(const void *lhs, const void *rhs) {
+    const jfs_fw_file_t *lhs_file = lhs;
+    const jfs_fw_file_t *rhs_file = rhs;
+    return (lhs_file->inode > rhs_file->inode) - (lhs_file->inode < rhs_file->inode);
+}
+
+static void bd_stage_member(jfs_fio_stage_t *stage_init, int dir_fd, jfs_bd_member_t *member, jfs_err_t *err) {
+    const jfs_fio_name_t name = {.len = member->name_len, .str = member->name};
+
+    jfs_fio_stage_init_at(stage_init, dir_fd, &name, member->size, member->mode, err);
+    VOID_CHECK_ERR;
+
+    jfs_fio_stage_write(stage_init, member->data, member->size, 0, err);
+    GOTO_IF_ERR(cleanup);
+
+    // the create mode went through the umask
+    jfs_fchmod(stage_init->fd, member->mode & BD_MODE_MASK, err);
+    GOTO_IF_ERR(cleanup);
+    return;
+cleanup:
+    jfs_fio_stage_abort(stage_init);
+    VOID_RETURN_ERR;
+}
+
+static void bd_commit_batch(jfs_fio_stage_t *stage_array, size_t stage_count, jfs_err_t *err) {
+    // committed stages are reset, so the caller can abort the whole batch on failure
+    for (size_t i = 0; i < stage_count; i++) {
+        jfs_fio_stage_commit(&stage_array[i], err);
+        VOID_CHECK_ERR;
+    }
+}
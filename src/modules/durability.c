@@ -0,0 +1,216 @@
+#include "durability.h"
+#include "error.h"
+#include "file_io.h"
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define DM_DEFAULT_BATCH_COUNT 128
+
+static void dm_prepare(jfs_dm_file_t *file_init, int fd, int dir_fd, jfs_err_t *err);
+static void dm_push(jfs_dm_t *dm, const jfs_dm_file_t *file);
+static void dm_commit_syncfs(jfs_dm_t *dm);
+static void dm_commit_fdatasync(jfs_dm_t *dm);
+static void dm_publish(jfs_dm_t *dm);
+static void dm_sync_dirs(jfs_dm_t *dm, bool syncfs);
+static bool dm_needs_dir_sync(const jfs_dm_file_t *file, bool syncfs) WUR;
+static bool dm_same_dir(const jfs_dm_file_t *lhs, const jfs_dm_file_t *rhs) WUR;
+
+void jfs_dm_init(jfs_dm_t *dm_init, const jfs_dm_conf_t *conf, jfs_err_t *err) {
+    VOID_FAIL_IF(conf->ack == NULL, JFS_ERR_ARG);
+
+    jfs_dm_t dm = {0};
+    dm.conf = *conf;
+    if (dm.conf.batch_count == 0) dm.conf.batch_count = DM_DEFAULT_BATCH_COUNT;
+    if (dm.conf.syncfs_count == 0) dm.conf.syncfs_count = dm.conf.batch_count;
+    // a batch never grows past batch_count, so a larger threshold would never be reached
+    VOID_FAIL_IF(dm.conf.syncfs_count > dm.conf.batch_count, JFS_ERR_BAD_CONF);
+
+    dm.file_array = jfs_malloc(sizeof(*dm.file_array) * dm.conf.batch_count, err);
+    VOID_CHECK_ERR;
+    dm.capacity = dm.conf.batch_count;
+
+    *dm_init = dm;
+}
+
+void jfs_dm_free(jfs_dm_t *dm_free) {
+    for (size_t i = 0; i < dm_free->count; i++) {
+        jfs_dm_file_t *file = &dm_free->file_array[i];
+        if (file->staged) {
+            jfs_fio_stage_abort(&file->stage);
+        } else {
+            close(file->fd);
+        }
+    }
+    free(dm_free->file_array);
+    memset(dm_free, 0, sizeof(*dm_free));
+}
+
+void jfs_dm_add(jfs_dm_t *dm, int fd_give, int dir_fd, void *file_ctx, jfs_err_t *err) {
+    jfs_dm_file_t file = {.file_ctx = file_ctx};
+    dm_prepare(&file, fd_give, dir_fd, err);
+    if (*err != JFS_OK) {
+        close(fd_give);
+        VOID_RETURN_ERR;
+    }
+
+    dm_push(dm, &file);
+}
+
+void jfs_dm_add_stage(jfs_dm_t *dm, jfs_fio_stage_t *stage_give, void *file_ctx, jfs_err_t *err) {
+    jfs_dm_file_t file = {.staged = true, .file_ctx = file_ctx};
+
+    // the size has to be final before fdatasync, the name is only added after it
+    jfs_fio_stage_finish(stage_give, err);
+    GOTO_IF_ERR(cleanup);
+    dm_prepare(&file, stage_give->fd, stage_give->dir_fd, err);
+    GOTO_IF_ERR(cleanup);
+
+    // the O_PATH dir fd can't be fsynced, a real one is opened at commit
+    file.dir_fd = -1;
+    file.stage = *stage_give;
+    *stage_give = (jfs_fio_stage_t) {.fd = -1, .dir_fd = -1};
+    dm_push(dm, &file);
+    return;
+cleanup:
+    jfs_fio_stage_abort(stage_give);
+    VOID_RETURN_ERR;
+}
+
+void jfs_dm_commit(jfs_dm_t *dm) {
+    if (dm->count == 0) return;
+
+    const bool syncfs = dm->count >= dm->conf.syncfs_count;
+    if (syncfs) {
+        dm_commit_syncfs(dm);
+    } else {
+        dm_commit_fdatasync(dm);
+    }
+    // staged names only appear once their data is durable, so their directories are synced after
+    dm_publish(dm);
+    dm_sync_dirs(dm, syncfs);
+
+    // nothing is acked before the whole batch has been through the sync calls
+    for (size_t i = 0; i < dm->count; i++) {
+        jfs_dm_file_t *file = &dm->file_array[i];
+        if (!file->staged) close(file->fd);
+        if (file->own_dir) close(file->dir_fd);
+        dm->conf.ack(file->file_ctx, file->err, dm->conf.ack_ctx);
+    }
+    dm->count = 0;
+}
+
+static void dm_prepare(jfs_dm_file_t *file_init, int fd, int dir_fd, jfs_err_t *err) {
+    struct stat file_stat;
+    jfs_fstat(fd, &file_stat, err);
+    VOID_CHECK_ERR;
+
+    struct stat dir_stat = {0};
+    if (dir_fd != -1) {
+        jfs_fstat(dir_fd, &dir_stat, err);
+        VOID_CHECK_ERR;
+    }
+
+    // start writeback now so it overlaps with receiving the rest of the batch
+    jfs_sync_file_range(fd, 0, 0, SYNC_FILE_RANGE_WRITE, err);
+    if (*err == JFS_ERR_FIO_UNSUPPORTED || *err == JFS_ERR_INTER) RES_ERR;
+    VOID_CHECK_ERR;
+
+    file_init->fd = fd;
+    file_init->dir_fd = dir_fd;
+    file_init->dev = file_stat.st_dev;
+    file_init->dir_ino = dir_stat.st_ino;
+    file_init->err = JFS_OK;
+}
+
+static void dm_push(jfs_dm_t *dm, const jfs_dm_file_t *file) {
+    dm->file_array[dm->count++] = *file;
+    if (dm->count == dm->capacity) jfs_dm_commit(dm);
+}
+
+static void dm_commit_syncfs(jfs_dm_t *dm) {
+    // one syncfs per filesystem covers file data, metadata and the directory entries already in place
+    for (size_t i = 0; i < dm->count; i++) {
+        bool seen = false;
+        for (size_t j = 0; j < i && !seen; j++) {
+            seen = dm->file_array[j].dev == dm->file_array[i].dev;
+        }
+        if (seen) continue;
+
+        jfs_err_t sync_err = JFS_OK;
+        jfs_syncfs(dm->file_array[i].fd, &sync_err);
+        for (size_t j = i; j < dm->count; j++) {
+            if (dm->file_array[j].dev == dm->file_array[i].dev) dm->file_array[j].err = sync_err;
+        }
+    }
+}
+
+static void dm_commit_fdatasync(jfs_dm_t *dm) {
+    // writeback was started on add, so most of these only wait for the journal commit
+    for (size_t i = 0; i < dm->count; i++) {
+        jfs_dm_file_t *file = &dm->file_array[i];
+        do {
+            file->err = JFS_OK;
+            jfs_fdatasync(file->fd, &file->err);
+        } while (file->err == JFS_ERR_INTER);
+    }
+}
+
+static void dm_publish(jfs_dm_t *dm) {
+    for (size_t i = 0; i < dm->count; i++) {
+        jfs_dm_file_t *file = &dm->file_array[i];
+        if (!file->staged) continue;
+
+        if (file->err == JFS_OK) {
+            // commit closes the stage's O_PATH dir fd, so the one to fsync is opened from it first
+            bool seen = false;
+            for (size_t j = 0; j < i && !seen; j++) {
+                seen = dm->file_array[j].staged && dm->file_array[j].dir_fd != -1 && dm_same_dir(&dm->file_array[j], file);
+            }
+            if (!seen) {
+                file->dir_fd = jfs_openat(file->stage.dir_fd, ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC, 0, &file->err);
+                file->own_dir = file->err == JFS_OK;
+            }
+        }
+        if (file->err == JFS_OK) jfs_fio_stage_commit(&file->stage, &file->err);
+        jfs_fio_stage_abort(&file->stage);
+    }
+}
+
+static void dm_sync_dirs(jfs_dm_t *dm, bool syncfs) {
+    // new names are only durable once their directory is, each directory is synced once
+    for (size_t i = 0; i < dm->count; i++) {
+        const jfs_dm_file_t *file = &dm->file_array[i];
+        if (!dm_needs_dir_sync(file, syncfs)) continue;
+
+        bool seen = false;
+        for (size_t j = 0; j < i && !seen; j++) {
+            seen = dm_needs_dir_sync(&dm->file_array[j], syncfs) && dm_same_dir(&dm->file_array[j], file);
+        }
+        if (seen) continue;
+
+        jfs_err_t sync_err = JFS_OK;
+        do {
+            sync_err = JFS_OK;
+            jfs_fsync(file->dir_fd, &sync_err);
+        } while (sync_err == JFS_ERR_INTER);
+
+        // staged files sharing the directory have no dir fd of their own
+        for (size_t j = i; j < dm->count; j++) {
+            jfs_dm_file_t *other = &dm->file_array[j];
+            if ((other->staged || !syncfs) && dm_same_dir(other, file) && other->err == JFS_OK) other->err = sync_err;
+        }
+    }
+}
+
+static bool dm_needs_dir_sync(const jfs_dm_file_t *file, bool syncfs) {
+    // syncfs already covered the names of files that were not staged
+    return file->dir_fd != -1 && (file->staged || !syncfs);
+}
+
+static bool dm_same_dir(const jfs_dm_file_t *lhs, const jfs_dm_file_t *rhs) {
+    return lhs->dev == rhs->dev && lhs->dir_ino == rhs->dir_ino;
+}
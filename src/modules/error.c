@@ -2,12 +2,22 @@
 #include <asm-generic/errno-base.h>
 #include <asm-generic/errno.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <linux/io_uring.h>
 #include <netdb.h>
+#include <poll.h>
 #include <pthread.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <sys/epoll.h>
 #include <sys/eventfd.h>
+#include <sys/ioctl.h>
 #include <sys/mman.h>
+#include <sys/sendfile.h>
 #include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
 #include <sys/types.h>
 #include <unistd.h>
 
@@ -47,6 +57,16 @@ void jfs_lstat(const char *path_str, struct stat *stat_init, jfs_err_t *err) {
     }
 }
 
+void jfs_fstat(int fd, struct stat *stat_init, jfs_err_t *err) {
+    if (fstat(fd, stat_init) != 0) {
+        switch (errno) {
+            case EACCES: *err = JFS_ERR_ACCESS; break;
+            default:     *err = JFS_ERR_SYS; break;
+        }
+        VOID_RETURN_ERR;
+    }
+}
+
 DIR *jfs_opendir(const char *path_str, jfs_err_t *err) {
     DIR *dir = opendir(path_str);
     if (dir == NULL) {
@@ -120,8 +140,12 @@ int jfs_accept(int sock_fd, struct sockaddr *addr, socklen_t *addrlen, jfs_err_t
             case ENETUNREACH:
             case EAGAIN:       *err = JFS_ERR_AGAIN; break;
             case EINTR:        *err = JFS_ERR_INTER; break;
+            case EMFILE:
+            case ENFILE:
+            case ENOBUFS:      *err = JFS_ERR_FULL; break;
             default:           *err = JFS_ERR_SYS; break;
         }
+        if (*err == JFS_ERR_AGAIN) return -1; // the normal end of a non-blocking loop, not worth a log line
         VAL_RETURN_ERR(-1);
     }
 
@@ -150,6 +174,7 @@ size_t jfs_recv(int sock_fd, void *buf, size_t size, int flags, jfs_err_t *err)
             case EINTR:  *err = JFS_ERR_INTER; break;
             default:     *err = JFS_ERR_SYS; break;
         }
+        if (*err == JFS_ERR_AGAIN) return 0;
         VAL_RETURN_ERR(0);
     }
 
@@ -164,8 +189,44 @@ size_t jfs_send(int sock_fd, const void *buf, size_t size, int flags, jfs_err_t
             case ECONNRESET: *err = JFS_ERR_CONNECTION_RESET; break;
             case EINTR:      *err = JFS_ERR_INTER; break;
             case EPIPE:      *err = JFS_ERR_PIPE; break;
+            case ENOBUFS:    *err = JFS_ERR_FULL; break;
+            default:         *err = JFS_ERR_SYS; break;
+        }
+        if (*err == JFS_ERR_AGAIN) return 0;
+        VAL_RETURN_ERR(0);
+    }
+
+    return (size_t) status;
+}
+
+size_t jfs_sendmsg(int sock_fd, const struct msghdr *msg, int flags, jfs_err_t *err) {
+    ssize_t status = sendmsg(sock_fd, msg, flags);
+    if (status == -1) {
+        switch (errno) {
+            case EAGAIN:     *err = JFS_ERR_AGAIN; break;
+            case ECONNRESET: *err = JFS_ERR_CONNECTION_RESET; break;
+            case EINTR:      *err = JFS_ERR_INTER; break;
+            case EPIPE:      *err = JFS_ERR_PIPE; break;
+            case ENOBUFS:    *err = JFS_ERR_FULL; break;
             default:         *err = JFS_ERR_SYS; break;
         }
+        if (*err == JFS_ERR_AGAIN) return 0;
+        VAL_RETURN_ERR(0);
+    }
+
+    return (size_t) status;
+}
+
+size_t jfs_recvmsg(int sock_fd, struct msghdr *msg, int flags, jfs_err_t *err) {
+    ssize_t status = recvmsg(sock_fd, msg, flags);
+    if (status == -1) {
+        switch (errno) {
+            case EAGAIN:     *err = JFS_ERR_AGAIN; break;
+            case ECONNRESET: *err = JFS_ERR_CONNECTION_RESET; break;
+            case EINTR:      *err = JFS_ERR_INTER; break;
+            default:         *err = JFS_ERR_SYS; break;
+        }
+        if (*err == JFS_ERR_AGAIN) return 0;
         VAL_RETURN_ERR(0);
     }
 
@@ -222,6 +283,26 @@ void jfs_mutex_trylock(pthread_mutex_t *mutex, jfs_err_t *err) {
     }
 }
 
+void jfs_pthread_create(pthread_t *thread, const pthread_attr_t *attr, void *(*start)(void *), void *arg, jfs_err_t *err) {
+    const int status = pthread_create(thread, attr, start, arg);
+    if (status != 0) {
+        switch (status) { // pthreads returns the error instead of setting errno
+            case EINVAL: *err = JFS_ERR_ARG; break;
+            default:     *err = JFS_ERR_SYS; break;
+        }
+        VOID_RETURN_ERR;
+    }
+}
+
+void jfs_cond_init(pthread_cond_t *cond, const pthread_condattr_t *attr, jfs_err_t *err) {
+    if (pthread_cond_init(cond, attr) != 0) {
+        switch (errno) {
+            default: *err = JFS_ERR_SYS; break;
+        }
+        VOID_RETURN_ERR;
+    }
+}
+
 void jfs_cond_destroy(pthread_cond_t *cond, jfs_err_t *err) {
     if (pthread_cond_destroy(cond) != 0) {
         switch (errno) {
@@ -253,6 +334,76 @@ int jfs_eventfd(unsigned int initval, int flags, jfs_err_t *err) {
     return event_fd;
 }
 
+int jfs_epoll_create1(int flags, jfs_err_t *err) {
+    int epoll_fd = epoll_create1(flags);
+    if (epoll_fd == -1) {
+        switch (errno) {
+            case EINVAL: *err = JFS_ERR_ARG; break;
+            default:     *err = JFS_ERR_SYS; break;
+        }
+        VAL_RETURN_ERR(-1);
+    }
+    return epoll_fd;
+}
+
+void jfs_epoll_ctl(int epoll_fd, int op, int fd, struct epoll_event *event, jfs_err_t *err) {
+    if (epoll_ctl(epoll_fd, op, fd, event) == -1) {
+        switch (errno) {
+            case EEXIST: *err = JFS_ERR_EXIST; break;
+            case EINVAL:
+            case EPERM:  *err = JFS_ERR_ARG; break;
+            default:     *err = JFS_ERR_SYS; break;
+        }
+        VOID_RETURN_ERR;
+    }
+}
+
+uint32_t jfs_epoll_wait(int epoll_fd, struct epoll_event *event_array, int max_events, int timeout_ms, jfs_err_t *err) {
+    int status = epoll_wait(epoll_fd, event_array, max_events, timeout_ms);
+    if (status == -1) {
+        switch (errno) {
+            case EINTR: *err = JFS_ERR_INTER; break;
+            default:    *err = JFS_ERR_SYS; break;
+        }
+        VAL_RETURN_ERR(0);
+    }
+    return (uint32_t) status;
+}
+
+uint32_t jfs_poll(struct pollfd *poll_array, size_t poll_count, int timeout_ms, jfs_err_t *err) {
+    int status = poll(poll_array, poll_count, timeout_ms);
+    if (status == -1) {
+        switch (errno) {
+            case EINTR: *err = JFS_ERR_INTER; break;
+            default:    *err = JFS_ERR_SYS; break;
+        }
+        VAL_RETURN_ERR(0);
+    }
+    return (uint32_t) status;
+}
+
+void jfs_setsockopt(int sock_fd, int level, int name, const void *val, socklen_t val_len, jfs_err_t *err) {
+    if (setsockopt(sock_fd, level, name, val, val_len) == -1) {
+        switch (errno) {
+            case EINVAL:
+            case ENOPROTOOPT: *err = JFS_ERR_ARG; break;
+            default:          *err = JFS_ERR_SYS; break;
+        }
+        VOID_RETURN_ERR;
+    }
+}
+
+void jfs_getsockopt(int sock_fd, int level, int name, void *val, socklen_t *val_len, jfs_err_t *err) {
+    if (getsockopt(sock_fd, level, name, val, val_len) == -1) {
+        switch (errno) {
+            case EINVAL:
+            case ENOPROTOOPT: *err = JFS_ERR_ARG; break;
+            default:          *err = JFS_ERR_SYS; break;
+        }
+        VOID_RETURN_ERR;
+    }
+}
+
 size_t jfs_read(int fd, void *buf, size_t size, jfs_err_t *err) {
     ssize_t status = read(fd, buf, size);
     if (status == -1) {
@@ -280,6 +431,334 @@ size_t jfs_write(int fd, const void *buf, size_t size, jfs_err_t *err) {
     return (size_t) status;
 }
 
+size_t jfs_pread(int fd, void *buf, size_t size, off_t off, jfs_err_t *err) {
+    ssize_t status = pread(fd, buf, size, off);
+    if (status == -1) {
+        switch (errno) {
+            case EAGAIN: *err = JFS_ERR_AGAIN; break;
+            case EINTR:  *err = JFS_ERR_INTER; break;
+            case EINVAL: *err = JFS_ERR_ARG; break;
+            default:     *err = JFS_ERR_SYS; break;
+        }
+        VAL_RETURN_ERR(0);
+    }
+    return (size_t) status;
+}
+
+size_t jfs_preadv2(int fd, const struct iovec *iov, int iov_count, off_t off, int flags, jfs_err_t *err) {
+    ssize_t status = preadv2(fd, iov, iov_count, off, flags);
+    if (status == -1) {
+        switch (errno) {
+            case EAGAIN:     *err = JFS_ERR_AGAIN; break;
+            case EINTR:      *err = JFS_ERR_INTER; break;
+            case EOPNOTSUPP:
+            case ENOSYS:     *err = JFS_ERR_FIO_UNSUPPORTED; break;
+            case EINVAL:     *err = JFS_ERR_ARG; break;
+            default:         *err = JFS_ERR_SYS; break;
+        }
+        // with RWF_NOWAIT a cache miss or a filesystem without it is an expected answer, not an error
+        if (*err == JFS_ERR_AGAIN) return 0;
+        if (*err == JFS_ERR_FIO_UNSUPPORTED && (flags & RWF_NOWAIT) != 0) return 0;
+        VAL_RETURN_ERR(0);
+    }
+    return (size_t) status;
+}
+
+size_t jfs_pwrite(int fd, const void *buf, size_t size, off_t off, jfs_err_t *err) {
+    ssize_t status = pwrite(fd, buf, size, off);
+    if (status == -1) {
+        switch (errno) {
+            case EAGAIN: *err = JFS_ERR_AGAIN; break;
+            case EINTR:  *err = JFS_ERR_INTER; break;
+            default:     *err = JFS_ERR_SYS; break;
+        }
+        VAL_RETURN_ERR(0);
+    }
+    return (size_t) status;
+}
+
+size_t jfs_copy_file_range(int in_fd, off_t *in_off, int out_fd, off_t *out_off, size_t size, jfs_err_t *err) {
+    ssize_t status = copy_file_range(in_fd, in_off, out_fd, out_off, size, 0);
+    if (status == -1) {
+        switch (errno) {
+            case EINTR:      *err = JFS_ERR_INTER; break;
+            case EXDEV:
+            case ENOSYS:
+            case EOPNOTSUPP:
+            case EINVAL:     *err = JFS_ERR_FIO_UNSUPPORTED; break;
+            default:         *err = JFS_ERR_SYS; break;
+        }
+        VAL_RETURN_ERR(0);
+    }
+    return (size_t) status;
+}
+
+size_t jfs_sendfile(int out_fd, int in_fd, off_t *in_off, size_t size, jfs_err_t *err) {
+    ssize_t status = sendfile(out_fd, in_fd, in_off, size);
+    if (status == -1) {
+        switch (errno) {
+            case EAGAIN:     *err = JFS_ERR_AGAIN; break;
+            case ECONNRESET: *err = JFS_ERR_CONNECTION_RESET; break;
+            case EINTR:      *err = JFS_ERR_INTER; break;
+            case EPIPE:      *err = JFS_ERR_PIPE; break;
+            case ENOSYS:
+            case EINVAL:     *err = JFS_ERR_FIO_UNSUPPORTED; break;
+            default:         *err = JFS_ERR_SYS; break;
+        }
+        if (*err == JFS_ERR_AGAIN) return 0;
+        VAL_RETURN_ERR(0);
+    }
+    return (size_t) status;
+}
+
+size_t jfs_splice(int in_fd, off_t *in_off, int out_fd, off_t *out_off, size_t size, unsigned int flags, jfs_err_t *err) {
+    ssize_t status = splice(in_fd, in_off, out_fd, out_off, size, flags);
+    if (status == -1) {
+        switch (errno) {
+            case EAGAIN:     *err = JFS_ERR_AGAIN; break;
+            case ECONNRESET: *err = JFS_ERR_CONNECTION_RESET; break;
+            case EINTR:      *err = JFS_ERR_INTER; break;
+            case EDQUOT:
+            case ENOSPC:     *err = JFS_ERR_FULL; break;
+            case ENOSYS:
+            case EINVAL:     *err = JFS_ERR_FIO_UNSUPPORTED; break;
+            default:         *err = JFS_ERR_SYS; break;
+        }
+        if (*err == JFS_ERR_AGAIN) return 0;
+        VAL_RETURN_ERR(0);
+    }
+    return (size_t) status;
+}
+
+void jfs_pipe2(int pipe_fd[2], int flags, jfs_err_t *err) {
+    if (pipe2(pipe_fd, flags) == -1) {
+        switch (errno) {
+            case EMFILE:
+            case ENFILE: *err = JFS_ERR_FULL; break;
+            default:     *err = JFS_ERR_SYS; break;
+        }
+        VOID_RETURN_ERR;
+    }
+}
+
+void jfs_ficlonerange(int dest_fd, const struct file_clone_range *range, jfs_err_t *err) {
+    if (ioctl(dest_fd, FICLONERANGE, range) == -1) {
+        switch (errno) {
+            case EINTR:      *err = JFS_ERR_INTER; break;
+            case EXDEV:
+            case ENOTTY:
+            case EOPNOTSUPP:
+            case EINVAL:     *err = JFS_ERR_FIO_UNSUPPORTED; break;
+            default:         *err = JFS_ERR_SYS; break;
+        }
+        VOID_RETURN_ERR;
+    }
+}
+
+int jfs_open(const char *path, int flags, mode_t mode, jfs_err_t *err) {
+    int fd = open(path, flags, mode);
+    if (fd == -1) {
+        switch (errno) {
+            case EACCES:
+            case EPERM:   *err = JFS_ERR_ACCESS; break;
+            case ENOENT:
+            case ENOTDIR: *err = JFS_ERR_INVAL_PATH; break;
+            case EINVAL:  *err = JFS_ERR_ARG; break;
+            case EINTR:   *err = JFS_ERR_INTER; break;
+            default:      *err = JFS_ERR_SYS; break;
+        }
+        VAL_RETURN_ERR(-1);
+    }
+    return fd;
+}
+
+int jfs_fcntl(int fd, int cmd, int arg, jfs_err_t *err) {
+    int status = fcntl(fd, cmd, arg);
+    if (status == -1) {
+        switch (errno) {
+            case EINVAL: *err = JFS_ERR_ARG; break;
+            case EINTR:  *err = JFS_ERR_INTER; break;
+            default:     *err = JFS_ERR_SYS; break;
+        }
+        VAL_RETURN_ERR(-1);
+    }
+    return status;
+}
+
+void jfs_posix_fadvise(int fd, off_t off, off_t len, int advice, jfs_err_t *err) {
+    int status = posix_fadvise(fd, off, len, advice);
+    if (status != 0) {
+        switch (status) {
+            case EINVAL: *err = JFS_ERR_ARG; break;
+            default:     *err = JFS_ERR_SYS; break;
+        }
+        VOID_RETURN_ERR;
+    }
+}
+
+int jfs_openat(int dir_fd, const char *path, int flags, mode_t mode, jfs_err_t *err) {
+    int fd = openat(dir_fd, path, flags, mode);
+    if (fd == -1) {
+        switch (errno) {
+            case EACCES:
+            case EPERM:      *err = JFS_ERR_ACCESS; break;
+            case ENOENT:
+            case ENOTDIR:    *err = JFS_ERR_INVAL_PATH; break;
+            case EEXIST:     *err = JFS_ERR_EXIST; break;
+            case EISDIR:
+            case EOPNOTSUPP: *err = JFS_ERR_FIO_UNSUPPORTED; break;
+            case EINVAL:     *err = JFS_ERR_ARG; break;
+            case EINTR:      *err = JFS_ERR_INTER; break;
+            default:         *err = JFS_ERR_SYS; break;
+        }
+        VAL_RETURN_ERR(-1);
+    }
+    return fd;
+}
+
+void jfs_fallocate(int fd, int mode, off_t off, off_t len, jfs_err_t *err) {
+    if (fallocate(fd, mode, off, len) == -1) {
+        switch (errno) {
+            case ENOSPC:     *err = JFS_ERR_FULL; break;
+            case EOPNOTSUPP: *err = JFS_ERR_FIO_UNSUPPORTED; break;
+            case EINTR:      *err = JFS_ERR_INTER; break;
+            default:         *err = JFS_ERR_SYS; break;
+        }
+        VOID_RETURN_ERR;
+    }
+}
+
+void jfs_ftruncate(int fd, off_t size, jfs_err_t *err) {
+    if (ftruncate(fd, size) == -1) {
+        switch (errno) {
+            case EFBIG:
+            case EINVAL: *err = JFS_ERR_ARG; break;
+            case EINTR:  *err = JFS_ERR_INTER; break;
+            case EIO:    *err = JFS_ERR_IO; break;
+            default:     *err = JFS_ERR_SYS; break;
+        }
+        VOID_RETURN_ERR;
+    }
+}
+
+void jfs_fchmod(int fd, mode_t mode, jfs_err_t *err) {
+    if (fchmod(fd, mode) == -1) {
+        switch (errno) {
+            case EPERM:
+            case EACCES: *err = JFS_ERR_ACCESS; break;
+            case EINTR:  *err = JFS_ERR_INTER; break;
+            case EIO:    *err = JFS_ERR_IO; break;
+            default:     *err = JFS_ERR_SYS; break;
+        }
+        VOID_RETURN_ERR;
+    }
+}
+
+void jfs_linkat(int old_dir_fd, const char *old_path, int new_dir_fd, const char *new_path, int flags, jfs_err_t *err) {
+    if (linkat(old_dir_fd, old_path, new_dir_fd, new_path, flags) == -1) {
+        switch (errno) {
+            case EACCES:
+            case EPERM:   *err = JFS_ERR_ACCESS; break;
+            case ENOENT:
+            case ENOTDIR: *err = JFS_ERR_INVAL_PATH; break;
+            case EEXIST:  *err = JFS_ERR_EXIST; break;
+            default:      *err = JFS_ERR_SYS; break;
+        }
+        VOID_RETURN_ERR;
+    }
+}
+
+void jfs_renameat(int old_dir_fd, const char *old_path, int new_dir_fd, const char *new_path, jfs_err_t *err) {
+    if (renameat(old_dir_fd, old_path, new_dir_fd, new_path) == -1) {
+        switch (errno) {
+            case EACCES:
+            case EPERM:   *err = JFS_ERR_ACCESS; break;
+            case ENOENT:
+            case ENOTDIR: *err = JFS_ERR_INVAL_PATH; break;
+            default:      *err = JFS_ERR_SYS; break;
+        }
+        VOID_RETURN_ERR;
+    }
+}
+
+void jfs_unlinkat(int dir_fd, const char *path, int flags, jfs_err_t *err) {
+    if (unlinkat(dir_fd, path, flags) == -1) {
+        switch (errno) {
+            case EACCES:
+            case EPERM:   *err = JFS_ERR_ACCESS; break;
+            case ENOENT:
+            case ENOTDIR: *err = JFS_ERR_INVAL_PATH; break;
+            default:      *err = JFS_ERR_SYS; break;
+        }
+        VOID_RETURN_ERR;
+    }
+}
+
+off_t jfs_lseek(int fd, off_t off, int whence, jfs_err_t *err) {
+    off_t status = lseek(fd, off, whence);
+    if (status == -1) {
+        switch (errno) {
+            case ENXIO:  *err = JFS_ERR_FIO_FILE_END; break;
+            case EINVAL: *err = JFS_ERR_FIO_UNSUPPORTED; break;
+            default:     *err = JFS_ERR_SYS; break;
+        }
+        VAL_RETURN_ERR(-1);
+    }
+    return status;
+}
+
+void jfs_sync_file_range(int fd, off_t off, off_t len, unsigned int flags, jfs_err_t *err) {
+    if (sync_file_range(fd, off, len, flags) == -1) {
+        switch (errno) {
+            case EIO:    *err = JFS_ERR_IO; break;
+            case ENOSPC: *err = JFS_ERR_FULL; break;
+            case EINVAL:
+            case ESPIPE: *err = JFS_ERR_FIO_UNSUPPORTED; break;
+            case EINTR:  *err = JFS_ERR_INTER; break;
+            default:     *err = JFS_ERR_SYS; break;
+        }
+        VOID_RETURN_ERR;
+    }
+}
+
+void jfs_fdatasync(int fd, jfs_err_t *err) {
+    if (fdatasync(fd) == -1) {
+        switch (errno) {
+            case EIO:    *err = JFS_ERR_IO; break;
+            case EDQUOT:
+            case ENOSPC: *err = JFS_ERR_FULL; break;
+            case EINTR:  *err = JFS_ERR_INTER; break;
+            default:     *err = JFS_ERR_SYS; break;
+        }
+        VOID_RETURN_ERR;
+    }
+}
+
+void jfs_fsync(int fd, jfs_err_t *err) {
+    if (fsync(fd) == -1) {
+        switch (errno) {
+            case EIO:    *err = JFS_ERR_IO; break;
+            case EDQUOT:
+            case ENOSPC: *err = JFS_ERR_FULL; break;
+            case EINTR:  *err = JFS_ERR_INTER; break;
+            default:     *err = JFS_ERR_SYS; break;
+        }
+        VOID_RETURN_ERR;
+    }
+}
+
+void jfs_syncfs(int fd, jfs_err_t *err) {
+    if (syncfs(fd) == -1) {
+        switch (errno) {
+            case EIO:    *err = JFS_ERR_IO; break;
+            case EDQUOT:
+            case ENOSPC: *err = JFS_ERR_FULL; break;
+            default:     *err = JFS_ERR_SYS; break;
+        }
+        VOID_RETURN_ERR;
+    }
+}
+
 void *jfs_mmap(void *addr, size_t len, int prot, int flags, int fd, off_t off, jfs_err_t *err) {
     void *mem = mmap(addr, len, prot, flags, fd, off);
     if (mem == MAP_FAILED) {
@@ -300,3 +779,42 @@ void *jfs_aligned_alloc(size_t align, size_t size, jfs_err_t *err) {
     }
     return mem;
 }
+
+int jfs_io_uring_setup(uint32_t entries, struct io_uring_params *params, jfs_err_t *err) {
+    long ring_fd = syscall(__NR_io_uring_setup, entries, params);
+    if (ring_fd == -1) {
+        switch (errno) {
+            case EINVAL: *err = JFS_ERR_ARG; break;
+            case EPERM:  *err = JFS_ERR_ACCESS; break;
+            default:     *err = JFS_ERR_SYS; break;
+        }
+        VAL_RETURN_ERR(-1);
+    }
+    return (int) ring_fd;
+}
+
+uint32_t jfs_io_uring_enter(int ring_fd, uint32_t to_submit, uint32_t min_complete, uint32_t flags, jfs_err_t *err) {
+    long status = syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, NULL, 0);
+    if (status == -1) {
+        switch (errno) {
+            case EAGAIN:
+            case EBUSY:  *err = JFS_ERR_AGAIN; break;
+            case EINTR:  *err = JFS_ERR_INTER; break;
+            default:     *err = JFS_ERR_SYS; break;
+        }
+        VAL_RETURN_ERR(0);
+    }
+    return (uint32_t) status;
+}
+
+void jfs_io_uring_register(int ring_fd, uint32_t opcode, const void *arg, uint32_t nr_args, jfs_err_t *err) {
+    if (syscall(__NR_io_uring_register, ring_fd, opcode, arg, nr_args) == -1) {
+        switch (errno) {
+            case EBUSY:  *err = JFS_ERR_FIO_RING_BUSY; break;
+            case EINVAL: *err = JFS_ERR_ARG; break;
+            case EINTR:  *err = JFS_ERR_INTER; break;
+            default:     *err = JFS_ERR_SYS; break;
+        }
+        VOID_RETURN_ERR;
+    }
+}
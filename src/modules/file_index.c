@@ -0,0 +1,562 @@
+#include "file_index.h"
+#include "error.h"
+#include "file_io.h"
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define FI_ENTRY_DEFAULT_CAPACITY 64
+#define FI_PATH_DEFAULT_CAPACITY  4096
+#define FI_SLOT_DEFAULT_CAPACITY  128
+#define FI_SAVE_CHUNK_SIZE        ((size_t) 1048576) // 1 mb
+#define FI_MAGIC                  0x4953464AU        // "JFSI" on disk
+#define FI_VERSION                3U
+#define FI_NS_PER_SEC             1000000000LL
+#define FI_INDEX_MODE             0644
+#define FI_SAMPLE_TAIL            ((size_t) 4096) // 4 kb
+#define FI_SAMPLE_BLOCK           ((size_t) 512)
+#define FI_SAMPLE_BLOCKS          8
+#define FI_FNV_OFFSET             14695981039346656037ULL
+#define FI_FNV_PRIME              1099511628211ULL
+
+static int      fi_path_cmp(const char *lhs_str, size_t lhs_len, const char *rhs_str, size_t rhs_len) WUR;
+static int      fi_order_cmp(const void *lhs, const void *rhs, void *ctx) WUR;
+static size_t   fi_find(const jfs_fi_t *fi, const char *path_str, size_t path_len, bool *found_out) WUR;
+static void     fi_reserve(jfs_fi_t *fi, size_t entry_count, size_t path_len, jfs_err_t *err);
+static void     fi_slot_reserve(jfs_fi_t *fi, size_t pending_count, jfs_err_t *err);
+static void     fi_slot_put(jfs_fi_t *fi, size_t index);
+static void     fi_put_u16(uint8_t *ptr, uint16_t val);
+static void     fi_put_u32(uint8_t *ptr, uint32_t val);
+static void     fi_put_u64(uint8_t *ptr, uint64_t val);
+static uint16_t fi_get_u16(const uint8_t *ptr) WUR;
+static uint32_t fi_get_u32(const uint8_t *ptr) WUR;
+static uint64_t fi_get_u64(const uint8_t *ptr) WUR;
+static uint64_t fi_fnv(uint64_t hash, const uint8_t *data, size_t len) WUR;
+static void     fi_record_pack(const jfs_fi_t *fi, const jfs_fi_entry_t *entry, uint8_t *record);
+
+void jfs_fi_init(jfs_fi_t *fi_init, jfs_err_t *err) {
+    jfs_fi_t fi = {0};
+
+    fi.entry_array = jfs_malloc(sizeof(*fi.entry_array) * FI_ENTRY_DEFAULT_CAPACITY, err);
+    GOTO_IF_ERR(cleanup);
+    fi.capacity = FI_ENTRY_DEFAULT_CAPACITY;
+
+    fi.path_array = jfs_malloc(FI_PATH_DEFAULT_CAPACITY, err);
+    GOTO_IF_ERR(cleanup);
+    fi.path_capacity = FI_PATH_DEFAULT_CAPACITY;
+
+    fi.slot_array = jfs_malloc(sizeof(*fi.slot_array) * FI_SLOT_DEFAULT_CAPACITY, err);
+    GOTO_IF_ERR(cleanup);
+    memset(fi.slot_array, 0, sizeof(*fi.slot_array) * FI_SLOT_DEFAULT_CAPACITY);
+    fi.slot_capacity = FI_SLOT_DEFAULT_CAPACITY;
+
+    *fi_init = fi;
+    return;
+cleanup:
+    jfs_fi_free(&fi);
+    VOID_RETURN_ERR;
+}
+
+void jfs_fi_free(jfs_fi_t *fi_free) {
+    free(fi_free->entry_array);
+    free(fi_free->path_array);
+    free(fi_free->slot_array);
+    memset(fi_free, 0, sizeof(*fi_free));
+}
+
+void jfs_fi_load(jfs_fi_t *fi_init, const char *index_path, jfs_err_t *err) {
+    jfs_fi_t    fi = {0};
+    uint8_t    *file_buf = NULL;
+    struct stat file_stat;
+    int         fd = -1;
+
+    do {
+        if (*err == JFS_ERR_INTER) RES_ERR;
+        fd = jfs_open(index_path, O_RDONLY | O_CLOEXEC, 0, err);
+    } while (*err == JFS_ERR_INTER);
+    VOID_CHECK_ERR;
+
+    jfs_fstat(fd, &file_stat, err);
+    GOTO_IF_ERR(cleanup);
+    if ((size_t) file_stat.st_size < JFS_FI_HEADER_SIZE) GOTO_WITH_ERR(cleanup, JFS_ERR_FI_CORRUPT);
+
+    const size_t file_size = (size_t) file_stat.st_size;
+    file_buf = jfs_malloc(file_size, err);
+    GOTO_IF_ERR(cleanup);
+    (void) jfs_fio_read(fd, file_buf, file_size, err);
+    REMAP_ERR(JFS_ERR_FIO_FILE_END, JFS_ERR_FI_CORRUPT);
+    GOTO_IF_ERR(cleanup);
+
+    const uint64_t count = fi_get_u64(file_buf + 8); // NOLINT
+    if (fi_get_u32(file_buf) != FI_MAGIC || fi_get_u32(file_buf + 4) != FI_VERSION) GOTO_WITH_ERR(cleanup, JFS_ERR_FI_CORRUPT);
+    if (count > (file_size - JFS_FI_HEADER_SIZE) / JFS_FI_RECORD_SIZE) GOTO_WITH_ERR(cleanup, JFS_ERR_FI_CORRUPT);
+
+    jfs_fi_init(&fi, err);
+    GOTO_IF_ERR(cleanup);
+    fi_reserve(&fi, (size_t) count, file_size - JFS_FI_HEADER_SIZE - (size_t) count * JFS_FI_RECORD_SIZE, err);
+    GOTO_IF_ERR(cleanup);
+
+    size_t cursor = JFS_FI_HEADER_SIZE;
+    for (size_t i = 0; i < count; i++) {
+        if (file_size - cursor < JFS_FI_RECORD_SIZE) GOTO_WITH_ERR(cleanup, JFS_ERR_FI_CORRUPT);
+        const uint8_t *record = file_buf + cursor;
+        const size_t   path_len = fi_get_u16(record);
+        const size_t   state_len = fi_get_u16(record + 2);
+        if (path_len == 0 || path_len > PATH_MAX || state_len > JFS_FI_STATE_MAX || file_size - cursor - JFS_FI_RECORD_SIZE < path_len + state_len) {
+            GOTO_WITH_ERR(cleanup, JFS_ERR_FI_CORRUPT);
+        }
+
+        const char *path_str = (const char *) record + JFS_FI_RECORD_SIZE;
+        if (i > 0) {
+            // lookups binary search the loaded entries, so the order is checked rather than trusted
+            const jfs_fi_entry_t *prev = &fi.entry_array[i - 1];
+            if (fi_path_cmp(fi.path_array + prev->path_offset, prev->path_len, path_str, path_len) >= 0) {
+                GOTO_WITH_ERR(cleanup, JFS_ERR_FI_CORRUPT);
+            }
+        }
+
+        jfs_fi_entry_t *entry = &fi.entry_array[i];
+        entry->path_offset = fi.path_len;
+        entry->path_len = (uint16_t) path_len;
+        entry->state_len = (uint16_t) state_len;
+        entry->removed = false;
+        entry->stat.size = fi_get_u64(record + 4);                // NOLINT
+        entry->stat.mtime_ns = (int64_t) fi_get_u64(record + 12); // NOLINT
+        entry->stat.ctime_ns = (int64_t) fi_get_u64(record + 20); // NOLINT
+        entry->stat.inode = fi_get_u64(record + 28);              // NOLINT
+        memcpy(entry->hash, record + 36, JFS_FI_HASH_SIZE);       // NOLINT
+        entry->sample = fi_get_u64(record + 68);                  // NOLINT
+
+        memcpy(fi.path_array + fi.path_len, path_str, path_len + state_len);
+        fi.path_len += path_len + state_len;
+        cursor += JFS_FI_RECORD_SIZE + path_len + state_len;
+    }
+    if (cursor != file_size) GOTO_WITH_ERR(cleanup, JFS_ERR_FI_CORRUPT);
+
+    fi.count = (size_t) count;
+    fi.sorted_count = (size_t) count;
+    fi.saved_ns = (int64_t) file_stat.st_mtim.tv_sec * FI_NS_PER_SEC + file_stat.st_mtim.tv_nsec;
+
+    free(file_buf);
+    close(fd);
+    *fi_init = fi;
+    return;
+cleanup:
+    jfs_fi_free(&fi);
+    free(file_buf);
+    close(fd);
+    VOID_RETURN_ERR;
+}
+
+void jfs_fi_save(jfs_fi_t *fi, const jfs_fio_path_t *dir_path, const jfs_fio_name_t *name, jfs_err_t *err) {
+    jfs_fi_commit(fi, err);
+    VOID_CHECK_ERR;
+
+    size_t file_size = JFS_FI_HEADER_SIZE;
+    for (size_t i = 0; i < fi->count; i++) {
+        file_size += (size_t) JFS_FI_RECORD_SIZE + fi->entry_array[i].path_len + fi->entry_array[i].state_len;
+    }
+
+    jfs_fio_stage_t stage;
+    struct stat     file_stat;
+    uint8_t        *chunk = NULL;
+    off_t           off = 0;
+    size_t          chunk_len = JFS_FI_HEADER_SIZE;
+
+    jfs_fio_stage_init(&stage, dir_path, name, (off_t) file_size, FI_INDEX_MODE, err);
+    VOID_CHECK_ERR;
+
+    chunk = jfs_malloc(FI_SAVE_CHUNK_SIZE, err);
+    GOTO_IF_ERR(cleanup);
+
+    fi_put_u32(chunk, FI_MAGIC);
+    fi_put_u32(chunk + 4, FI_VERSION);           // NOLINT
+    fi_put_u64(chunk + 8, (uint64_t) fi->count); // NOLINT
+
+    for (size_t i = 0; i < fi->count; i++) {
+        const jfs_fi_entry_t *entry = &fi->entry_array[i];
+        const size_t          record_len = (size_t) JFS_FI_RECORD_SIZE + entry->path_len + entry->state_len;
+        if (chunk_len + record_len > FI_SAVE_CHUNK_SIZE) {
+            off += (off_t) jfs_fio_stage_write(&stage, chunk, chunk_len, off, err);
+            GOTO_IF_ERR(cleanup);
+            chunk_len = 0;
+        }
+        fi_record_pack(fi, entry, chunk + chunk_len);
+        chunk_len += record_len;
+    }
+    (void) jfs_fio_stage_write(&stage, chunk, chunk_len, off, err);
+    GOTO_IF_ERR(cleanup);
+
+    // entries changed within the index mtime granularity can't be trusted on the next load
+    jfs_fstat(stage.fd, &file_stat, err);
+    GOTO_IF_ERR(cleanup);
+
+    jfs_fio_stage_commit(&stage, err);
+    GOTO_IF_ERR(cleanup);
+    free(chunk);
+
+    fi->saved_ns = (int64_t) file_stat.st_mtim.tv_sec * FI_NS_PER_SEC + file_stat.st_mtim.tv_nsec;
+    return;
+cleanup:
+    jfs_fio_stage_abort(&stage);
+    free(chunk);
+    VOID_RETURN_ERR;
+}
+
+void jfs_fi_stat_from(jfs_fi_stat_t *fi_stat_out, const struct stat *sys_stat) {
+    fi_stat_out->size = (uint64_t) sys_stat->st_size;
+    fi_stat_out->mtime_ns = (int64_t) sys_stat->st_mtim.tv_sec * FI_NS_PER_SEC + sys_stat->st_mtim.tv_nsec;
+    fi_stat_out->ctime_ns = (int64_t) sys_stat->st_ctim.tv_sec * FI_NS_PER_SEC + sys_stat->st_ctim.tv_nsec;
+    fi_stat_out->inode = (uint64_t) sys_stat->st_ino;
+}
+
+const jfs_fi_entry_t *jfs_fi_lookup(const jfs_fi_t *fi, const char *path_str, size_t path_len) {
+    bool         found = false;
+    const size_t index = fi_find(fi, path_str, path_len, &found);
+    if (!found || fi->entry_array[index].removed) return NULL;
+    return &fi->entry_array[index];
+}
+
+bool jfs_fi_unchanged(const jfs_fi_t *fi, const jfs_fio_path_buf_t *path, const jfs_fi_stat_t *fi_stat, uint8_t *hash_out) {
+    const jfs_fi_entry_t *entry = jfs_fi_lookup(fi, path->data, path->len);
+    if (entry == NULL) return false;
+
+    // racily clean: a write in the same timestamp tick as the save leaves mtime unchanged
+    if (entry->stat.mtime_ns >= fi->saved_ns) return false;
+    if (memcmp(&entry->stat, fi_stat, sizeof(*fi_stat)) != 0) return false;
+
+    memcpy(hash_out, entry->hash, JFS_FI_HASH_SIZE);
+    return true;
+}
+
+void jfs_fi_update(jfs_fi_t *fi, const jfs_fio_path_buf_t *path, const jfs_fi_stat_t *fi_stat, const uint8_t *hash, uint64_t sample,
+                   const uint8_t *state, size_t state_len, jfs_err_t *err) {
+    VOID_FAIL_IF(path->len == 0 || path->len > PATH_MAX, JFS_ERR_ARG);
+    VOID_FAIL_IF(state_len > JFS_FI_STATE_MAX, JFS_ERR_ARG);
+
+    bool         found = false;
+    const size_t index = fi_find(fi, path->data, path->len, &found);
+    if (found) {
+        jfs_fi_entry_t *entry = &fi->entry_array[index];
+        if (state_len != entry->state_len) {
+            // a state of another length no longer fits behind the path, so both move to the end of the arena
+            fi_reserve(fi, fi->count, fi->path_len + path->len + state_len, err);
+            VOID_CHECK_ERR;
+            memcpy(fi->path_array + fi->path_len, path->data, path->len);
+            entry->path_offset = fi->path_len;
+            entry->state_len = (uint16_t) state_len;
+            fi->path_len += path->len + state_len;
+        }
+        if (state_len > 0) memcpy(fi->path_array + entry->path_offset + entry->path_len, state, state_len);
+        entry->removed = false;
+        entry->stat = *fi_stat;
+        memcpy(entry->hash, hash, JFS_FI_HASH_SIZE);
+        entry->sample = sample;
+        return;
+    }
+
+    // new paths are appended unsorted and merged in by jfs_fi_commit
+    fi_reserve(fi, fi->count + 1, fi->path_len + path->len + state_len, err);
+    VOID_CHECK_ERR;
+    fi_slot_reserve(fi, fi->count - fi->sorted_count + 1, err);
+    VOID_CHECK_ERR;
+
+    jfs_fi_entry_t *entry = &fi->entry_array[fi->count];
+    entry->path_offset = fi->path_len;
+    entry->path_len = (uint16_t) path->len;
+    entry->state_len = (uint16_t) state_len;
+    entry->removed = false;
+    entry->stat = *fi_stat;
+    memcpy(entry->hash, hash, JFS_FI_HASH_SIZE);
+    entry->sample = sample;
+
+    memcpy(fi->path_array + fi->path_len, path->data, path->len);
+    if (state_len > 0) memcpy(fi->path_array + fi->path_len + path->len, state, state_len);
+    fi->path_len += path->len + state_len;
+    fi_slot_put(fi, fi->count);
+    fi->count += 1;
+}
+
+uint64_t jfs_fi_sample(int fd, uint64_t size, jfs_err_t *err) {
+    uint8_t  buf[FI_SAMPLE_TAIL];
+    uint64_t hash = fi_fnv(FI_FNV_OFFSET, (const uint8_t *) &size, sizeof(size));
+
+    // fixed blocks spread over the file plus the bytes right before size, cheap regardless of length
+    for (uint64_t i = 0; i < FI_SAMPLE_BLOCKS; i++) {
+        const uint64_t off = size / FI_SAMPLE_BLOCKS * i;
+        const size_t   len = size - off < FI_SAMPLE_BLOCK ? (size_t) (size - off) : FI_SAMPLE_BLOCK;
+        const size_t   read = jfs_fio_pread(fd, buf, len, (off_t) off, err);
+        VAL_CHECK_ERR(0);
+        hash = fi_fnv(hash, buf, read);
+    }
+
+    const size_t tail_len = size < FI_SAMPLE_TAIL ? (size_t) size : FI_SAMPLE_TAIL;
+    const size_t read = jfs_fio_pread(fd, buf, tail_len, (off_t) (size - tail_len), err);
+    VAL_CHECK_ERR(0);
+    return fi_fnv(hash, buf, read);
+}
+
+jfs_fi_change_t jfs_fi_classify(const jfs_fi_t *fi, const jfs_fio_path_buf_t *path, int fd, const jfs_fi_stat_t *fi_stat, uint64_t *append_from_out,
+                                uint8_t *hash_out, jfs_err_t *err) {
+    const jfs_fi_entry_t *entry = jfs_fi_lookup(fi, path->data, path->len);
+    if (entry == NULL) return JFS_FI_NEW;
+    if (jfs_fi_unchanged(fi, path, fi_stat, hash_out)) return JFS_FI_UNCHANGED;
+
+    // a log that only grew keeps its inode and its old bytes, the sample only screens out edits cheaply
+    if (entry->stat.inode != fi_stat->inode || fi_stat->size <= entry->stat.size) return JFS_FI_MODIFIED;
+
+    const uint64_t sample = jfs_fi_sample(fd, entry->stat.size, err);
+    REMAP_ERR(JFS_ERR_FIO_FILE_END, JFS_OK); // truncated since the stat, so not an append
+    VAL_CHECK_ERR(JFS_FI_MODIFIED);
+    if (sample != entry->sample) return JFS_FI_MODIFIED;
+
+    *append_from_out = entry->stat.size;
+    return JFS_FI_APPENDED;
+}
+
+const uint8_t *jfs_fi_hash_state(const jfs_fi_t *fi, const jfs_fio_path_buf_t *path, uint64_t append_from, size_t *state_len_out) {
+    // the state was saved after the last byte of the old file, which is exactly the prefix an append keeps
+    const jfs_fi_entry_t *entry = jfs_fi_lookup(fi, path->data, path->len);
+    if (entry == NULL || entry->state_len == 0 || entry->stat.size != append_from) return NULL;
+
+    *state_len_out = entry->state_len;
+    return (const uint8_t *) fi->path_array + entry->path_offset + entry->path_len;
+}
+
+void jfs_fi_remove(jfs_fi_t *fi, const char *path_str, size_t path_len) {
+    bool         found = false;
+    const size_t index = fi_find(fi, path_str, path_len, &found);
+    if (found) fi->entry_array[index].removed = true;
+}
+
+void jfs_fi_commit(jfs_fi_t *fi, jfs_err_t *err) {
+    const size_t pending = fi->count - fi->sorted_count;
+
+    jfs_fi_entry_t *new_entry_array = NULL;
+    size_t         *order = NULL;
+    if (pending > 0) {
+        order = jfs_malloc(sizeof(*order) * pending, err);
+        VOID_CHECK_ERR;
+        for (size_t i = 0; i < pending; i++) {
+            order[i] = fi->sorted_count + i;
+        }
+        // ties break on position so the latest update of a repeated path wins
+        qsort_r(order, pending, sizeof(*order), fi_order_cmp, fi);
+    }
+
+    new_entry_array = jfs_malloc(sizeof(*new_entry_array) * (fi->count > 0 ? fi->count : 1), err);
+    GOTO_IF_ERR(cleanup);
+
+    size_t new_count = 0;
+    size_t sorted_index = 0;
+    size_t pending_index = 0;
+    while (sorted_index < fi->sorted_count || pending_index < pending) {
+        const jfs_fi_entry_t *entry = NULL;
+        if (pending_index == pending) {
+            entry = &fi->entry_array[sorted_index++];
+        } else {
+            // skip to the last of a run of repeated pending paths
+            const jfs_fi_entry_t *next = &fi->entry_array[order[pending_index]];
+            while (pending_index + 1 < pending) {
+                const jfs_fi_entry_t *after = &fi->entry_array[order[pending_index + 1]];
+                if (fi_path_cmp(fi->path_array + next->path_offset, next->path_len, fi->path_array + after->path_offset, after->path_len) != 0) break;
+                next = after;
+                pending_index += 1;
+            }
+
+            // pending paths were never in the sorted part, so the two sides never compare equal
+            if (sorted_index < fi->sorted_count) {
+                const jfs_fi_entry_t *sorted = &fi->entry_array[sorted_index];
+                if (fi_path_cmp(fi->path_array + sorted->path_offset, sorted->path_len, fi->path_array + next->path_offset, next->path_len) < 0) {
+                    entry = sorted;
+                    sorted_index += 1;
+                }
+            }
+            if (entry == NULL) {
+                entry = next;
+                pending_index += 1;
+            }
+        }
+        if (!entry->removed) new_entry_array[new_count++] = *entry;
+    }
+
+    // the path arena keeps dropped paths until the next load
+    free(fi->entry_array);
+    fi->entry_array = new_entry_array;
+    fi->capacity = fi->count > 0 ? fi->count : 1;
+    fi->count = new_count;
+    fi->sorted_count = new_count;
+    memset(fi->slot_array, 0, sizeof(*fi->slot_array) * fi->slot_capacity);
+    free(order);
+    return;
+cleanup:
+    free(order);
+    VOID_RETURN_ERR;
+}
+
+static int fi_path_cmp(const char *lhs_str, size_t lhs_len, const char *rhs_str, size_t rhs_len) {
+    const int cmp = memcmp(lhs_str, rhs_str, lhs_len < rhs_len ? lhs_len : rhs_len);
+    if (cmp != 0) return cmp;
+    return (lhs_len > rhs_len) - (lhs_len < rhs_len);
+}
+
+static int fi_order_cmp(const void *lhs, const void *rhs, void *ctx) {
+    const jfs_fi_t       *fi = (const jfs_fi_t *) ctx;
+    const size_t          lhs_index = *(const size_t *) lhs;
+    const size_t          rhs_index = *(const size_t *) rhs;
+    const jfs_fi_entry_t *lhs_entry = &fi->entry_array[lhs_index];
+    const jfs_fi_entry_t *rhs_entry = &fi->entry_array[rhs_index];
+
+    const int cmp = fi_path_cmp(fi->path_array + lhs_entry->path_offset, lhs_entry->path_len, fi->path_array + rhs_entry->path_offset,
+                                rhs_entry->path_len);
+    if (cmp != 0) return cmp;
+    return (lhs_index > rhs_index) - (lhs_index < rhs_index);
+}
+
+static size_t fi_find(const jfs_fi_t *fi, const char *path_str, size_t path_len, bool *found_out) {
+    size_t low = 0;
+    size_t high = fi->sorted_count;
+
+    while (low < high) {
+        const size_t          mid = low + (high - low) / 2;
+        const jfs_fi_entry_t *entry = &fi->entry_array[mid];
+        const int             cmp = fi_path_cmp(fi->path_array + entry->path_offset, entry->path_len, path_str, path_len);
+        if (cmp == 0) {
+            *found_out = true;
+            return mid;
+        }
+        if (cmp < 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    // paths added since the last commit are only reachable through the slots
+    const size_t mask = fi->slot_capacity - 1;
+    for (size_t slot = fi_fnv(FI_FNV_OFFSET, (const uint8_t *) path_str, path_len) & mask; fi->slot_array[slot] != 0; slot = (slot + 1) & mask) {
+        const size_t          index = fi->slot_array[slot] - 1;
+        const jfs_fi_entry_t *entry = &fi->entry_array[index];
+        if (fi_path_cmp(fi->path_array + entry->path_offset, entry->path_len, path_str, path_len) == 0) {
+            *found_out = true;
+            return index;
+        }
+    }
+
+    *found_out = false;
+    return low;
+}
+
+static void fi_reserve(jfs_fi_t *fi, size_t entry_count, size_t path_len, jfs_err_t *err) {
+    if (entry_count > fi->capacity) {
+        size_t new_capacity = fi->capacity * 2;
+        while (entry_count > new_capacity) {
+            new_capacity *= 2;
+        }
+        jfs_fi_entry_t *new_entry_array = jfs_realloc(fi->entry_array, sizeof(*new_entry_array) * new_capacity, err);
+        VOID_CHECK_ERR;
+
+        fi->entry_array = new_entry_array;
+        fi->capacity = new_capacity;
+    }
+
+    if (path_len > fi->path_capacity) {
+        size_t new_capacity = fi->path_capacity * 2;
+        while (path_len > new_capacity) {
+            new_capacity *= 2;
+        }
+        char *new_path_array = jfs_realloc(fi->path_array, new_capacity, err);
+        VOID_CHECK_ERR;
+
+        fi->path_array = new_path_array;
+        fi->path_capacity = new_capacity;
+    }
+}
+
+static void fi_slot_reserve(jfs_fi_t *fi, size_t pending_count, jfs_err_t *err) {
+    if (pending_count * 2 <= fi->slot_capacity) return;
+
+    size_t new_capacity = fi->slot_capacity * 2;
+    while (pending_count * 2 > new_capacity) {
+        new_capacity *= 2;
+    }
+    size_t *new_slot_array = jfs_malloc(sizeof(*new_slot_array) * new_capacity, err);
+    VOID_CHECK_ERR;
+    memset(new_slot_array, 0, sizeof(*new_slot_array) * new_capacity);
+
+    free(fi->slot_array);
+    fi->slot_array = new_slot_array;
+    fi->slot_capacity = new_capacity;
+    for (size_t i = fi->sorted_count; i < fi->count; i++) {
+        fi_slot_put(fi, i);
+    }
+}
+
+static void fi_slot_put(jfs_fi_t *fi, size_t index) {
+    const jfs_fi_entry_t *entry = &fi->entry_array[index];
+    const size_t          mask = fi->slot_capacity - 1;
+
+    size_t slot = fi_fnv(FI_FNV_OFFSET, (const uint8_t *) fi->path_array + entry->path_offset, entry->path_len) & mask;
+    while (fi->slot_array[slot] != 0) {
+        slot = (slot + 1) & mask;
+    }
+    fi->slot_array[slot] = index + 1;
+}
+
+static void fi_put_u16(uint8_t *ptr, uint16_t val) {
+    ptr[0] = (uint8_t) val;
+    ptr[1] = (uint8_t) (val >> 8); // NOLINT
+}
+
+static void fi_put_u32(uint8_t *ptr, uint32_t val) {
+    for (size_t i = 0; i < 4; i++) {
+        ptr[i] = (uint8_t) (val >> (i * 8)); // NOLINT
+    }
+}
+
+static void fi_put_u64(uint8_t *ptr, uint64_t val) {
+    for (size_t i = 0; i < 8; i++) {         // NOLINT
+        ptr[i] = (uint8_t) (val >> (i * 8)); // NOLINT
+    }
+}
+
+static uint16_t fi_get_u16(const uint8_t *ptr) {
+    return (uint16_t) (ptr[0] | (ptr[1] << 8)); // NOLINT
+}
+
+static uint32_t fi_get_u32(const uint8_t *ptr) {
+    uint32_t val = 0;
+    for (size_t i = 0; i < 4; i++) {
+        val |= (uint32_t) ptr[i] << (i * 8); // NOLINT
+    }
+    return val;
+}
+
+static uint64_t fi_get_u64(const uint8_t *ptr) {
+    uint64_t val = 0;
+    for (size_t i = 0; i < 8; i++) {         // NOLINT
+        val |= (uint64_t) ptr[i] << (i * 8); // NOLINT
+    }
+    return val;
+}
+
+static uint64_t fi_fnv(uint64_t hash, const uint8_t *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ data[i]) * FI_FNV_PRIME;
+    }
+    return hash;
+}
+
+static void fi_record_pack(const jfs_fi_t *fi, const jfs_fi_entry_t *entry, uint8_t *record) {
+    fi_put_u16(record, entry->path_len);
+    fi_put_u16(record + 2, entry->state_len);
+    fi_put_u64(record + 4, entry->stat.size);                 // NOLINT
+    fi_put_u64(record + 12, (uint64_t) entry->stat.mtime_ns); // NOLINT
+    fi_put_u64(record + 20, (uint64_t) entry->stat.ctime_ns); // NOLINT
+    fi_put_u64(record + 28, entry->stat.inode);               // NOLINT
+    memcpy(record + 36, entry->hash, JFS_FI_HASH_SIZE);       // NOLINT
+    fi_put_u64(record + 68, entry->sample);                   // NOLINT
+    memcpy(record + JFS_FI_RECORD_SIZE, fi->path_array + entry->path_offset, entry->path_len + entry->state_len);
+}
@@ -1,9 +1,29 @@
 #include "file_io.h"
 #include "error.h"
+#include <fcntl.h>
 #include <limits.h>
+#include <linux/fs.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#define FIO_COPY_BUF_SIZE   ((size_t) 65536)   // 64 kb
+#define FIO_BULK_ALIGN      ((size_t) 4096)    // 4 kb
+#define FIO_BULK_DROP_BYTES ((off_t) 8388608)  // 8 mb
+#define FIO_STAGE_PREFIX    ".jfs-"
+
+static atomic_uint fio_stage_counter = 0;
+
+static size_t fio_copy_range(int dest_fd, off_t dest_off, int src_fd, off_t src_off, size_t size, jfs_err_t *err);
+static size_t fio_copy_buffered(int dest_fd, off_t dest_off, int src_fd, off_t src_off, size_t size, jfs_err_t *err);
+static void   fio_bulk_to_buffered(jfs_fio_bulk_t *bulk, jfs_err_t *err);
+static void   fio_bulk_drop_behind(jfs_fio_bulk_t *bulk);
+static int    fio_stage_open_named(jfs_fio_stage_t *stage, const char *name_str, mode_t mode, jfs_err_t *err) WUR;
+static void   fio_stage_make_tmp_name(char *tmp_name, size_t tmp_size, const char *name_str);
+static void   fio_stage_publish_anonymous(jfs_fio_stage_t *stage, jfs_err_t *err);
 
 size_t jfs_fio_write(int fd, const void *buf, size_t size, jfs_err_t *err) {
     const uint8_t *write_buf = (uint8_t *) buf;
@@ -37,6 +57,306 @@ size_t jfs_fio_read(int fd, void *buf, size_t size, jfs_err_t *err) {
     return total_read;
 }
 
+size_t jfs_fio_pwrite(int fd, const void *buf, size_t size, off_t off, jfs_err_t *err) {
+    const uint8_t *write_buf = (uint8_t *) buf;
+    size_t         total_written = 0;
+
+    while (total_written < size) {
+        const off_t  write_off = off + (off_t) total_written;
+        const size_t written = jfs_pwrite(fd, write_buf + total_written, size - total_written, write_off, err);
+        if (*err == JFS_ERR_INTER) {
+            RES_ERR;
+            continue;
+        }
+        VAL_CHECK_ERR(total_written);
+        total_written += written;
+    }
+
+    return total_written;
+}
+
+size_t jfs_fio_pread(int fd, void *buf, size_t size, off_t off, jfs_err_t *err) {
+    uint8_t *read_buf = (uint8_t *) buf;
+    size_t   total_read = 0;
+
+    while (total_read < size) {
+        const size_t read = jfs_pread(fd, read_buf + total_read, size - total_read, off + (off_t) total_read, err);
+        if (*err == JFS_ERR_INTER) {
+            RES_ERR;
+            continue;
+        }
+        VAL_CHECK_ERR(total_read);
+        VAL_FAIL_IF(read == 0, JFS_ERR_FIO_FILE_END, total_read);
+        total_read += read;
+    }
+
+    return total_read;
+}
+
+size_t jfs_fio_pread_nowait(int fd, void *buf, size_t size, off_t off, jfs_err_t *err) {
+    uint8_t *read_buf = (uint8_t *) buf;
+    size_t   total_read = 0;
+
+    // stops with JFS_ERR_AGAIN at the first page that is not cached, the caller finishes from total_read
+    while (total_read < size) {
+        const struct iovec iov = {.iov_base = read_buf + total_read, .iov_len = size - total_read};
+        const size_t       read = jfs_preadv2(fd, &iov, 1, off + (off_t) total_read, RWF_NOWAIT, err);
+        if (*err == JFS_ERR_INTER) {
+            RES_ERR;
+            continue;
+        }
+        if (*err == JFS_ERR_FIO_UNSUPPORTED) *err = JFS_ERR_AGAIN; // no RWF_NOWAIT on this filesystem
+        if (*err == JFS_ERR_AGAIN) return total_read;
+        VAL_CHECK_ERR(total_read);
+        VAL_FAIL_IF(read == 0, JFS_ERR_FIO_FILE_END, total_read);
+        total_read += read;
+    }
+
+    return total_read;
+}
+
+size_t jfs_fio_copy(int dest_fd, off_t dest_off, int src_fd, off_t src_off, size_t size, jfs_err_t *err) {
+    if (size == 0) return 0;
+
+    // reflink shares the extents so nothing is copied, only works on aligned ranges of cow filesystems
+    const struct file_clone_range range = {
+        .src_fd = src_fd,
+        .src_offset = (uint64_t) src_off,
+        .src_length = size,
+        .dest_offset = (uint64_t) dest_off,
+    };
+    jfs_ficlonerange(dest_fd, &range, err);
+    if (*err == JFS_OK) return size;
+    if (*err != JFS_ERR_FIO_UNSUPPORTED) VAL_RETURN_ERR(0);
+    RES_ERR;
+
+    size_t copied = fio_copy_range(dest_fd, dest_off, src_fd, src_off, size, err);
+    if (*err == JFS_OK) return copied;
+    if (*err != JFS_ERR_FIO_UNSUPPORTED) VAL_RETURN_ERR(copied);
+    RES_ERR;
+
+    const off_t done_off = (off_t) copied;
+    copied += fio_copy_buffered(dest_fd, dest_off + done_off, src_fd, src_off + done_off, size - copied, err);
+    VAL_CHECK_ERR(copied);
+
+    return copied;
+}
+
+void jfs_fio_bulk_init(jfs_fio_bulk_t *bulk_init, const char *path_str, size_t buf_size, jfs_err_t *err) {
+    VOID_FAIL_IF(buf_size == 0, JFS_ERR_ARG);
+
+    const size_t aligned_size = (buf_size + FIO_BULK_ALIGN - 1) & ~(FIO_BULK_ALIGN - 1);
+    uint8_t     *new_buf = jfs_aligned_alloc(FIO_BULK_ALIGN, aligned_size, err);
+    VOID_CHECK_ERR;
+
+    bool new_direct = true;
+    int  new_fd = -1;
+    do {
+        if (*err == JFS_ERR_INTER) RES_ERR;
+        new_fd = jfs_open(path_str, O_RDONLY | O_DIRECT | O_CLOEXEC, 0, err);
+    } while (*err == JFS_ERR_INTER);
+
+    if (*err == JFS_ERR_ARG) { // filesystem has no O_DIRECT support
+        RES_ERR;
+        new_direct = false;
+        do {
+            if (*err == JFS_ERR_INTER) RES_ERR;
+            new_fd = jfs_open(path_str, O_RDONLY | O_CLOEXEC, 0, err);
+        } while (*err == JFS_ERR_INTER);
+    }
+
+    if (*err != JFS_OK) {
+        free(new_buf);
+        VOID_RETURN_ERR;
+    }
+
+    bulk_init->fd = new_fd;
+    bulk_init->direct = new_direct;
+    bulk_init->offset = 0;
+    bulk_init->dropped = 0;
+    bulk_init->buf_size = aligned_size;
+    bulk_init->buf = new_buf;
+
+    if (!new_direct) {
+        jfs_posix_fadvise(new_fd, 0, 0, POSIX_FADV_SEQUENTIAL, err);
+        if (*err != JFS_OK) RES_ERR; // only a hint
+    }
+}
+
+void jfs_fio_bulk_free(jfs_fio_bulk_t *bulk_free) {
+    if (bulk_free->fd != -1) {
+        if (!bulk_free->direct) fio_bulk_drop_behind(bulk_free);
+        close(bulk_free->fd);
+    }
+    free(bulk_free->buf);
+    memset(bulk_free, 0, sizeof(*bulk_free));
+    bulk_free->fd = -1;
+}
+
+size_t jfs_fio_bulk_read(jfs_fio_bulk_t *bulk, const uint8_t **data_out, jfs_err_t *err) {
+    size_t total_read = 0;
+
+    // O_DIRECT only stops off alignment at the end of the file, a read from there would be refused with EINVAL
+    VAL_FAIL_IF(bulk->direct && (size_t) bulk->offset % FIO_BULK_ALIGN != 0, JFS_ERR_FIO_FILE_END, 0);
+
+    while (total_read < bulk->buf_size) {
+        const size_t read = jfs_pread(bulk->fd, bulk->buf + total_read, bulk->buf_size - total_read, bulk->offset, err);
+        if (*err == JFS_ERR_INTER) {
+            RES_ERR;
+            continue;
+        }
+        if (*err == JFS_ERR_ARG && bulk->direct) { // O_DIRECT accepted at open but refused for io
+            RES_ERR;
+            fio_bulk_to_buffered(bulk, err);
+            VAL_CHECK_ERR(0);
+            continue;
+        }
+        VAL_CHECK_ERR(0);
+        if (read == 0) break;
+
+        total_read += read;
+        bulk->offset += (off_t) read;
+        if (bulk->direct && (size_t) bulk->offset % FIO_BULK_ALIGN != 0) break; // unaligned tail of the file
+    }
+
+    if (!bulk->direct && bulk->offset - bulk->dropped >= FIO_BULK_DROP_BYTES) fio_bulk_drop_behind(bulk);
+    VAL_FAIL_IF(total_read == 0, JFS_ERR_FIO_FILE_END, 0);
+
+    *data_out = bulk->buf;
+    return total_read;
+}
+
+void jfs_fio_stage_init(jfs_fio_stage_t *stage_init, const jfs_fio_path_t *dir_path, const jfs_fio_name_t *name, off_t size, mode_t mode,
+                        jfs_err_t *err) {
+    VOID_FAIL_IF(dir_path->len == 0, JFS_ERR_ARG);
+
+    const int dir_fd = jfs_open(dir_path->str, O_PATH | O_DIRECTORY | O_CLOEXEC, 0, err);
+    VOID_CHECK_ERR;
+
+    jfs_fio_stage_init_at(stage_init, dir_fd, name, size, mode, err);
+    if (*err != JFS_OK) {
+        close(dir_fd);
+        VOID_RETURN_ERR;
+    }
+    stage_init->own_dir = true;
+}
+
+void jfs_fio_stage_init_at(jfs_fio_stage_t *stage_init, int dir_fd, const jfs_fio_name_t *name, off_t size, mode_t mode, jfs_err_t *err) {
+    VOID_FAIL_IF(name->len == 0 || size < 0, JFS_ERR_ARG);
+
+    jfs_fio_stage_t stage = {.fd = -1, .dir_fd = dir_fd, .anonymous = true, .size = size};
+    strlcpy(stage.name, name->str, sizeof(stage.name));
+
+    stage.fd = jfs_openat(stage.dir_fd, ".", O_TMPFILE | O_WRONLY | O_CLOEXEC, mode, err);
+    if (*err == JFS_ERR_FIO_UNSUPPORTED) {
+        RES_ERR;
+        stage.anonymous = false;
+        stage.fd = fio_stage_open_named(&stage, name->str, mode, err);
+    }
+    GOTO_IF_ERR(cleanup);
+
+    if (size > 0) {
+        jfs_fallocate(stage.fd, 0, 0, size, err);
+        if (*err == JFS_ERR_FIO_UNSUPPORTED) RES_ERR; // still correct, just not contiguous
+        GOTO_IF_ERR(cleanup);
+    }
+
+    *stage_init = stage;
+    return;
+cleanup:
+    jfs_fio_stage_abort(&stage);
+    VOID_RETURN_ERR;
+}
+
+void jfs_fio_stage_finish(const jfs_fio_stage_t *stage, jfs_err_t *err) {
+    // without fallocate a file ending in a hole is only as long as its last write
+    do {
+        if (*err == JFS_ERR_INTER) RES_ERR;
+        jfs_ftruncate(stage->fd, stage->size, err);
+    } while (*err == JFS_ERR_INTER);
+    VOID_CHECK_ERR;
+}
+
+void jfs_fio_stage_commit(jfs_fio_stage_t *stage_free, jfs_err_t *err) {
+    jfs_fio_stage_finish(stage_free, err);
+    VOID_CHECK_ERR;
+
+    if (stage_free->anonymous) {
+        fio_stage_publish_anonymous(stage_free, err);
+        VOID_CHECK_ERR;
+    } else {
+        jfs_renameat(stage_free->dir_fd, stage_free->tmp_name, stage_free->dir_fd, stage_free->name, err);
+        VOID_CHECK_ERR;
+        stage_free->tmp_name[0] = '\0';
+    }
+
+    jfs_fio_stage_abort(stage_free);
+}
+
+void jfs_fio_stage_abort(jfs_fio_stage_t *stage_free) {
+    if (stage_free->fd != -1) close(stage_free->fd);
+    if (stage_free->dir_fd != -1) {
+        if (stage_free->tmp_name[0] != '\0') unlinkat(stage_free->dir_fd, stage_free->tmp_name, 0);
+        if (stage_free->own_dir) close(stage_free->dir_fd);
+    }
+    memset(stage_free, 0, sizeof(*stage_free));
+    stage_free->fd = -1;
+    stage_free->dir_fd = -1;
+}
+
+size_t jfs_fio_stage_write(const jfs_fio_stage_t *stage, const void *buf, size_t size, off_t off, jfs_err_t *err) {
+    const size_t written = jfs_fio_pwrite(stage->fd, buf, size, off, err);
+    VAL_CHECK_ERR(written);
+    return written;
+}
+
+void jfs_fio_stage_hole(const jfs_fio_stage_t *stage, off_t off, off_t len, jfs_err_t *err) {
+    VOID_FAIL_IF(off < 0 || len < 0, JFS_ERR_ARG);
+    if (len == 0) return;
+
+    jfs_fallocate(stage->fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, off, len, err);
+    if (*err == JFS_ERR_FIO_UNSUPPORTED) RES_ERR; // unwritten preallocated space already reads back as zeros
+    VOID_CHECK_ERR;
+}
+
+void jfs_fio_sparse_init(jfs_fio_sparse_t *sparse_init, int fd, off_t size) {
+    sparse_init->fd = fd;
+    sparse_init->cursor = 0;
+    sparse_init->size = size;
+}
+
+int jfs_fio_sparse_next(jfs_fio_sparse_t *sparse, jfs_fio_extent_t *extent_out, jfs_err_t *err) {
+    if (sparse->cursor >= sparse->size) return 0;
+
+    off_t data_off = jfs_lseek(sparse->fd, sparse->cursor, SEEK_DATA, err);
+    if (*err == JFS_ERR_FIO_FILE_END) { // only a hole is left
+        RES_ERR;
+        sparse->cursor = sparse->size;
+        return 0;
+    }
+    if (*err == JFS_ERR_FIO_UNSUPPORTED) { // treat everything left as data
+        RES_ERR;
+        extent_out->offset = sparse->cursor;
+        extent_out->len = sparse->size - sparse->cursor;
+        sparse->cursor = sparse->size;
+        return 1;
+    }
+    VAL_CHECK_ERR(0);
+    if (data_off >= sparse->size) {
+        sparse->cursor = sparse->size;
+        return 0;
+    }
+
+    off_t hole_off = jfs_lseek(sparse->fd, data_off, SEEK_HOLE, err);
+    VAL_CHECK_ERR(0);
+    if (hole_off > sparse->size) hole_off = sparse->size;
+
+    extent_out->offset = data_off;
+    extent_out->len = hole_off - data_off;
+    sparse->cursor = hole_off;
+    return 1;
+}
+
 void jfs_fio_path_init(jfs_fio_path_t *path_init, const char *path_str, jfs_err_t *err) {
     size_t path_str_len = strlen(path_str);
 
@@ -87,21 +407,147 @@ void jfs_fio_name_transfer(jfs_fio_name_t *name_init, jfs_fio_name_t *name_free)
 
 void jfs_fio_path_buf_clear(jfs_fio_path_buf_t *buf) {
     buf->len = 0;
-    memset(buf->data, 0, sizeof(buf->data));
+    buf->data[0] = '\0';
 }
 
 void jfs_fio_path_buf_copy(jfs_fio_path_buf_t *buf, const jfs_fio_path_t *path, jfs_err_t *err) {
     VOID_FAIL_IF(path->len == 0, JFS_ERR_ARG);
-    jfs_fio_path_buf_clear(buf);
-    strlcpy(buf->data, path->str, sizeof(buf->data));
+    memcpy(buf->data, path->str, path->len + 1);
     buf->len = path->len;
 }
 
 void jfs_fio_path_buf_compose(jfs_fio_path_buf_t *buf, const jfs_fio_path_t *path, const jfs_fio_name_t *name, jfs_err_t *err) {
-    VOID_FAIL_IF(path->len == 0, JFS_ERR_ARG);
-    const size_t new_len = path->len + name->len + 1;
+    jfs_fio_path_buf_copy(buf, path, err);
+    VOID_CHECK_ERR;
+    jfs_fio_path_buf_push(buf, name, err);
+    VOID_CHECK_ERR;
+}
+
+void jfs_fio_path_buf_push(jfs_fio_path_buf_t *buf, const jfs_fio_name_t *name, jfs_err_t *err) {
+    VOID_FAIL_IF(buf->len == 0 || name->len == 0, JFS_ERR_ARG);
+
+    // only a root of "/" already ends in a separator
+    const size_t sep_len = buf->data[buf->len - 1] == '/' ? 0 : 1;
+    const size_t new_len = buf->len + sep_len + name->len;
     VOID_FAIL_IF(new_len > PATH_MAX, JFS_ERR_FIO_PATH_OVERFLOW);
-    jfs_fio_path_buf_clear(buf);
-    snprintf(buf->data, sizeof(buf->data), "%s/%s", path->str, name->str);
+
+    if (sep_len == 1) buf->data[buf->len] = '/';
+    memcpy(buf->data + buf->len + sep_len, name->str, name->len);
+    buf->data[new_len] = '\0';
+    buf->len = new_len;
+}
+
+void jfs_fio_path_buf_pop(jfs_fio_path_buf_t *buf, jfs_err_t *err) {
+    const char *sep = buf->len > 1 ? memrchr(buf->data, '/', buf->len - 1) : NULL;
+    VOID_FAIL_IF(sep == NULL, JFS_ERR_EMPTY);
+
+    // keep the separator when popping back to "/"
+    const size_t new_len = sep == buf->data ? 1 : (size_t) (sep - buf->data);
+    buf->data[new_len] = '\0';
     buf->len = new_len;
 }
+
+static size_t fio_copy_range(int dest_fd, off_t dest_off, int src_fd, off_t src_off, size_t size, jfs_err_t *err) {
+    off_t  in_off = src_off;
+    off_t  out_off = dest_off;
+    size_t total_copied = 0;
+
+    while (total_copied < size) {
+        const size_t copied = jfs_copy_file_range(src_fd, &in_off, dest_fd, &out_off, size - total_copied, err);
+        if (*err == JFS_ERR_INTER) {
+            RES_ERR;
+            continue;
+        }
+        VAL_CHECK_ERR(total_copied);
+        VAL_FAIL_IF(copied == 0, JFS_ERR_FIO_FILE_END, total_copied);
+        total_copied += copied;
+    }
+
+    return total_copied;
+}
+
+static size_t fio_copy_buffered(int dest_fd, off_t dest_off, int src_fd, off_t src_off, size_t size, jfs_err_t *err) {
+    uint8_t buf[FIO_COPY_BUF_SIZE];
+    size_t  total_copied = 0;
+
+    while (total_copied < size) {
+        const size_t chunk = size - total_copied < sizeof(buf) ? size - total_copied : sizeof(buf);
+        const off_t  done_off = (off_t) total_copied;
+
+        jfs_fio_pread(src_fd, buf, chunk, src_off + done_off, err);
+        VAL_CHECK_ERR(total_copied);
+
+        jfs_fio_pwrite(dest_fd, buf, chunk, dest_off + done_off, err);
+        VAL_CHECK_ERR(total_copied);
+
+        total_copied += chunk;
+    }
+
+    return total_copied;
+}
+
+static void fio_bulk_to_buffered(jfs_fio_bulk_t *bulk, jfs_err_t *err) {
+    const int flags = jfs_fcntl(bulk->fd, F_GETFL, 0, err);
+    VOID_CHECK_ERR;
+
+    jfs_fcntl(bulk->fd, F_SETFL, flags & ~O_DIRECT, err);
+    VOID_CHECK_ERR;
+
+    bulk->direct = false;
+    bulk->dropped = bulk->offset;
+    jfs_posix_fadvise(bulk->fd, 0, 0, POSIX_FADV_SEQUENTIAL, err);
+    if (*err != JFS_OK) RES_ERR;
+}
+
+static void fio_bulk_drop_behind(jfs_fio_bulk_t *bulk) {
+    jfs_err_t err = JFS_OK;
+    jfs_posix_fadvise(bulk->fd, bulk->dropped, bulk->offset - bulk->dropped, POSIX_FADV_DONTNEED, &err); // only a hint
+    bulk->dropped = bulk->offset;
+}
+
+static int fio_stage_open_named(jfs_fio_stage_t *stage, const char *name_str, mode_t mode, jfs_err_t *err) {
+    int fd = -1;
+    do {
+        if (*err == JFS_ERR_EXIST || *err == JFS_ERR_INTER) RES_ERR;
+        fio_stage_make_tmp_name(stage->tmp_name, sizeof(stage->tmp_name), name_str);
+        fd = jfs_openat(stage->dir_fd, stage->tmp_name, O_CREAT | O_EXCL | O_WRONLY | O_CLOEXEC, mode, err);
+    } while (*err == JFS_ERR_EXIST || *err == JFS_ERR_INTER);
+
+    if (*err != JFS_OK) {
+        stage->tmp_name[0] = '\0';
+        VAL_RETURN_ERR(-1);
+    }
+
+    return fd;
+}
+
+static void fio_stage_make_tmp_name(char *tmp_name, size_t tmp_size, const char *name_str) {
+    const unsigned int count = atomic_fetch_add_explicit(&fio_stage_counter, 1, memory_order_relaxed);
+    // the name is cut short so the suffix always fits in NAME_MAX
+    snprintf(tmp_name, tmp_size, FIO_STAGE_PREFIX "%.200s.%d.%u", name_str, (int) getpid(), count);
+}
+
+static void fio_stage_publish_anonymous(jfs_fio_stage_t *stage, jfs_err_t *err) {
+    char proc_path[sizeof("/proc/self/fd/") + 16];
+    snprintf(proc_path, sizeof(proc_path), "/proc/self/fd/%d", stage->fd);
+
+    jfs_linkat(AT_FDCWD, proc_path, stage->dir_fd, stage->name, AT_SYMLINK_FOLLOW, err);
+    if (*err == JFS_OK) return;
+    if (*err != JFS_ERR_EXIST) VOID_RETURN_ERR;
+    RES_ERR;
+
+    // linkat never replaces, so an existing file is swapped out with a rename from a named link
+    do {
+        if (*err == JFS_ERR_EXIST) RES_ERR;
+        fio_stage_make_tmp_name(stage->tmp_name, sizeof(stage->tmp_name), stage->name);
+        jfs_linkat(AT_FDCWD, proc_path, stage->dir_fd, stage->tmp_name, AT_SYMLINK_FOLLOW, err);
+    } while (*err == JFS_ERR_EXIST);
+    if (*err != JFS_OK) {
+        stage->tmp_name[0] = '\0';
+        VOID_RETURN_ERR;
+    }
+
+    jfs_renameat(stage->dir_fd, stage->tmp_name, stage->dir_fd, stage->name, err);
+    VOID_CHECK_ERR;
+    stage->tmp_name[0] = '\0';
+}
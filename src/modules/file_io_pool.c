@@ -0,0 +1,125 @@
+#include "file_io_pool.h"
+#include "error.h"
+#include "file_io.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FIO_POOL_DEFAULT_THREADS 4
+
+struct jfs_fio_pool {
+    pthread_mutex_t      lock;
+    pthread_cond_t       queued;
+    jfs_fio_pool_req_t  *front;
+    jfs_fio_pool_req_t  *back;
+    bool                 stop;
+    uint32_t             thread_count;
+    pthread_t           *thread_array;
+    jfs_fio_pool_done_fn done;
+    void                *done_ctx;
+};
+
+static void *fio_pool_work(void *arg);
+
+jfs_fio_pool_t *jfs_fio_pool_create(const jfs_fio_pool_conf_t *conf, jfs_err_t *err) {
+    NULL_FAIL_IF(conf->done == NULL, JFS_ERR_BAD_CONF);
+
+    jfs_fio_pool_t *pool = jfs_malloc(sizeof(*pool), err);
+    NULL_CHECK_ERR;
+    memset(pool, 0, sizeof(*pool));
+    pool->done = conf->done;
+    pool->done_ctx = conf->done_ctx;
+
+    const uint32_t thread_count = conf->thread_count == 0 ? FIO_POOL_DEFAULT_THREADS : conf->thread_count;
+    pool->thread_array = jfs_malloc(sizeof(*pool->thread_array) * thread_count, err);
+    GOTO_IF_ERR(cleanup_pool);
+
+    jfs_mutex_init(&pool->lock, NULL, err);
+    GOTO_IF_ERR(cleanup_threads);
+    jfs_cond_init(&pool->queued, NULL, err);
+    GOTO_IF_ERR(cleanup_lock);
+
+    for (; pool->thread_count < thread_count; pool->thread_count++) {
+        jfs_pthread_create(&pool->thread_array[pool->thread_count], NULL, fio_pool_work, pool, err);
+        if (*err != JFS_OK) {
+            jfs_fio_pool_destroy(pool);
+            NULL_RETURN_ERR;
+        }
+    }
+
+    return pool;
+cleanup_lock:
+    pthread_mutex_destroy(&pool->lock);
+cleanup_threads:
+    free(pool->thread_array);
+cleanup_pool:
+    free(pool);
+    NULL_RETURN_ERR;
+}
+
+void jfs_fio_pool_destroy(jfs_fio_pool_t *pool_move) {
+    pthread_mutex_lock(&pool_move->lock);
+    pool_move->stop = true;
+    pthread_cond_broadcast(&pool_move->queued);
+    pthread_mutex_unlock(&pool_move->lock);
+
+    for (uint32_t i = 0; i < pool_move->thread_count; i++) {
+        pthread_join(pool_move->thread_array[i], NULL);
+    }
+
+    pthread_cond_destroy(&pool_move->queued);
+    pthread_mutex_destroy(&pool_move->lock);
+    free(pool_move->thread_array);
+    free(pool_move);
+}
+
+bool jfs_fio_pool_read(jfs_fio_pool_t *pool, jfs_fio_pool_req_t *req) {
+    // cached data is copied on the calling thread, only a page cache miss costs a handoff
+    req->err = JFS_OK;
+    req->result = jfs_fio_pread_nowait(req->fd, req->buf, req->size, req->offset, &req->err);
+    if (req->err != JFS_ERR_AGAIN) return true;
+
+    req->err = JFS_OK;
+    req->next = NULL;
+
+    pthread_mutex_lock(&pool->lock);
+    if (pool->back == NULL) {
+        pool->front = req;
+    } else {
+        pool->back->next = req;
+    }
+    pool->back = req;
+    pthread_cond_signal(&pool->queued);
+    pthread_mutex_unlock(&pool->lock);
+
+    return false;
+}
+
+static void *fio_pool_work(void *arg) {
+    jfs_fio_pool_t *pool = (jfs_fio_pool_t *) arg;
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (pool->front == NULL && !pool->stop) {
+            pthread_cond_wait(&pool->queued, &pool->lock);
+        }
+        if (pool->front == NULL) break; // stopping and drained
+
+        jfs_fio_pool_req_t *req = pool->front;
+        pool->front = req->next;
+        if (pool->front == NULL) pool->back = NULL;
+        pthread_mutex_unlock(&pool->lock);
+
+        // picks up where the inline attempt stopped
+        const size_t done_size = req->result;
+        req->result = done_size + jfs_fio_pread(req->fd, (uint8_t *) req->buf + done_size, req->size - done_size,
+                                                req->offset + (off_t) done_size, &req->err);
+        pool->done(req, pool->done_ctx);
+
+        pthread_mutex_lock(&pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
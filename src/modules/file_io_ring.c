@@ -0,0 +1,247 @@
+#include "file_io_ring.h"
+#include "error.h"
+#include <linux/io_uring.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define DEFAULT_RING_ENTRIES 256
+
+typedef struct fio_ring_sq fio_ring_sq_t;
+typedef struct fio_ring_cq fio_ring_cq_t;
+
+struct fio_ring_sq {
+    _Atomic(uint32_t)   *head;
+    _Atomic(uint32_t)   *tail;
+    uint32_t            *array;
+    uint32_t             mask;
+    uint32_t             entries;
+    uint32_t             local_tail;
+    struct io_uring_sqe *sqes;
+    size_t               sqes_size;
+};
+
+struct fio_ring_cq {
+    _Atomic(uint32_t)   *head;
+    _Atomic(uint32_t)   *tail;
+    uint32_t             mask;
+    uint32_t             entries;
+    struct io_uring_cqe *cqes;
+};
+
+struct jfs_fio_ring {
+    int                  fd;
+    void                *sq_map;
+    size_t               sq_map_size;
+    void                *cq_map;
+    size_t               cq_map_size;
+    fio_ring_sq_t        sq;
+    fio_ring_cq_t        cq;
+    uint32_t             to_submit;
+    uint32_t             in_flight;
+    jfs_fio_ring_done_fn done;
+    void                *done_ctx;
+};
+
+static void      fio_ring_map(jfs_fio_ring_t *ring, const struct io_uring_params *params, jfs_err_t *err);
+static void      fio_ring_unmap(jfs_fio_ring_t *ring);
+static jfs_err_t fio_ring_map_res(int res) WUR;
+
+jfs_fio_ring_t *jfs_fio_ring_create(const jfs_fio_ring_conf_t *conf, jfs_err_t *err) {
+    NULL_FAIL_IF(conf->done == NULL, JFS_ERR_BAD_CONF);
+
+    jfs_fio_ring_t *ring = jfs_malloc(sizeof(*ring), err);
+    NULL_CHECK_ERR;
+    memset(ring, 0, sizeof(*ring));
+    ring->fd = -1;
+
+    struct io_uring_params params = {0};
+    const uint32_t         entries = conf->entries ? conf->entries : DEFAULT_RING_ENTRIES;
+
+    ring->fd = jfs_io_uring_setup(entries, &params, err);
+    GOTO_IF_ERR(cleanup);
+
+    fio_ring_map(ring, &params, err);
+    GOTO_IF_ERR(cleanup);
+
+    ring->done = conf->done;
+    ring->done_ctx = conf->done_ctx;
+    return ring;
+cleanup:
+    fio_ring_unmap(ring);
+    if (ring->fd != -1) close(ring->fd);
+    free(ring);
+    NULL_RETURN_ERR;
+}
+
+void jfs_fio_ring_destroy(jfs_fio_ring_t *ring_move) {
+    if (ring_move == NULL) return;
+    fio_ring_unmap(ring_move);
+    if (ring_move->fd != -1) close(ring_move->fd);
+    free(ring_move);
+}
+
+void jfs_fio_ring_register_buffers(jfs_fio_ring_t *ring, const struct iovec *iov_array, uint32_t iov_count, jfs_err_t *err) {
+    VOID_FAIL_IF(iov_count == 0 || iov_count >= JFS_FIO_RING_NO_BUF_INDEX, JFS_ERR_ARG);
+    do {
+        if (*err == JFS_ERR_INTER) RES_ERR;
+        jfs_io_uring_register(ring->fd, IORING_REGISTER_BUFFERS, iov_array, iov_count, err);
+    } while (*err == JFS_ERR_INTER);
+    VOID_CHECK_ERR;
+}
+
+void jfs_fio_ring_register_files(jfs_fio_ring_t *ring, const int *fd_array, uint32_t fd_count, jfs_err_t *err) {
+    VOID_FAIL_IF(fd_count == 0, JFS_ERR_ARG);
+    do {
+        if (*err == JFS_ERR_INTER) RES_ERR;
+        jfs_io_uring_register(ring->fd, IORING_REGISTER_FILES, fd_array, fd_count, err);
+    } while (*err == JFS_ERR_INTER);
+    VOID_CHECK_ERR;
+}
+
+void jfs_fio_ring_queue(jfs_fio_ring_t *ring, jfs_fio_ring_req_t *req, jfs_err_t *err) {
+    fio_ring_sq_t *sq = &ring->sq;
+
+    // the cq is only guaranteed to hold cq.entries completions, more in flight could overflow it
+    VOID_FAIL_IF(ring->in_flight + ring->to_submit >= ring->cq.entries, JFS_ERR_FULL);
+    const uint32_t head = atomic_load_explicit(sq->head, memory_order_acquire);
+    VOID_FAIL_IF(sq->local_tail - head >= sq->entries, JFS_ERR_FULL);
+    VOID_FAIL_IF(req->size > UINT32_MAX, JFS_ERR_ARG);
+
+    const bool fixed_buf = req->buf_index != JFS_FIO_RING_NO_BUF_INDEX;
+    uint8_t    opcode = 0;
+    switch (req->op) {
+        case JFS_FIO_RING_READ:  opcode = fixed_buf ? IORING_OP_READ_FIXED : IORING_OP_READ; break;
+        case JFS_FIO_RING_WRITE: opcode = fixed_buf ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE; break;
+        default:                 *err = JFS_ERR_ARG; VOID_RETURN_ERR;
+    }
+
+    const uint32_t       index = sq->local_tail & sq->mask;
+    struct io_uring_sqe *sqe = &sq->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = opcode;
+    sqe->fd = req->fd;
+    sqe->off = (uint64_t) req->offset;
+    sqe->addr = (uint64_t) (uintptr_t) req->buf;
+    sqe->len = (uint32_t) req->size;
+    sqe->user_data = (uint64_t) (uintptr_t) req;
+    if (fixed_buf) sqe->buf_index = req->buf_index;
+    if (req->fixed_file) sqe->flags |= IOSQE_FIXED_FILE;
+
+    sq->array[index] = index;
+    sq->local_tail += 1;
+    atomic_store_explicit(sq->tail, sq->local_tail, memory_order_release);
+    ring->to_submit += 1;
+}
+
+uint32_t jfs_fio_ring_submit(jfs_fio_ring_t *ring, uint32_t wait_count, jfs_err_t *err) {
+    if (ring->to_submit == 0 && wait_count == 0) return 0;
+
+    const uint32_t flags = wait_count > 0 ? IORING_ENTER_GETEVENTS : 0;
+    uint32_t       submitted = 0;
+    do {
+        if (*err == JFS_ERR_INTER) RES_ERR;
+        submitted = jfs_io_uring_enter(ring->fd, ring->to_submit, wait_count, flags, err);
+    } while (*err == JFS_ERR_INTER);
+    VAL_CHECK_ERR(0);
+
+    ring->to_submit -= submitted;
+    ring->in_flight += submitted;
+    return submitted;
+}
+
+uint32_t jfs_fio_ring_reap(jfs_fio_ring_t *ring) {
+    fio_ring_cq_t *cq = &ring->cq;
+    uint32_t       head = atomic_load_explicit(cq->head, memory_order_relaxed);
+    const uint32_t tail = atomic_load_explicit(cq->tail, memory_order_acquire);
+    uint32_t       reaped = 0;
+
+    while (head != tail) {
+        const struct io_uring_cqe *cqe = &cq->cqes[head & cq->mask];
+        jfs_fio_ring_req_t        *req = (jfs_fio_ring_req_t *) (uintptr_t) cqe->user_data;
+
+        req->err = fio_ring_map_res(cqe->res);
+        req->result = cqe->res > 0 ? (size_t) cqe->res : 0;
+
+        head += 1;
+        atomic_store_explicit(cq->head, head, memory_order_release);
+        ring->in_flight -= 1;
+        reaped += 1;
+
+        // nothing can fail past the cqe, every reaped request reaches done
+        ring->done(req, ring->done_ctx);
+    }
+
+    return reaped;
+}
+
+uint32_t jfs_fio_ring_in_flight(const jfs_fio_ring_t *ring) {
+    return ring->in_flight + ring->to_submit;
+}
+
+static void fio_ring_map(jfs_fio_ring_t *ring, const struct io_uring_params *params, jfs_err_t *err) {
+    size_t sq_size = params->sq_off.array + (params->sq_entries * sizeof(uint32_t));
+    size_t cq_size = params->cq_off.cqes + (params->cq_entries * sizeof(struct io_uring_cqe));
+
+    if (params->features & IORING_FEAT_SINGLE_MMAP) {
+        if (cq_size > sq_size) sq_size = cq_size;
+        cq_size = sq_size;
+    }
+
+    ring->sq_map = jfs_mmap(NULL, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING, err);
+    VOID_CHECK_ERR;
+    ring->sq_map_size = sq_size;
+
+    if (params->features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cq_map = ring->sq_map;
+    } else {
+        ring->cq_map = jfs_mmap(NULL, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING, err);
+        VOID_CHECK_ERR;
+    }
+    ring->cq_map_size = cq_size;
+
+    const size_t sqes_size = params->sq_entries * sizeof(struct io_uring_sqe);
+    ring->sq.sqes = jfs_mmap(NULL, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES, err);
+    VOID_CHECK_ERR;
+    ring->sq.sqes_size = sqes_size;
+
+    uint8_t *sq_base = ring->sq_map;
+    ring->sq.head = (_Atomic(uint32_t) *) (sq_base + params->sq_off.head);
+    ring->sq.tail = (_Atomic(uint32_t) *) (sq_base + params->sq_off.tail);
+    ring->sq.array = (uint32_t *) (sq_base + params->sq_off.array);
+    ring->sq.mask = *(uint32_t *) (sq_base + params->sq_off.ring_mask);
+    ring->sq.entries = *(uint32_t *) (sq_base + params->sq_off.ring_entries);
+    ring->sq.local_tail = atomic_load_explicit(ring->sq.tail, memory_order_relaxed);
+
+    uint8_t *cq_base = ring->cq_map;
+    ring->cq.head = (_Atomic(uint32_t) *) (cq_base + params->cq_off.head);
+    ring->cq.tail = (_Atomic(uint32_t) *) (cq_base + params->cq_off.tail);
+    ring->cq.cqes = (struct io_uring_cqe *) (cq_base + params->cq_off.cqes);
+    ring->cq.mask = *(uint32_t *) (cq_base + params->cq_off.ring_mask);
+    ring->cq.entries = *(uint32_t *) (cq_base + params->cq_off.ring_entries);
+}
+
+static void fio_ring_unmap(jfs_fio_ring_t *ring) {
+    if (ring->sq.sqes != NULL) munmap(ring->sq.sqes, ring->sq.sqes_size);
+    if (ring->cq_map != NULL && ring->cq_map != ring->sq_map) munmap(ring->cq_map, ring->cq_map_size);
+    if (ring->sq_map != NULL) munmap(ring->sq_map, ring->sq_map_size);
+    ring->sq.sqes = NULL;
+    ring->cq_map = NULL;
+    ring->sq_map = NULL;
+}
+
+static jfs_err_t fio_ring_map_res(int res) {
+    if (res >= 0) return JFS_OK;
+    switch (-res) {
+        case EAGAIN: return JFS_ERR_AGAIN;
+        case EINTR:  return JFS_ERR_INTER;
+        case EACCES: return JFS_ERR_ACCESS;
+        case EPIPE:  return JFS_ERR_PIPE;
+        case EBADF:
+        case EINVAL:
+        case EFAULT: return JFS_ERR_ARG;
+        default:     return JFS_ERR_SYS;
+    }
+}
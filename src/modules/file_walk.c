@@ -14,9 +14,9 @@ typedef struct fw_file_vector fw_file_vector_t;
 typedef struct fw_dir_vector  fw_dir_vector_t;
 
 struct fw_path_vector {
-    size_t          count;
-    size_t          capacity;
-    jfs_fio_path_t *path_array;
+    size_t       count;
+    size_t       capacity;
+    jfs_pt_id_t *id_array;
 };
 
 struct fw_file_vector {
@@ -32,18 +32,20 @@ struct fw_dir_vector {
 };
 
 struct jfs_fw_state {
-    fw_path_vector_t path_vec;
-    fw_dir_vector_t  dir_vec;
+    jfs_pt_t           paths;
+    jfs_fio_path_buf_t path_buf;
+    fw_path_vector_t   path_vec;
+    fw_dir_vector_t    dir_vec;
 };
 
 static jfs_fw_types_t fw_map_dirent_type(unsigned char ent_type, jfs_err_t *err);
 static void           fw_file_init(jfs_fw_file_t *file_init, const struct dirent *ent, jfs_err_t *err);
-static void           fw_dir_init(jfs_fw_dir_t *dir_init, fw_file_vector_t *vec_free, jfs_fio_path_t *path_free, jfs_err_t *err);
+static void           fw_dir_init(jfs_fw_dir_t *dir_init, fw_file_vector_t *vec_free, jfs_pt_id_t path_id, jfs_err_t *err);
 
-static void fw_path_vector_init(fw_path_vector_t *vec_init, jfs_err_t *err);
-static void fw_path_vector_free(fw_path_vector_t *vec_free);
-static void fw_path_vector_push(fw_path_vector_t *vec, jfs_fio_path_t *path_free, jfs_err_t *err);
-static void fw_path_vector_pop(fw_path_vector_t *vec, jfs_fio_path_t *path_init, jfs_err_t *err);
+static void        fw_path_vector_init(fw_path_vector_t *vec_init, jfs_err_t *err);
+static void        fw_path_vector_free(fw_path_vector_t *vec_free);
+static void        fw_path_vector_push(fw_path_vector_t *vec, jfs_pt_id_t path_id, jfs_err_t *err);
+static jfs_pt_id_t fw_path_vector_pop(fw_path_vector_t *vec, jfs_err_t *err) WUR;
 
 static void           fw_file_vector_init(fw_file_vector_t *vec_init, jfs_err_t *err);
 static void           fw_file_vector_free(fw_file_vector_t *vec_free);
@@ -57,7 +59,7 @@ static jfs_fw_dir_t *fw_dir_vector_to_array(fw_dir_vector_t *vec_free, jfs_err_t
 
 static void fw_scan_dir(DIR *dir, fw_file_vector_t *vec, jfs_err_t *err);
 static void fw_handle_dirent(const struct dirent *ent, fw_file_vector_t *vec, jfs_err_t *err);
-static void fw_push_dir_paths(fw_path_vector_t *path_vec, fw_file_vector_t *file_vec, const jfs_fio_path_t *dir_path, jfs_err_t *err);
+static void fw_push_dir_paths(jfs_fw_state_t *state, fw_file_vector_t *file_vec, jfs_pt_id_t dir_id, jfs_err_t *err);
 
 void jfs_fw_file_free(jfs_fw_file_t *file_free) {
     jfs_fio_name_free(&file_free->name);
@@ -78,8 +80,6 @@ void jfs_fw_dir_free(jfs_fw_dir_t *dir_free) {
         free(dir_free->files);
     }
 
-    jfs_fio_path_free(&dir_free->path);
-
     memset(dir_free, 0, sizeof(*dir_free));
 }
 
@@ -90,10 +90,10 @@ void jfs_fw_dir_transfer(jfs_fw_dir_t *dir_init, jfs_fw_dir_t *dir_free) {
 
 jfs_fw_state_t *jfs_fw_state_create(const jfs_fio_path_t *start_path, jfs_err_t *err) {
     jfs_fw_state_t *state = NULL;
-    jfs_fio_path_t  new_path = {0};
 
     state = jfs_malloc(sizeof(*state), err);
     GOTO_IF_ERR(cleanup);
+    memset(state, 0, sizeof(*state));
 
     fw_path_vector_init(&state->path_vec, err);
     GOTO_IF_ERR(cleanup);
@@ -101,21 +101,15 @@ jfs_fw_state_t *jfs_fw_state_create(const jfs_fio_path_t *start_path, jfs_err_t
     fw_dir_vector_init(&state->dir_vec, err);
     GOTO_IF_ERR(cleanup);
 
-    jfs_fio_path_init(&new_path, start_path->str, err);
+    jfs_pt_init(&state->paths, start_path, err);
     GOTO_IF_ERR(cleanup);
 
-    fw_path_vector_push(&state->path_vec, &new_path, err);
+    fw_path_vector_push(&state->path_vec, JFS_PT_ROOT, err);
     GOTO_IF_ERR(cleanup);
 
     return state;
 cleanup:
-    if (state != NULL) {
-        fw_dir_vector_free(&state->dir_vec);
-        fw_path_vector_free(&state->path_vec);
-        free(state);
-    }
-
-    jfs_fio_path_free(&new_path);
+    jfs_fw_state_destroy(state);
     NULL_RETURN_ERR;
 }
 
@@ -124,6 +118,7 @@ void jfs_fw_state_destroy(jfs_fw_state_t *state_move) {
 
     fw_path_vector_free(&state_move->path_vec);
     fw_dir_vector_free(&state_move->dir_vec);
+    jfs_pt_free(&state_move->paths);
 
     free(state_move);
 }
@@ -132,26 +127,29 @@ int jfs_fw_state_step(jfs_fw_state_t *state, jfs_err_t *err) { // NOLINT(readabi
     if (state->path_vec.count == 0) return 1;
 
     fw_file_vector_t file_vec = {0};
-    jfs_fio_path_t   dir_path = {0};
+    jfs_pt_id_t      dir_id = JFS_PT_NONE;
     jfs_fw_dir_t     dir = {0};
     DIR             *sys_dir = NULL;
 
     fw_file_vector_init(&file_vec, err);
     GOTO_IF_ERR(cleanup);
 
-    fw_path_vector_pop(&state->path_vec, &dir_path, err);
+    dir_id = fw_path_vector_pop(&state->path_vec, err);
     GOTO_IF_ERR(cleanup);
 
-    sys_dir = jfs_opendir(dir_path.str, err);
+    jfs_pt_path_buf(&state->paths, dir_id, &state->path_buf, err);
+    GOTO_IF_ERR(cleanup);
+
+    sys_dir = jfs_opendir(state->path_buf.data, err);
     GOTO_IF_ERR(cleanup);
 
     fw_scan_dir(sys_dir, &file_vec, err);
     GOTO_IF_ERR(cleanup);
 
-    fw_push_dir_paths(&state->path_vec, &file_vec, &dir_path, err);
+    fw_push_dir_paths(state, &file_vec, dir_id, err);
     GOTO_IF_ERR(cleanup);
 
-    fw_dir_init(&dir, &file_vec, &dir_path, err);
+    fw_dir_init(&dir, &file_vec, dir_id, err);
     GOTO_IF_ERR(cleanup);
 
     fw_dir_vector_push(&state->dir_vec, &dir, err);
@@ -163,7 +161,6 @@ int jfs_fw_state_step(jfs_fw_state_t *state, jfs_err_t *err) { // NOLINT(readabi
 cleanup:
     if (sys_dir != NULL) closedir(sys_dir);
     fw_file_vector_free(&file_vec);
-    jfs_fio_path_free(&dir_path);
     jfs_fw_dir_free(&dir);
     REMAP_ERR(JFS_ERR_ACCESS, JFS_ERR_FW_SKIP);
     REMAP_ERR(JFS_ERR_INVAL_PATH, JFS_ERR_FW_FAIL);
@@ -177,6 +174,7 @@ void jfs_fw_record_init(jfs_fw_record_t *record_init, jfs_fw_state_t *state_move
     jfs_fw_dir_t *new_dir_array = fw_dir_vector_to_array(&state_move->dir_vec, err);
     VOID_CHECK_ERR;
 
+    jfs_pt_transfer(&record_init->paths, &state_move->paths);
     record_init->dir_array = new_dir_array;
     record_init->dir_count = new_dir_count;
 
@@ -192,6 +190,7 @@ void jfs_fw_record_free(jfs_fw_record_t *record_free) {
         free(record_free->dir_array);
     }
 
+    jfs_pt_free(&record_free->paths);
     memset(record_free, 0, sizeof(*record_free));
 }
 
@@ -218,7 +217,7 @@ static void fw_file_init(jfs_fw_file_t *file_init, const struct dirent *ent, jfs
     file_init->type = new_type;
 }
 
-static void fw_dir_init(jfs_fw_dir_t *dir_init, fw_file_vector_t *vec_free, jfs_fio_path_t *path_free, jfs_err_t *err) {
+static void fw_dir_init(jfs_fw_dir_t *dir_init, fw_file_vector_t *vec_free, jfs_pt_id_t path_id, jfs_err_t *err) {
     size_t         new_count = vec_free->count;
     jfs_fw_file_t *new_files = NULL;
 
@@ -231,50 +230,43 @@ static void fw_dir_init(jfs_fw_dir_t *dir_init, fw_file_vector_t *vec_free, jfs_
 
     dir_init->file_count = new_count;
     dir_init->files = new_files;
-    jfs_fio_path_transfer(&dir_init->path, path_free);
+    dir_init->path_id = path_id;
 }
 
 static void fw_path_vector_init(fw_path_vector_t *vec_init, jfs_err_t *err) {
-    jfs_fio_path_t *new_path_array = jfs_malloc(sizeof(*new_path_array) * FW_PATH_VECTOR_DEFAULT_CAPACITY, err);
+    jfs_pt_id_t *new_id_array = jfs_malloc(sizeof(*new_id_array) * FW_PATH_VECTOR_DEFAULT_CAPACITY, err);
     VOID_CHECK_ERR;
 
-    vec_init->path_array = new_path_array;
+    vec_init->id_array = new_id_array;
     vec_init->capacity = FW_PATH_VECTOR_DEFAULT_CAPACITY;
     vec_init->count = 0;
 }
 
 static void fw_path_vector_free(fw_path_vector_t *vec_free) {
-    if (vec_free->path_array != NULL) {
-        for (size_t i = 0; i < vec_free->count; i++) {
-            jfs_fio_path_free(&vec_free->path_array[i]);
-        }
-
-        free(vec_free->path_array);
-    }
-
+    free(vec_free->id_array);
     memset(vec_free, 0, sizeof(*vec_free));
 }
 
-static void fw_path_vector_push(fw_path_vector_t *vec, jfs_fio_path_t *path_free, jfs_err_t *err) {
+static void fw_path_vector_push(fw_path_vector_t *vec, jfs_pt_id_t path_id, jfs_err_t *err) {
     if (vec->count >= vec->capacity) {
         const size_t new_capacity = vec->capacity * 2;
 
-        jfs_fio_path_t *new_path_array = jfs_realloc(vec->path_array, sizeof(*new_path_array) * new_capacity, err);
+        jfs_pt_id_t *new_id_array = jfs_realloc(vec->id_array, sizeof(*new_id_array) * new_capacity, err);
         VOID_CHECK_ERR;
 
-        vec->path_array = new_path_array;
+        vec->id_array = new_id_array;
         vec->capacity = new_capacity;
     }
 
-    jfs_fio_path_transfer(&vec->path_array[vec->count], path_free);
+    vec->id_array[vec->count] = path_id;
     vec->count += 1;
 }
 
-static void fw_path_vector_pop(fw_path_vector_t *vec, jfs_fio_path_t *path_init, jfs_err_t *err) {
-    VOID_FAIL_IF(vec->count == 0, JFS_ERR_EMPTY);
+static jfs_pt_id_t fw_path_vector_pop(fw_path_vector_t *vec, jfs_err_t *err) {
+    VAL_FAIL_IF(vec->count == 0, JFS_ERR_EMPTY, JFS_PT_NONE);
 
     vec->count -= 1;
-    jfs_fio_path_transfer(path_init, &vec->path_array[vec->count]);
+    return vec->id_array[vec->count];
 }
 
 static void fw_file_vector_init(fw_file_vector_t *vec_init, jfs_err_t *err) {
@@ -398,26 +390,18 @@ static void fw_handle_dirent(const struct dirent *ent, fw_file_vector_t *vec, jf
     }
 }
 
-static void fw_push_dir_paths(fw_path_vector_t *path_vec, fw_file_vector_t *file_vec, const jfs_fio_path_t *dir_path, jfs_err_t *err) {
-    jfs_fio_path_t     push_path = {0};
-    jfs_fio_path_buf_t buf = {0};
-
+static void fw_push_dir_paths(jfs_fw_state_t *state, fw_file_vector_t *file_vec, jfs_pt_id_t dir_id, jfs_err_t *err) {
     for (size_t i = 0; i < file_vec->count; i++) {
         if (file_vec->file_array[i].type == JFS_FW_REG) continue;
 
-        jfs_fio_path_buf_compose(&buf, dir_path, &(file_vec->file_array[i].name), err);
+        const jfs_pt_id_t push_id = jfs_pt_intern(&state->paths, dir_id, &(file_vec->file_array[i].name), err);
         if (*err == JFS_ERR_FIO_PATH_OVERFLOW) {
             RES_ERR;
             continue;
         }
-
-        jfs_fio_path_init(&push_path, buf.data, err);
         VOID_CHECK_ERR;
 
-        fw_path_vector_push(path_vec, &push_path, err);
-        if (*err != JFS_OK) {
-            jfs_fio_path_free(&push_path);
-            VOID_RETURN_ERR;
-        }
+        fw_path_vector_push(&state->path_vec, push_id, err);
+        VOID_CHECK_ERR;
     }
 }
@@ -1,30 +1,105 @@
 #include "net_socket.h"
 #include "error.h"
 #include <arpa/inet.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/errqueue.h>
+#include <linux/tcp.h>
 #include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdatomic.h>
+#include <stdbool.h>
 #include <stdlib.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <time.h>
 #include <unistd.h>
 
-#define LISTEN_BACK_LOG 5
+#define LISTEN_BACK_LOG         SOMAXCONN
+#define BOUNCE_BUF_SIZE         (128 * 1024)
+#define SPLICE_PIPE_SIZE        (1024 * 1024)
+#define ZC_DEFAULT_CAPACITY     256
+#define ZC_CONTROL_SIZE         128
+#define TUNE_MIN_BUF            (64 * 1024)
+#define TUNE_DEFAULT_MAX_BUF    (32 * 1024 * 1024)
+#define TUNE_BDP_HEADROOM       2
+#define TUNE_NOTSENT_LOWAT      (128 * 1024)
+#define TUNE_US_PER_SEC         1000000
+#define TUNE_WMEM_MAX_PATH      "/proc/sys/net/core/wmem_max"
+#define REACTOR_EVENT_COUNT     64
+#define REACTOR_TIMER_CAPACITY  16
+#define REACTOR_NS_PER_MS       1000000
+#define REACTOR_MS_PER_SEC      1000
+
+typedef struct ns_timer ns_timer_t;
 
 struct jfs_ns_socket {
-    int                fd;
-    struct sockaddr_in addr;
+    int                     fd;
+    struct sockaddr_storage addr; // AF_INET, AF_INET6 or AF_UNIX, the family the socket is opened with
+    socklen_t               addr_len;
+    jfs_ns_event_fn         on_event;
+    void                   *event_ctx;
+};
+
+struct ns_timer {
+    uint64_t        deadline_ms;
+    uint64_t        id;
+    jfs_ns_timer_fn on_timer;
+    void           *ctx;
 };
 
+struct jfs_ns_reactor {
+    int         epoll_fd;
+    int         wake_fd;
+    atomic_bool stop;
+    uint64_t    next_timer_id;
+    size_t      timer_count;
+    size_t      timer_capacity;
+    ns_timer_t *timer_array; // min heap on deadline
+};
+
+static void     ns_iov_advance(struct msghdr *msg, size_t size_sent);
+static void     ns_zc_complete(jfs_ns_zc_t *zc, uint32_t lo_id, uint32_t hi_id);
+static void     ns_zc_release(jfs_ns_zc_t *zc);
+static size_t   ns_sendfile_copy(const jfs_ns_socket_t *sock, int file_fd, off_t offset, size_t size, jfs_err_t *err);
+static size_t   ns_recv_file_copy(const jfs_ns_socket_t *sock, int file_fd, off_t offset, size_t size, jfs_err_t *err);
+static void     ns_splice_drain(jfs_ns_splice_t *splice, int file_fd, off_t *file_off, size_t size, jfs_err_t *err);
+static void     ns_splice_drain_copy(jfs_ns_splice_t *splice, int file_fd, off_t *file_off, size_t size, jfs_err_t *err);
+static uint64_t ns_now_ms(void) WUR;
+static uint32_t ns_wmem_max(void) WUR;
+static int      ns_reactor_timeout(const jfs_ns_reactor_t *reactor) WUR;
+static void     ns_reactor_fire_timers(jfs_ns_reactor_t *reactor);
+static void     ns_timer_sift_up(ns_timer_t *timer_array, size_t index);
+static void     ns_timer_sift_down(ns_timer_t *timer_array, size_t count, size_t index);
+
 jfs_ns_socket_t *jfs_ns_socket_create(jfs_err_t *err) {
     jfs_ns_socket_t *sock = jfs_malloc(sizeof(*sock), err);
     NULL_CHECK_ERR;
 
     sock->fd = -1;
     memset(&sock->addr, 0, sizeof(sock->addr));
+    sock->addr_len = 0;
+    sock->on_event = NULL;
+    sock->event_ctx = NULL;
     return sock;
 }
 
 void jfs_ns_socket_open(jfs_ns_socket_t *sock, jfs_err_t *err) {
-    int new_fd = jfs_socket(AF_INET, SOCK_STREAM, 0, err);
+    const int family = sock->addr_len == 0 ? AF_INET : sock->addr.ss_family;
+    int       new_fd = jfs_socket(family, SOCK_STREAM, 0, err);
     VOID_CHECK_ERR;
     sock->fd = new_fd;
+
+    // dual stack: a listener on "::" takes IPv4 clients too, as mapped addresses, whatever the sysctl default is
+    if (family == AF_INET6) {
+        const int disable = 0;
+        jfs_setsockopt(sock->fd, IPPROTO_IPV6, IPV6_V6ONLY, &disable, sizeof(disable), err);
+        VOID_CHECK_ERR;
+    }
 }
 
 void jfs_ns_socket_close(jfs_ns_socket_t *sock, jfs_err_t *err) {
@@ -46,48 +121,113 @@ void jfs_ns_socket_shutdown(const jfs_ns_socket_t *sock, jfs_err_t *err) {
     VOID_CHECK_ERR;
 }
 
+void jfs_ns_socket_wait_close(const jfs_ns_socket_t *sock, jfs_err_t *err) {
+    uint8_t byte;
+    for (;;) {
+        const size_t size_received = jfs_recv(sock->fd, &byte, sizeof(byte), 0, err);
+        if (*err == JFS_ERR_INTER) {
+            IGNORE_ERR;
+            continue;
+        }
+        VOID_CHECK_ERR;
+        VOID_FAIL_IF(size_received != 0, JFS_ERR_IO);
+        return;
+    }
+}
+
 void jfs_ns_socket_set_ip(jfs_ns_socket_t *sock, uint16_t server_port, const char *server_ip, jfs_err_t *err) {
     VOID_FAIL_IF(server_port <= 1024, JFS_ERR_ARG);
 
     struct sockaddr_in addr_in = {0};
     addr_in.sin_family = AF_INET;
     addr_in.sin_port = htons(server_port);
-    int status = inet_pton(AF_INET, server_ip, &addr_in.sin_addr);
+    if (inet_pton(AF_INET, server_ip, &addr_in.sin_addr) == 1) {
+        memcpy(&sock->addr, &addr_in, sizeof(addr_in));
+        sock->addr_len = sizeof(addr_in);
+        return;
+    }
+
+    struct sockaddr_in6 addr_in6 = {0};
+    addr_in6.sin6_family = AF_INET6;
+    addr_in6.sin6_port = htons(server_port);
+    int status = inet_pton(AF_INET6, server_ip, &addr_in6.sin6_addr);
     VOID_FAIL_IF(status != 1, JFS_ERR_ARG);
 
-    sock->addr = addr_in;
+    memcpy(&sock->addr, &addr_in6, sizeof(addr_in6));
+    sock->addr_len = sizeof(addr_in6);
 }
 
 void jfs_ns_socket_set_hostname(jfs_ns_socket_t *sock, uint16_t server_port, const char *hostname, jfs_err_t *err) {
     VOID_FAIL_IF(server_port <= 1024, JFS_ERR_ARG);
 
     struct addrinfo hints = {0};
-    hints.ai_family = AF_INET;
+    hints.ai_family = AF_UNSPEC;
     hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_ADDRCONFIG; // no IPv6 results on IPv4-only hosts and the other way round
     char port_str[NI_MAXSERV];
     snprintf(port_str, sizeof(port_str), "%d", server_port);
 
     struct addrinfo *result = jfs_getaddrinfo(hostname, port_str, &hints, err);
     VOID_CHECK_ERR;
 
-    if (result->ai_family != AF_INET || result->ai_addrlen != sizeof(struct sockaddr_in)) {
+    // the resolver already sorts by preference, the first result is the one to use
+    const bool ip_family = result->ai_family == AF_INET || result->ai_family == AF_INET6;
+    if (!ip_family || result->ai_addrlen > sizeof(sock->addr)) {
         freeaddrinfo(result);
         *err = JFS_ERR_NS_BAD_ADDR;
         VOID_RETURN_ERR;
     }
 
     memcpy(&sock->addr, result->ai_addr, result->ai_addrlen);
+    sock->addr_len = result->ai_addrlen;
     freeaddrinfo(result);
 }
 
+void jfs_ns_socket_set_unix(jfs_ns_socket_t *sock, const char *path, jfs_err_t *err) {
+    struct sockaddr_un addr_un = {0};
+    const size_t       path_len = strnlen(path, sizeof(addr_un.sun_path));
+    VOID_FAIL_IF(path_len == 0 || path_len == sizeof(addr_un.sun_path), JFS_ERR_ARG);
+
+    addr_un.sun_family = AF_UNIX;
+    memcpy(addr_un.sun_path, path, path_len);
+
+    // abstract names are not nul terminated and the length is all that delimits them
+    if (path[0] == '@') addr_un.sun_path[0] = '\0';
+    const size_t term_len = path[0] == '@' ? 0 : 1;
+
+    memcpy(&sock->addr, &addr_un, sizeof(addr_un));
+    sock->addr_len = (socklen_t) (offsetof(struct sockaddr_un, sun_path) + path_len + term_len);
+}
+
 void jfs_ns_socket_bind(const jfs_ns_socket_t *sock, jfs_err_t *err) {
     do {
         if (*err == JFS_ERR_INTER) RES_ERR;
-        jfs_bind(sock->fd, (struct sockaddr *) &sock->addr, sizeof(sock->addr), err);
+        jfs_bind(sock->fd, (struct sockaddr *) &sock->addr, sock->addr_len, err);
     } while (*err == JFS_ERR_INTER);
     VOID_CHECK_ERR;
 }
 
+void jfs_ns_socket_set_nonblock(const jfs_ns_socket_t *sock, jfs_err_t *err) {
+    const int flags = jfs_fcntl(sock->fd, F_GETFL, 0, err);
+    VOID_CHECK_ERR;
+    if ((flags & O_NONBLOCK) != 0) return;
+
+    (void) jfs_fcntl(sock->fd, F_SETFL, flags | O_NONBLOCK, err);
+    VOID_CHECK_ERR;
+}
+
+void jfs_ns_socket_set_reuse_port(const jfs_ns_socket_t *sock, jfs_err_t *err) {
+    const int enable = 1;
+    jfs_setsockopt(sock->fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable), err);
+    VOID_CHECK_ERR;
+
+    // the kernel spreads incoming connections over every listener bound to the port
+    // unix paths cannot be shared, there is one listener per path
+    if (sock->addr.ss_family == AF_UNIX) return;
+    jfs_setsockopt(sock->fd, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable), err);
+    VOID_CHECK_ERR;
+}
+
 void jfs_ns_socket_listen(const jfs_ns_socket_t *sock, jfs_err_t *err) {
     jfs_listen(sock->fd, LISTEN_BACK_LOG, err);
     VOID_CHECK_ERR;
@@ -105,23 +245,25 @@ jfs_ns_socket_t *jfs_ns_socket_accept(const jfs_ns_socket_t *sock, jfs_err_t *er
 
     if (*err != JFS_OK) {
         jfs_ns_socket_destroy(&accept_sock);
+        if (*err == JFS_ERR_AGAIN) return NULL;
         NULL_RETURN_ERR;
     }
 
-    if (accept_sock->addr.sin_family != AF_INET || addrlen != sizeof(struct sockaddr_in)) {
+    // unnamed unix clients come back with just the family
+    if (accept_sock->addr.ss_family != sock->addr.ss_family || addrlen > sizeof(accept_sock->addr)) {
         *err = JFS_ERR_NS_BAD_ACCEPT;
         jfs_ns_socket_destroy(&accept_sock);
         NULL_RETURN_ERR;
-
     }
 
+    accept_sock->addr_len = addrlen;
     return accept_sock;
 }
 
 void jfs_ns_socket_connect(const jfs_ns_socket_t *sock, jfs_err_t *err) {
     do {
         if (*err == JFS_ERR_INTER) RES_ERR;
-        jfs_connect(sock->fd, (struct sockaddr *) &sock->addr, sizeof(sock->addr), err);
+        jfs_connect(sock->fd, (struct sockaddr *) &sock->addr, sock->addr_len, err);
     } while (*err == JFS_ERR_INTER);
     VOID_CHECK_ERR;
 }
@@ -163,3 +305,750 @@ size_t jfs_ns_socket_send(const jfs_ns_socket_t *sock, const void *buf, size_t b
 
     return total_sent;
 }
+
+size_t jfs_ns_socket_sendv(const jfs_ns_socket_t *sock, struct iovec *iov_array, size_t iov_count, int flags, jfs_err_t *err) {
+    struct msghdr msg = {0};
+    size_t        total_sent = 0;
+
+    msg.msg_iov = iov_array;
+    msg.msg_iovlen = iov_count;
+
+    // iov_array is advanced in place past whatever a short send got out
+    while (msg.msg_iovlen > 0) {
+        const size_t size_sent = jfs_sendmsg(sock->fd, &msg, MSG_NOSIGNAL | flags, err);
+        if (*err == JFS_ERR_INTER) {
+            RES_ERR;
+            continue;
+        }
+        if (*err == JFS_ERR_AGAIN) return total_sent;
+        VAL_CHECK_ERR(total_sent);
+
+        total_sent += size_sent;
+        ns_iov_advance(&msg, size_sent);
+    }
+
+    return total_sent;
+}
+
+size_t jfs_ns_socket_sendfile(const jfs_ns_socket_t *sock, int file_fd, off_t offset, size_t size, jfs_err_t *err) {
+    off_t  file_off = offset;
+    size_t total_sent = 0;
+
+    // page cache pages go straight to the socket, nothing is copied through user space
+    while (total_sent < size) {
+        const size_t size_sent = jfs_sendfile(sock->fd, file_fd, &file_off, size - total_sent, err);
+        if (*err == JFS_ERR_INTER) {
+            RES_ERR;
+            continue;
+        }
+        if (*err == JFS_ERR_FIO_UNSUPPORTED && total_sent == 0) {
+            RES_ERR;
+            total_sent = ns_sendfile_copy(sock, file_fd, offset, size, err);
+            if (*err == JFS_ERR_AGAIN) return total_sent;
+            VAL_CHECK_ERR(total_sent);
+            return total_sent;
+        }
+        if (*err == JFS_ERR_AGAIN) return total_sent;
+        VAL_CHECK_ERR(total_sent);
+
+        VAL_FAIL_IF(size_sent == 0, JFS_ERR_FIO_FILE_END, total_sent);
+        total_sent += size_sent;
+    }
+
+    return total_sent;
+}
+
+void jfs_ns_splice_init(jfs_ns_splice_t *splice_init, jfs_err_t *err) {
+    jfs_ns_splice_t splice = {0};
+    jfs_pipe2(splice.pipe_fd, O_CLOEXEC, err);
+    VOID_CHECK_ERR;
+
+    // a bigger pipe means fewer splice round trips per frame, the default 64 KiB is kept if the limit is lower
+    const int pipe_size = fcntl(splice.pipe_fd[1], F_SETPIPE_SZ, SPLICE_PIPE_SIZE);
+    splice.pipe_size = pipe_size > 0 ? (size_t) pipe_size : (size_t) fcntl(splice.pipe_fd[1], F_GETPIPE_SZ);
+
+    *splice_init = splice;
+}
+
+void jfs_ns_splice_free(jfs_ns_splice_t *splice_free) {
+    close(splice_free->pipe_fd[0]);
+    close(splice_free->pipe_fd[1]);
+    memset(splice_free, 0, sizeof(*splice_free));
+}
+
+size_t jfs_ns_socket_recv_file(const jfs_ns_socket_t *sock, jfs_ns_splice_t *splice, int file_fd, off_t offset, size_t size, jfs_err_t *err) {
+    off_t  file_off = offset;
+    size_t total_received = 0;
+
+    // socket pages are moved into the pipe and from there into the page cache of file_fd
+    while (total_received < size) {
+        const size_t want_size = size - total_received < splice->pipe_size ? size - total_received : splice->pipe_size;
+        const size_t size_piped = jfs_splice(sock->fd, NULL, splice->pipe_fd[1], NULL, want_size, SPLICE_F_MOVE | SPLICE_F_MORE, err);
+        if (*err == JFS_ERR_INTER) {
+            RES_ERR;
+            continue;
+        }
+        if (*err == JFS_ERR_FIO_UNSUPPORTED && total_received == 0) {
+            RES_ERR;
+            total_received = ns_recv_file_copy(sock, file_fd, offset, size, err);
+            if (*err == JFS_ERR_AGAIN) return total_received;
+            VAL_CHECK_ERR(total_received);
+            return total_received;
+        }
+        if (*err == JFS_ERR_AGAIN) return total_received;
+        VAL_CHECK_ERR(total_received);
+        VAL_FAIL_IF(size_piped == 0, JFS_ERR_NS_CONNECTION_CLOSE, total_received);
+
+        // the pipe is always emptied before returning, so nothing is left behind for the next call
+        ns_splice_drain(splice, file_fd, &file_off, size_piped, err);
+        VAL_CHECK_ERR(total_received);
+        total_received += size_piped;
+    }
+
+    return total_received;
+}
+
+void jfs_ns_socket_set_zerocopy(const jfs_ns_socket_t *sock, jfs_ns_zc_t *zc, jfs_err_t *err) {
+    const int enable = 1;
+    jfs_setsockopt(sock->fd, SOL_SOCKET, SO_ZEROCOPY, &enable, sizeof(enable), err);
+    VOID_CHECK_ERR;
+
+    zc->enabled = true;
+}
+
+void jfs_ns_zc_init(jfs_ns_zc_t *zc_init, size_t capacity, jfs_err_t *err) {
+    jfs_ns_zc_t zc = {0};
+    zc.capacity = capacity == 0 ? ZC_DEFAULT_CAPACITY : capacity;
+    zc.send_array = jfs_malloc(sizeof(*zc.send_array) * zc.capacity, err);
+    VOID_CHECK_ERR;
+
+    *zc_init = zc;
+}
+
+void jfs_ns_zc_free(jfs_ns_zc_t *zc_free) {
+    free(zc_free->send_array);
+    memset(zc_free, 0, sizeof(*zc_free));
+}
+
+size_t jfs_ns_socket_send_zc(const jfs_ns_socket_t *sock, jfs_ns_zc_t *zc, const void *buf, size_t buf_size, jfs_ns_zc_done_fn done, void *ctx, jfs_err_t *err) {
+    VAL_FAIL_IF(zc->count == zc->capacity, JFS_ERR_FULL, 0);
+
+    // an unnumbered send would leave jfs_ns_zc_wait blocked forever, so without SO_ZEROCOPY this is a plain send
+    const bool     zerocopy = zc->enabled && buf_size >= JFS_NS_ZC_MIN_SIZE;
+    const uint32_t first_id = zc->next_id;
+    const uint8_t *send_buf = (const uint8_t *) buf;
+    size_t         total_sent = 0;
+
+    while (total_sent < buf_size) {
+        const size_t size_sent = jfs_send(sock->fd, send_buf + total_sent, buf_size - total_sent, MSG_NOSIGNAL | (zerocopy ? MSG_ZEROCOPY : 0), err);
+        if (*err == JFS_ERR_INTER) {
+            RES_ERR;
+            continue;
+        }
+        if (*err != JFS_OK) break;
+
+        // the kernel numbers every successful zerocopy call, short or not
+        if (zerocopy) zc->next_id += 1;
+        total_sent += size_sent;
+    }
+
+    // ids are recorded even on error so the ring stays in step with the notifications
+    const uint32_t id_count = zc->next_id - first_id;
+    if (id_count > 0 || done != NULL) {
+        zc->send_array[(zc->head + zc->count) % zc->capacity] = (jfs_ns_zc_send_t) {
+            .first_id = first_id,
+            .id_count = id_count,
+            .remaining = id_count,
+            .done = *err == JFS_OK ? done : NULL,
+            .ctx = ctx,
+        };
+        zc->count += 1;
+    }
+    ns_zc_release(zc);
+
+    VAL_CHECK_ERR(total_sent);
+    return total_sent;
+}
+
+void jfs_ns_zc_reap(const jfs_ns_socket_t *sock, jfs_ns_zc_t *zc, jfs_err_t *err) {
+    for (;;) {
+        uint8_t       control[ZC_CONTROL_SIZE];
+        struct msghdr msg = {0};
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        (void) jfs_recvmsg(sock->fd, &msg, MSG_ERRQUEUE, err);
+        if (*err == JFS_ERR_INTER) {
+            RES_ERR;
+            continue;
+        }
+        if (*err == JFS_ERR_AGAIN) {
+            IGNORE_ERR;
+            break;
+        }
+        VOID_CHECK_ERR;
+
+        for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            const bool recv_err = (cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR) ||
+                                  (cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR);
+            if (!recv_err) continue;
+
+            // a notification covers the inclusive id range [ee_info, ee_data]
+            struct sock_extended_err ext_err;
+            memcpy(&ext_err, CMSG_DATA(cmsg), sizeof(ext_err));
+            if (ext_err.ee_origin != SO_EE_ORIGIN_ZEROCOPY || ext_err.ee_errno != 0) continue;
+
+            if ((ext_err.ee_code & SO_EE_CODE_ZEROCOPY_COPIED) != 0) zc->copied_count += ext_err.ee_data - ext_err.ee_info + 1;
+            ns_zc_complete(zc, ext_err.ee_info, ext_err.ee_data);
+        }
+    }
+
+    ns_zc_release(zc);
+}
+
+void jfs_ns_zc_wait(const jfs_ns_socket_t *sock, jfs_ns_zc_t *zc, jfs_err_t *err) {
+    while (zc->count > 0) {
+        // no requested events, POLLERR is always reported and covers a non-empty error queue
+        struct pollfd poll_fd = {.fd = sock->fd, .events = 0};
+        const uint32_t ready_count = jfs_poll(&poll_fd, 1, -1, err);
+        if (*err == JFS_ERR_INTER) {
+            RES_ERR;
+            continue;
+        }
+        VOID_CHECK_ERR;
+        if (ready_count == 0) continue;
+
+        jfs_ns_zc_reap(sock, zc, err);
+        VOID_CHECK_ERR;
+    }
+}
+
+void jfs_ns_socket_tcp_info(const jfs_ns_socket_t *sock, jfs_ns_tcp_info_t *info_out, jfs_err_t *err) {
+    // linux/tcp.h because the libc struct stops before tcpi_delivery_rate, older kernels leave the tail zeroed
+    struct tcp_info info = {0};
+    socklen_t       info_len = sizeof(info);
+    jfs_getsockopt(sock->fd, IPPROTO_TCP, TCP_INFO, &info, &info_len, err);
+    VOID_CHECK_ERR;
+
+    *info_out = (jfs_ns_tcp_info_t) {
+        .rtt_us = info.tcpi_rtt,
+        .rtt_var_us = info.tcpi_rttvar,
+        .mss = info.tcpi_snd_mss,
+        .cwnd = info.tcpi_snd_cwnd,
+        .delivery_rate = info.tcpi_delivery_rate,
+    };
+}
+
+void jfs_ns_tune_init(jfs_ns_tune_t *tune_init, uint32_t max_buf) {
+    *tune_init = (jfs_ns_tune_t) {
+        .max_buf = max_buf == 0 ? TUNE_DEFAULT_MAX_BUF : max_buf,
+    };
+}
+
+void jfs_ns_socket_tune(const jfs_ns_socket_t *sock, jfs_ns_tune_t *tune, jfs_err_t *err) {
+    if (sock->addr.ss_family == AF_UNIX) return;
+    jfs_ns_socket_tcp_info(sock, &tune->info, err);
+    VOID_CHECK_ERR;
+
+    // unsent data past the low mark stays in user space, so the socket queue holds little more than what is in flight
+    if (tune->sample_count++ == 0) {
+        const int lowat = TUNE_NOTSENT_LOWAT;
+        jfs_setsockopt(sock->fd, IPPROTO_TCP, TCP_NOTSENT_LOWAT, &lowat, sizeof(lowat), err);
+        VOID_CHECK_ERR;
+        tune->sys_max_buf = ns_wmem_max();
+    }
+    if (tune->info.rtt_us == 0) return;
+
+    // the delivery rate is what the path really carried, cwnd * mss stands in until the first rate sample
+    const uint64_t bdp = tune->info.delivery_rate != 0 ? tune->info.delivery_rate * tune->info.rtt_us / TUNE_US_PER_SEC : (uint64_t) tune->info.cwnd * tune->info.mss;
+    uint64_t       want = bdp * TUNE_BDP_HEADROOM;
+    if (want < TUNE_MIN_BUF) want = TUNE_MIN_BUF;
+    if (want > tune->max_buf) want = tune->max_buf;
+    // a set size is capped at wmem_max while autotuning may go further, so never ask for more than will stick
+    if (want > tune->sys_max_buf) want = tune->sys_max_buf;
+
+    // a set size pins the buffer and ends kernel autotuning, so only take over once the bdp outgrows it
+    // moves under a quarter are not worth it
+    int       cur_buf = 0;
+    socklen_t cur_len = sizeof(cur_buf);
+    jfs_getsockopt(sock->fd, SOL_SOCKET, SO_SNDBUF, &cur_buf, &cur_len, err);
+    VOID_CHECK_ERR;
+    const uint64_t cur_size = (uint64_t) cur_buf / 2; // the kernel reports double the set size, the rest is bookkeeping
+    if (want * 4 <= cur_size * 5) return;             // NOLINT
+
+    // the receive window is fixed by the scale negotiated at connect, so only the send side is sized here
+    const int buf_size = (int) want;
+    jfs_setsockopt(sock->fd, SOL_SOCKET, SO_SNDBUF, &buf_size, sizeof(buf_size), err);
+    VOID_CHECK_ERR;
+
+    // some other limit may still have clamped it, never leave the buffer smaller than autotuning had it
+    int new_buf = 0;
+    cur_len = sizeof(new_buf);
+    jfs_getsockopt(sock->fd, SOL_SOCKET, SO_SNDBUF, &new_buf, &cur_len, err);
+    VOID_CHECK_ERR;
+    if ((uint64_t) new_buf / 2 < cur_size) {
+        const int old_size = (int) cur_size;
+        jfs_setsockopt(sock->fd, SOL_SOCKET, SO_SNDBUF, &old_size, sizeof(old_size), err);
+        VOID_CHECK_ERR;
+        new_buf = cur_buf;
+    }
+    tune->buf_size = (uint32_t) new_buf / 2;
+}
+
+void jfs_ns_socket_set_phase(const jfs_ns_socket_t *sock, jfs_ns_phase_t phase, jfs_err_t *err) {
+    const int enable = 1;
+    const int disable = 0;
+
+    // unix sockets have no segments to hold back
+    if (sock->addr.ss_family == AF_UNIX) return;
+    if (phase == JFS_NS_PHASE_BULK) {
+        // cork wins over nodelay while set, frame headers and small tails merge into full segments
+        jfs_setsockopt(sock->fd, IPPROTO_TCP, TCP_CORK, &enable, sizeof(enable), err);
+        VOID_CHECK_ERR;
+        return;
+    }
+
+    // uncorking pushes out whatever partial segment was held back
+    jfs_setsockopt(sock->fd, IPPROTO_TCP, TCP_CORK, &disable, sizeof(disable), err);
+    VOID_CHECK_ERR;
+    jfs_setsockopt(sock->fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable), err);
+    VOID_CHECK_ERR;
+}
+
+size_t jfs_ns_socket_try_recv(const jfs_ns_socket_t *sock, void *buf, size_t buf_size, jfs_err_t *err) {
+    uint8_t *recv_buf = (uint8_t *) buf;
+    size_t   total_received = 0;
+
+    // MSG_DONTWAIT keeps this non-blocking whatever mode the descriptor is in
+    while (total_received < buf_size) {
+        const size_t size_received = jfs_recv(sock->fd, recv_buf + total_received, buf_size - total_received, MSG_DONTWAIT, err);
+        if (*err == JFS_ERR_INTER) {
+            RES_ERR;
+            continue;
+        }
+        if (*err == JFS_ERR_AGAIN) return total_received;
+        VAL_CHECK_ERR(total_received);
+
+        VAL_FAIL_IF(size_received == 0, JFS_ERR_NS_CONNECTION_CLOSE, total_received);
+        total_received += size_received;
+    }
+
+    return total_received;
+}
+
+size_t jfs_ns_socket_try_send(const jfs_ns_socket_t *sock, const void *buf, size_t buf_size, int flags, jfs_err_t *err) {
+    struct iovec iov = {.iov_base = (void *) buf, .iov_len = buf_size};
+    const size_t total_sent = jfs_ns_socket_try_sendv(sock, &iov, 1, flags, err);
+    if (*err == JFS_ERR_AGAIN) return total_sent;
+    VAL_CHECK_ERR(total_sent);
+
+    return total_sent;
+}
+
+size_t jfs_ns_socket_try_sendv(const jfs_ns_socket_t *sock, struct iovec *iov_array, size_t iov_count, int flags, jfs_err_t *err) {
+    return jfs_ns_socket_sendv(sock, iov_array, iov_count, MSG_DONTWAIT | flags, err);
+}
+
+void jfs_ns_read_cursor_init(jfs_ns_read_cursor_t *cursor_init, void *buf, size_t size) {
+    cursor_init->buf = (uint8_t *) buf;
+    cursor_init->size = size;
+    cursor_init->received = 0;
+}
+
+void jfs_ns_read_cursor_recv(const jfs_ns_socket_t *sock, jfs_ns_read_cursor_t *cursor, jfs_err_t *err) {
+    // progress is kept even when the call ends in an error
+    cursor->received += jfs_ns_socket_try_recv(sock, cursor->buf + cursor->received, cursor->size - cursor->received, err);
+    if (*err == JFS_ERR_AGAIN) return;
+    VOID_CHECK_ERR;
+}
+
+void jfs_ns_write_cursor_init(jfs_ns_write_cursor_t *cursor_init, struct iovec *iov_array, size_t iov_count) {
+    cursor_init->iov_array = iov_array;
+    cursor_init->iov_count = iov_count;
+    cursor_init->sent = 0;
+}
+
+void jfs_ns_write_cursor_send(const jfs_ns_socket_t *sock, jfs_ns_write_cursor_t *cursor, int flags, jfs_err_t *err) {
+    struct msghdr msg = {0};
+    msg.msg_iov = cursor->iov_array;
+    msg.msg_iovlen = cursor->iov_count;
+
+    while (msg.msg_iovlen > 0) {
+        const size_t size_sent = jfs_sendmsg(sock->fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT | flags, err);
+        if (*err == JFS_ERR_INTER) {
+            RES_ERR;
+            continue;
+        }
+        if (*err != JFS_OK) break;
+
+        cursor->sent += size_sent;
+        ns_iov_advance(&msg, size_sent);
+    }
+
+    // fully sent iovecs are dropped from the front so the next call starts where this one stopped
+    cursor->iov_array = msg.msg_iov;
+    cursor->iov_count = msg.msg_iovlen;
+    if (*err == JFS_ERR_AGAIN) return;
+    VOID_CHECK_ERR;
+}
+
+jfs_ns_reactor_t *jfs_ns_reactor_create(jfs_err_t *err) {
+    jfs_ns_reactor_t *reactor = jfs_malloc(sizeof(*reactor), err);
+    NULL_CHECK_ERR;
+    memset(reactor, 0, sizeof(*reactor));
+    atomic_init(&reactor->stop, false);
+    reactor->next_timer_id = 1;
+
+    reactor->timer_array = jfs_malloc(sizeof(*reactor->timer_array) * REACTOR_TIMER_CAPACITY, err);
+    GOTO_IF_ERR(cleanup_reactor);
+    reactor->timer_capacity = REACTOR_TIMER_CAPACITY;
+
+    reactor->epoll_fd = jfs_epoll_create1(EPOLL_CLOEXEC, err);
+    GOTO_IF_ERR(cleanup_timers);
+
+    reactor->wake_fd = jfs_eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC, err);
+    GOTO_IF_ERR(cleanup_epoll);
+
+    // a null data pointer marks the wake up eventfd
+    struct epoll_event event = {.events = EPOLLIN, .data.ptr = NULL};
+    jfs_epoll_ctl(reactor->epoll_fd, EPOLL_CTL_ADD, reactor->wake_fd, &event, err);
+    GOTO_IF_ERR(cleanup_wake);
+
+    return reactor;
+cleanup_wake:
+    close(reactor->wake_fd);
+cleanup_epoll:
+    close(reactor->epoll_fd);
+cleanup_timers:
+    free(reactor->timer_array);
+cleanup_reactor:
+    free(reactor);
+    NULL_RETURN_ERR;
+}
+
+void jfs_ns_reactor_destroy(jfs_ns_reactor_t *reactor_move) {
+    if (reactor_move == NULL) return;
+    close(reactor_move->wake_fd);
+    close(reactor_move->epoll_fd);
+    free(reactor_move->timer_array);
+    free(reactor_move);
+}
+
+void jfs_ns_reactor_add(jfs_ns_reactor_t *reactor, jfs_ns_socket_t *sock, jfs_ns_event_fn on_event, void *ctx, jfs_err_t *err) {
+    VOID_FAIL_IF(on_event == NULL || sock->fd == -1, JFS_ERR_ARG);
+
+    jfs_ns_socket_set_nonblock(sock, err);
+    VOID_CHECK_ERR;
+
+    sock->on_event = on_event;
+    sock->event_ctx = ctx;
+
+    // registered once for both directions, edge triggering means no re-arming as interest changes
+    struct epoll_event event = {.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET, .data.ptr = sock};
+    jfs_epoll_ctl(reactor->epoll_fd, EPOLL_CTL_ADD, sock->fd, &event, err);
+    VOID_CHECK_ERR;
+}
+
+void jfs_ns_reactor_remove(jfs_ns_reactor_t *reactor, jfs_ns_socket_t *sock, jfs_err_t *err) {
+    jfs_epoll_ctl(reactor->epoll_fd, EPOLL_CTL_DEL, sock->fd, NULL, err);
+    VOID_CHECK_ERR;
+
+    sock->on_event = NULL;
+    sock->event_ctx = NULL;
+}
+
+uint64_t jfs_ns_reactor_timer_add(jfs_ns_reactor_t *reactor, uint64_t delay_ms, jfs_ns_timer_fn on_timer, void *ctx, jfs_err_t *err) {
+    VAL_FAIL_IF(on_timer == NULL, JFS_ERR_ARG, 0);
+
+    if (reactor->timer_count == reactor->timer_capacity) {
+        const size_t new_capacity = reactor->timer_capacity * 2;
+        ns_timer_t  *new_array = jfs_realloc(reactor->timer_array, sizeof(*new_array) * new_capacity, err);
+        VAL_CHECK_ERR(0);
+        reactor->timer_array = new_array;
+        reactor->timer_capacity = new_capacity;
+    }
+
+    const uint64_t timer_id = reactor->next_timer_id++;
+    reactor->timer_array[reactor->timer_count] = (ns_timer_t) {
+        .deadline_ms = ns_now_ms() + delay_ms,
+        .id = timer_id,
+        .on_timer = on_timer,
+        .ctx = ctx,
+    };
+    ns_timer_sift_up(reactor->timer_array, reactor->timer_count);
+    reactor->timer_count += 1;
+
+    return timer_id;
+}
+
+void jfs_ns_reactor_timer_cancel(jfs_ns_reactor_t *reactor, uint64_t timer_id) {
+    if (timer_id == 0) return;
+
+    for (size_t i = 0; i < reactor->timer_count; i++) {
+        if (reactor->timer_array[i].id != timer_id) continue;
+
+        // the last timer fills the hole and moves whichever way restores the heap
+        reactor->timer_count -= 1;
+        if (i == reactor->timer_count) return;
+        reactor->timer_array[i] = reactor->timer_array[reactor->timer_count];
+        ns_timer_sift_up(reactor->timer_array, i);
+        ns_timer_sift_down(reactor->timer_array, reactor->timer_count, i);
+        return;
+    }
+}
+
+void jfs_ns_reactor_run(jfs_ns_reactor_t *reactor, jfs_err_t *err) {
+    struct epoll_event event_array[REACTOR_EVENT_COUNT];
+
+    while (!atomic_load(&reactor->stop)) {
+        const uint32_t event_count = jfs_epoll_wait(reactor->epoll_fd, event_array, REACTOR_EVENT_COUNT, ns_reactor_timeout(reactor), err);
+        if (*err == JFS_ERR_INTER) {
+            RES_ERR;
+            continue;
+        }
+        VOID_CHECK_ERR;
+
+        for (uint32_t i = 0; i < event_count; i++) {
+            jfs_ns_socket_t *sock = (jfs_ns_socket_t *) event_array[i].data.ptr;
+            if (sock == NULL) {
+                uint64_t wake_count;
+                (void) read(reactor->wake_fd, &wake_count, sizeof(wake_count));
+                continue;
+            }
+
+            const uint32_t events = event_array[i].events;
+            uint32_t       ns_events = 0;
+            if ((events & EPOLLIN) != 0) ns_events |= JFS_NS_EV_READ;
+            if ((events & EPOLLOUT) != 0) ns_events |= JFS_NS_EV_WRITE;
+            if ((events & (EPOLLRDHUP | EPOLLHUP)) != 0) ns_events |= JFS_NS_EV_HANGUP;
+            if ((events & EPOLLERR) != 0) ns_events |= JFS_NS_EV_ERROR;
+
+            sock->on_event(reactor, sock, ns_events, sock->event_ctx);
+        }
+
+        ns_reactor_fire_timers(reactor);
+    }
+}
+
+void jfs_ns_reactor_stop(jfs_ns_reactor_t *reactor) {
+    atomic_store(&reactor->stop, true);
+
+    const uint64_t wake_count = 1;
+    (void) write(reactor->wake_fd, &wake_count, sizeof(wake_count));
+}
+
+static size_t ns_sendfile_copy(const jfs_ns_socket_t *sock, int file_fd, off_t offset, size_t size, jfs_err_t *err) {
+    // for descriptors sendfile can not read from, same interface through a bounce buffer
+    uint8_t *buf = jfs_malloc(BOUNCE_BUF_SIZE, err);
+    VAL_CHECK_ERR(0);
+
+    size_t total_sent = 0;
+    while (total_sent < size) {
+        const size_t chunk_size = size - total_sent < BOUNCE_BUF_SIZE ? size - total_sent : BOUNCE_BUF_SIZE;
+        const size_t size_read = jfs_pread(file_fd, buf, chunk_size, offset + (off_t) total_sent, err);
+        if (*err == JFS_ERR_INTER) {
+            RES_ERR;
+            continue;
+        }
+        if (*err == JFS_OK && size_read == 0) *err = JFS_ERR_FIO_FILE_END;
+        if (*err != JFS_OK) break;
+
+        total_sent += jfs_ns_socket_send(sock, buf, size_read, 0, err);
+        if (*err != JFS_OK) break;
+    }
+
+    free(buf);
+    if (*err == JFS_ERR_AGAIN) return total_sent;
+    VAL_CHECK_ERR(total_sent);
+    return total_sent;
+}
+
+static size_t ns_recv_file_copy(const jfs_ns_socket_t *sock, int file_fd, off_t offset, size_t size, jfs_err_t *err) {
+    // for targets splice can not write to, same interface through a bounce buffer
+    uint8_t *buf = jfs_malloc(BOUNCE_BUF_SIZE, err);
+    VAL_CHECK_ERR(0);
+
+    size_t total_received = 0;
+    while (total_received < size) {
+        const size_t chunk_size = size - total_received < BOUNCE_BUF_SIZE ? size - total_received : BOUNCE_BUF_SIZE;
+        const size_t size_received = jfs_recv(sock->fd, buf, chunk_size, 0, err);
+        if (*err == JFS_ERR_INTER) {
+            RES_ERR;
+            continue;
+        }
+        if (*err == JFS_OK && size_received == 0) *err = JFS_ERR_NS_CONNECTION_CLOSE;
+        if (*err != JFS_OK) break;
+
+        size_t written = 0;
+        while (written < size_received && *err == JFS_OK) {
+            written += jfs_pwrite(file_fd, buf + written, size_received - written, offset + (off_t) (total_received + written), err);
+            if (*err == JFS_ERR_INTER) RES_ERR;
+        }
+        if (*err != JFS_OK) break;
+        total_received += size_received;
+    }
+
+    free(buf);
+    if (*err == JFS_ERR_AGAIN) return total_received;
+    VAL_CHECK_ERR(total_received);
+    return total_received;
+}
+
+static void ns_splice_drain(jfs_ns_splice_t *splice, int file_fd, off_t *file_off, size_t size, jfs_err_t *err) {
+    while (size > 0) {
+        const size_t size_written = jfs_splice(splice->pipe_fd[0], NULL, file_fd, file_off, size, SPLICE_F_MOVE, err);
+        if (*err == JFS_ERR_INTER) {
+            RES_ERR;
+            continue;
+        }
+        if (*err == JFS_ERR_FIO_UNSUPPORTED) {
+            RES_ERR;
+            ns_splice_drain_copy(splice, file_fd, file_off, size, err);
+            VOID_CHECK_ERR;
+            return;
+        }
+        VOID_CHECK_ERR;
+        size -= size_written;
+    }
+}
+
+static void ns_splice_drain_copy(jfs_ns_splice_t *splice, int file_fd, off_t *file_off, size_t size, jfs_err_t *err) {
+    // O_APPEND and some filesystems refuse splice writes, the pipe is emptied with read / pwrite instead
+    uint8_t *buf = jfs_malloc(BOUNCE_BUF_SIZE, err);
+    VOID_CHECK_ERR;
+
+    while (size > 0 && *err == JFS_OK) {
+        const size_t chunk_size = size < BOUNCE_BUF_SIZE ? size : BOUNCE_BUF_SIZE;
+        const size_t size_read = jfs_read(splice->pipe_fd[0], buf, chunk_size, err);
+        if (*err == JFS_ERR_INTER) {
+            RES_ERR;
+            continue;
+        }
+        if (*err != JFS_OK) break;
+
+        size_t written = 0;
+        while (written < size_read && *err == JFS_OK) {
+            written += jfs_pwrite(file_fd, buf + written, size_read - written, *file_off + (off_t) written, err);
+            if (*err == JFS_ERR_INTER) RES_ERR;
+        }
+        *file_off += (off_t) written;
+        size -= size_read;
+    }
+
+    free(buf);
+    VOID_CHECK_ERR;
+}
+
+static void ns_zc_complete(jfs_ns_zc_t *zc, uint32_t lo_id, uint32_t hi_id) {
+    // unsigned differences keep the range check right across id wrap around
+    for (size_t i = 0; i < zc->count; i++) {
+        jfs_ns_zc_send_t *send = &zc->send_array[(zc->head + i) % zc->capacity];
+        for (uint32_t j = 0; j < send->id_count && send->remaining > 0; j++) {
+            if (send->first_id + j - lo_id <= hi_id - lo_id) send->remaining -= 1;
+        }
+    }
+}
+
+static void ns_zc_release(jfs_ns_zc_t *zc) {
+    while (zc->count > 0 && zc->send_array[zc->head].remaining == 0) {
+        const jfs_ns_zc_send_t send = zc->send_array[zc->head];
+        zc->head = (zc->head + 1) % zc->capacity;
+        zc->count -= 1;
+
+        if (send.done != NULL) send.done(send.ctx);
+    }
+}
+
+static void ns_iov_advance(struct msghdr *msg, size_t size_sent) {
+    while (msg->msg_iovlen > 0 && size_sent >= msg->msg_iov->iov_len) {
+        size_sent -= msg->msg_iov->iov_len;
+        msg->msg_iov += 1;
+        msg->msg_iovlen -= 1;
+    }
+    if (msg->msg_iovlen > 0) {
+        msg->msg_iov->iov_base = (uint8_t *) msg->msg_iov->iov_base + size_sent;
+        msg->msg_iov->iov_len -= size_sent;
+    }
+}
+
+static uint64_t ns_now_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * REACTOR_MS_PER_SEC + (uint64_t) now.tv_nsec / REACTOR_NS_PER_MS;
+}
+
+static uint32_t ns_wmem_max(void) {
+    // without the sysctl the read back after setting is the only guard
+    jfs_err_t  err_val = JFS_OK;
+    jfs_err_t *err = &err_val;
+    const int  fd = jfs_open(TUNE_WMEM_MAX_PATH, O_RDONLY | O_CLOEXEC, 0, err);
+    if (*err != JFS_OK) {
+        IGNORE_ERR;
+        return UINT32_MAX;
+    }
+
+    char         text[32]; // NOLINT
+    const size_t size = jfs_read(fd, text, sizeof(text) - 1, err);
+    const bool   read_ok = *err == JFS_OK;
+    IGNORE_ERR;
+    jfs_close(fd, err);
+    IGNORE_ERR;
+    if (!read_ok) return UINT32_MAX;
+
+    text[size] = '\0';
+    const unsigned long value = strtoul(text, NULL, 10); // NOLINT
+    return value == 0 || value > UINT32_MAX ? UINT32_MAX : (uint32_t) value;
+}
+
+static int ns_reactor_timeout(const jfs_ns_reactor_t *reactor) {
+    if (reactor->timer_count == 0) return -1;
+
+    const uint64_t now_ms = ns_now_ms();
+    const uint64_t deadline_ms = reactor->timer_array[0].deadline_ms;
+    if (deadline_ms <= now_ms) return 0;
+    if (deadline_ms - now_ms > INT_MAX) return INT_MAX;
+    return (int) (deadline_ms - now_ms);
+}
+
+static void ns_reactor_fire_timers(jfs_ns_reactor_t *reactor) {
+    const uint64_t now_ms = ns_now_ms();
+
+    // each timer is popped before it runs, so callbacks are free to add or cancel timers
+    while (reactor->timer_count > 0 && reactor->timer_array[0].deadline_ms <= now_ms) {
+        const ns_timer_t timer = reactor->timer_array[0];
+        reactor->timer_count -= 1;
+        reactor->timer_array[0] = reactor->timer_array[reactor->timer_count];
+        ns_timer_sift_down(reactor->timer_array, reactor->timer_count, 0);
+
+        timer.on_timer(reactor, timer.ctx);
+    }
+}
+
+static void ns_timer_sift_up(ns_timer_t *timer_array, size_t index) {
+    while (index > 0) {
+        const size_t parent = (index - 1) / 2;
+        if (timer_array[parent].deadline_ms <= timer_array[index].deadline_ms) return;
+
+        const ns_timer_t tmp = timer_array[parent];
+        timer_array[parent] = timer_array[index];
+        timer_array[index] = tmp;
+        index = parent;
+    }
+}
+
+static void ns_timer_sift_down(ns_timer_t *timer_array, size_t count, size_t index) {
+    for (;;) {
+        const size_t left = index * 2 + 1;
+        const size_t right = left + 1;
+        size_t       smallest = index;
+
+        if (left < count && timer_array[left].deadline_ms < timer_array[smallest].deadline_ms) smallest = left;
+        if (right < count && timer_array[right].deadline_ms < timer_array[smallest].deadline_ms) smallest = right;
+        if (smallest == index) return;
+
+        const ns_timer_t tmp = timer_array[smallest];
+        timer_array[smallest] = timer_array[index];
+        timer_array[index] = tmp;
+        index = smallest;
+    }
+}
@@ -0,0 +1,212 @@
+#include "path_table.h"
+#include "error.h"
+#include "file_io.h"
+#include <assert.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PT_NODE_DEFAULT_CAPACITY 64
+#define PT_NAME_DEFAULT_CAPACITY 1024
+#define PT_SLOT_DEFAULT_CAPACITY 128
+
+#define PT_FNV_OFFSET 2166136261U
+#define PT_FNV_PRIME  16777619U
+
+static size_t      pt_sep_len(const jfs_pt_t *pt, jfs_pt_id_t parent) WUR;
+static uint32_t    pt_hash(jfs_pt_id_t parent, const char *name_str, size_t name_len) WUR;
+static int         pt_node_matches(const jfs_pt_t *pt, jfs_pt_id_t id, jfs_pt_id_t parent, const jfs_fio_name_t *name) WUR;
+static jfs_pt_id_t pt_add_node(jfs_pt_t *pt, jfs_pt_id_t parent, const char *name_str, size_t name_len, size_t path_len, jfs_err_t *err) WUR;
+static void        pt_slot_insert(jfs_pt_id_t *slot_array, size_t slot_capacity, uint32_t hash, jfs_pt_id_t id);
+static void        pt_slot_grow(jfs_pt_t *pt, jfs_err_t *err);
+
+void jfs_pt_init(jfs_pt_t *pt_init, const jfs_fio_path_t *root_path, jfs_err_t *err) {
+    VOID_FAIL_IF(root_path->len == 0 || root_path->len > PATH_MAX, JFS_ERR_ARG);
+
+    jfs_pt_t pt = {0};
+
+    pt.node_array = jfs_malloc(sizeof(*pt.node_array) * PT_NODE_DEFAULT_CAPACITY, err);
+    GOTO_IF_ERR(cleanup);
+    pt.node_capacity = PT_NODE_DEFAULT_CAPACITY;
+
+    pt.name_array = jfs_malloc(PT_NAME_DEFAULT_CAPACITY, err);
+    GOTO_IF_ERR(cleanup);
+    pt.name_capacity = PT_NAME_DEFAULT_CAPACITY;
+
+    pt.slot_array = jfs_malloc(sizeof(*pt.slot_array) * PT_SLOT_DEFAULT_CAPACITY, err);
+    GOTO_IF_ERR(cleanup);
+    pt.slot_capacity = PT_SLOT_DEFAULT_CAPACITY;
+    memset(pt.slot_array, 0xFF, sizeof(*pt.slot_array) * PT_SLOT_DEFAULT_CAPACITY); // JFS_PT_NONE
+
+    // the root holds the whole start path as its name and is never hashed
+    const jfs_pt_id_t root_id = pt_add_node(&pt, JFS_PT_NONE, root_path->str, root_path->len, root_path->len, err);
+    GOTO_IF_ERR(cleanup);
+    assert(root_id == JFS_PT_ROOT);
+    (void) root_id;
+
+    *pt_init = pt;
+    return;
+cleanup:
+    jfs_pt_free(&pt);
+    VOID_RETURN_ERR;
+}
+
+void jfs_pt_free(jfs_pt_t *pt_free) {
+    free(pt_free->node_array);
+    free(pt_free->name_array);
+    free(pt_free->slot_array);
+    memset(pt_free, 0, sizeof(*pt_free));
+}
+
+void jfs_pt_transfer(jfs_pt_t *pt_init, jfs_pt_t *pt_free) {
+    *pt_init = *pt_free;
+    memset(pt_free, 0, sizeof(*pt_free));
+}
+
+jfs_pt_id_t jfs_pt_intern(jfs_pt_t *pt, jfs_pt_id_t parent, const jfs_fio_name_t *name, jfs_err_t *err) {
+    VAL_FAIL_IF(parent >= pt->node_count || name->len == 0 || name->len > NAME_MAX, JFS_ERR_ARG, JFS_PT_NONE);
+
+    const jfs_pt_id_t found = jfs_pt_lookup(pt, parent, name);
+    if (found != JFS_PT_NONE) return found;
+
+    const size_t path_len = pt->node_array[parent].path_len + pt_sep_len(pt, parent) + name->len;
+    VAL_FAIL_IF(path_len > PATH_MAX, JFS_ERR_FIO_PATH_OVERFLOW, JFS_PT_NONE);
+
+    if ((pt->node_count + 1) * 2 > pt->slot_capacity) {
+        pt_slot_grow(pt, err);
+        VAL_CHECK_ERR(JFS_PT_NONE);
+    }
+
+    const jfs_pt_id_t id = pt_add_node(pt, parent, name->str, name->len, path_len, err);
+    VAL_CHECK_ERR(JFS_PT_NONE);
+
+    pt_slot_insert(pt->slot_array, pt->slot_capacity, pt_hash(parent, name->str, name->len), id);
+    return id;
+}
+
+jfs_pt_id_t jfs_pt_lookup(const jfs_pt_t *pt, jfs_pt_id_t parent, const jfs_fio_name_t *name) {
+    const size_t mask = pt->slot_capacity - 1;
+    size_t       index = pt_hash(parent, name->str, name->len) & mask;
+
+    while (pt->slot_array[index] != JFS_PT_NONE) {
+        if (pt_node_matches(pt, pt->slot_array[index], parent, name)) return pt->slot_array[index];
+        index = (index + 1) & mask;
+    }
+
+    return JFS_PT_NONE;
+}
+
+jfs_pt_id_t jfs_pt_parent(const jfs_pt_t *pt, jfs_pt_id_t id) {
+    if (id >= pt->node_count) return JFS_PT_NONE;
+    return pt->node_array[id].parent;
+}
+
+void jfs_pt_path_buf(const jfs_pt_t *pt, jfs_pt_id_t id, jfs_fio_path_buf_t *buf, jfs_err_t *err) {
+    VOID_FAIL_IF(id >= pt->node_count, JFS_ERR_ARG);
+
+    // path_len is known up front, so components are copied in from the end without a reverse pass
+    const size_t path_len = pt->node_array[id].path_len;
+    size_t       end = path_len;
+    jfs_pt_id_t  cursor = id;
+
+    while (cursor != JFS_PT_ROOT) {
+        const jfs_pt_node_t *node = &pt->node_array[cursor];
+        end -= node->name_len;
+        memcpy(buf->data + end, pt->name_array + node->name_offset, node->name_len);
+        if (pt_sep_len(pt, node->parent) == 1) {
+            end -= 1;
+            buf->data[end] = '/';
+        }
+        cursor = node->parent;
+    }
+
+    memcpy(buf->data, pt->name_array + pt->node_array[JFS_PT_ROOT].name_offset, end);
+    buf->data[path_len] = '\0';
+    buf->len = path_len;
+}
+
+static size_t pt_sep_len(const jfs_pt_t *pt, jfs_pt_id_t parent) {
+    // a root of "/" already ends in a separator
+    const jfs_pt_node_t *root = &pt->node_array[JFS_PT_ROOT];
+    return parent == JFS_PT_ROOT && root->name_len == 1 && pt->name_array[root->name_offset] == '/' ? 0 : 1;
+}
+
+static uint32_t pt_hash(jfs_pt_id_t parent, const char *name_str, size_t name_len) {
+    uint32_t hash = PT_FNV_OFFSET;
+    for (size_t i = 0; i < sizeof(parent); i++) {
+        hash = (hash ^ ((parent >> (i * 8)) & 0xFF)) * PT_FNV_PRIME; // NOLINT
+    }
+    for (size_t i = 0; i < name_len; i++) {
+        hash = (hash ^ (uint8_t) name_str[i]) * PT_FNV_PRIME;
+    }
+    return hash;
+}
+
+static int pt_node_matches(const jfs_pt_t *pt, jfs_pt_id_t id, jfs_pt_id_t parent, const jfs_fio_name_t *name) {
+    const jfs_pt_node_t *node = &pt->node_array[id];
+    return node->parent == parent && node->name_len == name->len && memcmp(pt->name_array + node->name_offset, name->str, name->len) == 0;
+}
+
+static jfs_pt_id_t pt_add_node(jfs_pt_t *pt, jfs_pt_id_t parent, const char *name_str, size_t name_len, size_t path_len, jfs_err_t *err) {
+    VAL_FAIL_IF(pt->node_count >= JFS_PT_NONE || pt->name_len + name_len > UINT32_MAX, JFS_ERR_FULL, JFS_PT_NONE);
+
+    if (pt->node_count >= pt->node_capacity) {
+        const size_t   new_capacity = pt->node_capacity * 2;
+        jfs_pt_node_t *new_node_array = jfs_realloc(pt->node_array, sizeof(*new_node_array) * new_capacity, err);
+        VAL_CHECK_ERR(JFS_PT_NONE);
+
+        pt->node_array = new_node_array;
+        pt->node_capacity = new_capacity;
+    }
+
+    if (pt->name_len + name_len > pt->name_capacity) {
+        size_t new_capacity = pt->name_capacity * 2;
+        while (pt->name_len + name_len > new_capacity) {
+            new_capacity *= 2;
+        }
+        char *new_name_array = jfs_realloc(pt->name_array, new_capacity, err);
+        VAL_CHECK_ERR(JFS_PT_NONE);
+
+        pt->name_array = new_name_array;
+        pt->name_capacity = new_capacity;
+    }
+
+    const jfs_pt_id_t id = (jfs_pt_id_t) pt->node_count;
+    jfs_pt_node_t    *node = &pt->node_array[id];
+    node->parent = parent;
+    node->name_offset = (uint32_t) pt->name_len;
+    node->name_len = (uint16_t) name_len;
+    node->path_len = (uint16_t) path_len;
+
+    memcpy(pt->name_array + pt->name_len, name_str, name_len);
+    pt->name_len += name_len;
+    pt->node_count += 1;
+    return id;
+}
+
+static void pt_slot_insert(jfs_pt_id_t *slot_array, size_t slot_capacity, uint32_t hash, jfs_pt_id_t id) {
+    const size_t mask = slot_capacity - 1;
+    size_t       index = hash & mask;
+
+    while (slot_array[index] != JFS_PT_NONE) {
+        index = (index + 1) & mask;
+    }
+    slot_array[index] = id;
+}
+
+static void pt_slot_grow(jfs_pt_t *pt, jfs_err_t *err) {
+    const size_t new_capacity = pt->slot_capacity * 2;
+    jfs_pt_id_t *new_slot_array = jfs_malloc(sizeof(*new_slot_array) * new_capacity, err);
+    VOID_CHECK_ERR;
+    memset(new_slot_array, 0xFF, sizeof(*new_slot_array) * new_capacity); // JFS_PT_NONE
+
+    for (size_t id = 1; id < pt->node_count; id++) {
+        const jfs_pt_node_t *node = &pt->node_array[id];
+        const uint32_t       hash = pt_hash(node->parent, pt->name_array + node->name_offset, node->name_len);
+        pt_slot_insert(new_slot_array, new_capacity, hash, (jfs_pt_id_t) id);
+    }
+
+    free(pt->slot_array);
+    pt->slot_array = new_slot_array;
+    pt->slot_capacity = new_capacity;
+}
@@ -0,0 +1,197 @@
+#include "read_ahead.h"
+#include "buffer_pool.h"
+#include "error.h"
+#include "file_io.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RA_DEFAULT_DEPTH 4
+
+typedef struct ra_slot ra_slot_t;
+
+struct ra_slot {
+    jfs_bp_buf_t *buf;
+    off_t         offset;
+};
+
+// single producer, single consumer, the lock is only taken by a side that has to sleep
+struct jfs_ra {
+    int             fd;
+    off_t           offset;
+    off_t           end;
+    size_t          chunk_size;
+    jfs_bp_t       *pool;
+    size_t          mask;
+    ra_slot_t      *slot_array;
+    atomic_size_t   head; // consumer cursor
+    atomic_size_t   tail; // producer cursor
+    atomic_bool     done;
+    atomic_bool     stop;
+    atomic_uint     sleepers;
+    jfs_err_t       producer_err;
+    pthread_mutex_t lock;
+    pthread_cond_t  wake;
+    pthread_t       producer;
+};
+
+static void *ra_produce(void *arg);
+static void  ra_wait(jfs_ra_t *ra, bool for_space);
+static void  ra_notify(jfs_ra_t *ra);
+
+jfs_ra_t *jfs_ra_create(const jfs_ra_conf_t *conf, jfs_err_t *err) {
+    NULL_FAIL_IF(conf->fd < 0 || conf->offset < 0 || conf->size < 0 || conf->chunk_size == 0 || conf->pool == NULL, JFS_ERR_ARG);
+
+    jfs_ra_t *ra = jfs_malloc(sizeof(*ra), err);
+    NULL_CHECK_ERR;
+    memset(ra, 0, sizeof(*ra));
+
+    size_t depth = 1;
+    while (depth < (conf->depth == 0 ? RA_DEFAULT_DEPTH : conf->depth)) {
+        depth *= 2;
+    }
+
+    ra->fd = conf->fd;
+    ra->offset = conf->offset;
+    ra->end = conf->offset + conf->size;
+    ra->chunk_size = conf->chunk_size;
+    ra->pool = conf->pool;
+    ra->mask = depth - 1;
+    ra->producer_err = JFS_OK;
+    atomic_init(&ra->head, 0);
+    atomic_init(&ra->tail, 0);
+    atomic_init(&ra->done, false);
+    atomic_init(&ra->stop, false);
+    atomic_init(&ra->sleepers, 0);
+
+    ra->slot_array = jfs_malloc(sizeof(*ra->slot_array) * depth, err);
+    GOTO_IF_ERR(cleanup_ra);
+
+    jfs_mutex_init(&ra->lock, NULL, err);
+    GOTO_IF_ERR(cleanup_slots);
+    jfs_cond_init(&ra->wake, NULL, err);
+    GOTO_IF_ERR(cleanup_lock);
+
+    // the producer thread does the reads, this only widens the kernel's own window
+    jfs_posix_fadvise(ra->fd, conf->offset, conf->size, POSIX_FADV_SEQUENTIAL, err);
+    if (*err != JFS_OK) RES_ERR;
+
+    jfs_pthread_create(&ra->producer, NULL, ra_produce, ra, err);
+    GOTO_IF_ERR(cleanup_cond);
+
+    return ra;
+cleanup_cond:
+    pthread_cond_destroy(&ra->wake);
+cleanup_lock:
+    pthread_mutex_destroy(&ra->lock);
+cleanup_slots:
+    free(ra->slot_array);
+cleanup_ra:
+    free(ra);
+    NULL_RETURN_ERR;
+}
+
+void jfs_ra_destroy(jfs_ra_t *ra_move) {
+    atomic_store(&ra_move->stop, true);
+
+    // the producer sleeps either for ring space or for a pool buffer, both waits look at stop again once woken
+    ra_notify(ra_move);
+    jfs_bp_wake(ra_move->pool);
+    pthread_join(ra_move->producer, NULL);
+
+    const size_t tail = atomic_load(&ra_move->tail);
+    for (size_t head = atomic_load(&ra_move->head); head != tail; head++) {
+        jfs_bp_release(ra_move->slot_array[head & ra_move->mask].buf);
+    }
+
+    pthread_cond_destroy(&ra_move->wake);
+    pthread_mutex_destroy(&ra_move->lock);
+    free(ra_move->slot_array);
+    free(ra_move);
+}
+
+jfs_bp_buf_t *jfs_ra_next(jfs_ra_t *ra, off_t *offset_out, jfs_err_t *err) {
+    const size_t head = atomic_load_explicit(&ra->head, memory_order_relaxed);
+
+    while (head == atomic_load_explicit(&ra->tail, memory_order_acquire)) {
+        if (atomic_load(&ra->done)) {
+            // done is set after the last push, so the tail has to be looked at once more
+            if (head != atomic_load_explicit(&ra->tail, memory_order_acquire)) break;
+            *err = ra->producer_err != JFS_OK ? ra->producer_err : JFS_ERR_FIO_FILE_END;
+            NULL_RETURN_ERR;
+        }
+        ra_wait(ra, false);
+    }
+
+    const ra_slot_t slot = ra->slot_array[head & ra->mask];
+    atomic_store(&ra->head, head + 1);
+    ra_notify(ra);
+
+    if (offset_out != NULL) *offset_out = slot.offset;
+    return slot.buf;
+}
+
+static void *ra_produce(void *arg) {
+    jfs_ra_t  *ra = (jfs_ra_t *) arg;
+    jfs_err_t  err_val = JFS_OK;
+    jfs_err_t *err = &err_val;
+
+    while (ra->offset < ra->end && !atomic_load(&ra->stop)) {
+        const size_t tail = atomic_load_explicit(&ra->tail, memory_order_relaxed);
+        if (tail - atomic_load_explicit(&ra->head, memory_order_acquire) > ra->mask) {
+            ra_wait(ra, true);
+            continue;
+        }
+
+        const size_t  want = (size_t) (ra->end - ra->offset) < ra->chunk_size ? (size_t) (ra->end - ra->offset) : ra->chunk_size;
+        // the consumer may hold every pool buffer, destroy still has to get through
+        jfs_bp_buf_t *buf = jfs_bp_acquire_unless(ra->pool, want, &ra->stop, err);
+        if (*err != JFS_OK) break;
+
+        buf->len = jfs_fio_pread(ra->fd, buf->data, want, ra->offset, err);
+        if (*err == JFS_ERR_FIO_FILE_END) {
+            // the file shrank, hand over what was there and stop early
+            RES_ERR;
+            ra->end = ra->offset + (off_t) buf->len;
+        }
+        if (*err != JFS_OK || buf->len == 0) {
+            jfs_bp_release(buf);
+            break;
+        }
+
+        ra->slot_array[tail & ra->mask] = (ra_slot_t) {.buf = buf, .offset = ra->offset};
+        ra->offset += (off_t) buf->len;
+        atomic_store(&ra->tail, tail + 1);
+        ra_notify(ra);
+    }
+
+    ra->producer_err = *err;
+    atomic_store(&ra->done, true);
+    ra_notify(ra);
+    return NULL;
+}
+
+static void ra_wait(jfs_ra_t *ra, bool for_space) {
+    pthread_mutex_lock(&ra->lock);
+    atomic_fetch_add(&ra->sleepers, 1);
+
+    // recheck after registering as a sleeper, a notify in between would otherwise be lost
+    const size_t head = atomic_load(&ra->head);
+    const size_t tail = atomic_load(&ra->tail);
+    const bool   ready = for_space ? tail - head <= ra->mask || atomic_load(&ra->stop) : head != tail || atomic_load(&ra->done);
+    if (!ready) pthread_cond_wait(&ra->wake, &ra->lock);
+
+    atomic_fetch_sub(&ra->sleepers, 1);
+    pthread_mutex_unlock(&ra->lock);
+}
+
+static void ra_notify(jfs_ra_t *ra) {
+    if (atomic_load(&ra->sleepers) == 0) return;
+
+    pthread_mutex_lock(&ra->lock);
+    pthread_cond_broadcast(&ra->wake);
+    pthread_mutex_unlock(&ra->lock);
+}
@@ -0,0 +1,410 @@
+#include "stream_mux.h"
+#include "error.h"
+#include "net_socket.h"
+#include "wire_protocol.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MX_DEFAULT_MAX_STREAMS 1024
+#define MX_DEFAULT_WINDOW      (256 * 1024)
+#define MX_DEFAULT_FRAME_SIZE  (64 * 1024)
+#define MX_BATCH_FRAMES        16
+
+typedef struct mx_stream mx_stream_t;
+typedef struct mx_ring   mx_ring_t;
+
+// an id is its slot plus a per slot generation, so a stale frame never lands on a reused slot
+struct mx_stream {
+    uint32_t        id;
+    uint32_t        generation;
+    bool            open;
+    bool            end_queued;
+    bool            end_sent;
+    bool            end_recv;
+    bool            ready;
+    bool            granting;
+    uint64_t        send_credit;
+    uint32_t        recv_window;
+    uint32_t        grant;
+    jfs_mx_write_t *write_front;
+    jfs_mx_write_t *write_back;
+};
+
+// slot index queue, a slot is in a ring at most once
+struct mx_ring {
+    uint32_t  head;
+    uint32_t  count;
+    uint32_t *slot_array;
+};
+
+struct jfs_mx {
+    jfs_mx_conf_t         conf;
+    uint32_t              slot_count;
+    uint32_t              open_count;
+    uint32_t              open_hint;
+    mx_stream_t          *stream_array;
+    mx_ring_t             ready;
+    mx_ring_t             grants;
+    bool                  in_body;
+    jfs_wp_header_t       header;
+    uint8_t               header_buf[JFS_WP_HEADER_SIZE];
+    uint8_t              *body;
+    size_t                body_capacity; // grows up to JFS_MX_FRAME_MAX when the peer sends bigger frames
+    jfs_ns_read_cursor_t  read_cursor;
+    bool                  batch_pending;
+    size_t                batch_frames;
+    size_t                batch_iov_count;
+    size_t                batch_done_count;
+    uint8_t               batch_header_array[MX_BATCH_FRAMES][JFS_WP_HEADER_SIZE];
+    uint8_t               batch_grant_array[MX_BATCH_FRAMES][JFS_WP_VARINT_MAX];
+    struct iovec          batch_iov_array[MX_BATCH_FRAMES * 2];
+    jfs_mx_write_t       *batch_done_array[MX_BATCH_FRAMES];
+    jfs_ns_write_cursor_t write_cursor;
+};
+
+static mx_stream_t *mx_lookup(jfs_mx_t *mx, uint32_t stream_id) WUR;
+static bool         mx_local_slot(const jfs_mx_t *mx, uint32_t slot) WUR;
+static bool         mx_sendable(const mx_stream_t *stream) WUR;
+static void         mx_stream_init(jfs_mx_t *mx, mx_stream_t *stream, uint32_t stream_id);
+static void         mx_maybe_close(jfs_mx_t *mx, mx_stream_t *stream);
+static void         mx_mark_ready(jfs_mx_t *mx, mx_stream_t *stream);
+static void         mx_ring_push(mx_ring_t *ring, uint32_t slot, uint32_t capacity);
+static uint32_t     mx_ring_pop(mx_ring_t *ring, uint32_t capacity) WUR;
+static void         mx_batch_frame(jfs_mx_t *mx, jfs_wp_type_t type, uint32_t stream_id, const void *body, size_t len);
+static void         mx_batch_build(jfs_mx_t *mx);
+static void         mx_batch_done(jfs_mx_t *mx);
+static void         mx_handle_frame(jfs_mx_t *mx, jfs_err_t *err);
+
+jfs_mx_t *jfs_mx_create(const jfs_mx_conf_t *conf, jfs_err_t *err) {
+    NULL_FAIL_IF(conf->on_frame == NULL || conf->max_streams > UINT32_MAX / 2 || conf->frame_size > JFS_MX_FRAME_MAX, JFS_ERR_BAD_CONF);
+
+    jfs_mx_t *mx = jfs_malloc(sizeof(*mx), err);
+    NULL_CHECK_ERR;
+    memset(mx, 0, sizeof(*mx));
+
+    mx->conf = *conf;
+    if (mx->conf.max_streams == 0) mx->conf.max_streams = MX_DEFAULT_MAX_STREAMS;
+    if (mx->conf.window == 0) mx->conf.window = MX_DEFAULT_WINDOW;
+    if (mx->conf.frame_size == 0) mx->conf.frame_size = MX_DEFAULT_FRAME_SIZE;
+
+    // the client opens streams in the lower half of the slots and the server in the upper half
+    mx->slot_count = mx->conf.max_streams * 2;
+    mx->stream_array = jfs_malloc(sizeof(*mx->stream_array) * mx->slot_count, err);
+    GOTO_IF_ERR(cleanup_mx);
+    memset(mx->stream_array, 0, sizeof(*mx->stream_array) * mx->slot_count);
+
+    mx->ready.slot_array = jfs_malloc(sizeof(*mx->ready.slot_array) * mx->slot_count, err);
+    GOTO_IF_ERR(cleanup_streams);
+    mx->grants.slot_array = jfs_malloc(sizeof(*mx->grants.slot_array) * mx->slot_count, err);
+    GOTO_IF_ERR(cleanup_ready);
+
+    mx->body_capacity = mx->conf.frame_size > JFS_WP_META_CAPACITY ? mx->conf.frame_size : JFS_WP_META_CAPACITY;
+    mx->body = jfs_malloc(mx->body_capacity, err);
+    GOTO_IF_ERR(cleanup_grants);
+
+    jfs_ns_read_cursor_init(&mx->read_cursor, mx->header_buf, JFS_WP_HEADER_SIZE);
+    return mx;
+cleanup_grants:
+    free(mx->grants.slot_array);
+cleanup_ready:
+    free(mx->ready.slot_array);
+cleanup_streams:
+    free(mx->stream_array);
+cleanup_mx:
+    free(mx);
+    NULL_RETURN_ERR;
+}
+
+void jfs_mx_destroy(jfs_mx_t *mx_move) {
+    if (mx_move == NULL) return;
+    free(mx_move->body);
+    free(mx_move->grants.slot_array);
+    free(mx_move->ready.slot_array);
+    free(mx_move->stream_array);
+    free(mx_move);
+}
+
+uint32_t jfs_mx_open(jfs_mx_t *mx, jfs_err_t *err) {
+    const uint32_t half = mx->conf.max_streams;
+    const uint32_t base = mx->conf.client ? 0 : half;
+
+    for (uint32_t i = 0; i < half; i++) {
+        const uint32_t slot = base + (mx->open_hint + i) % half;
+        mx_stream_t   *stream = &mx->stream_array[slot];
+        if (stream->open) continue;
+
+        mx->open_hint = (mx->open_hint + i + 1) % half;
+        mx_stream_init(mx, stream, slot + mx->slot_count * stream->generation);
+        return stream->id;
+    }
+
+    *err = JFS_ERR_FULL;
+    VAL_RETURN_ERR(0);
+}
+
+void jfs_mx_write(jfs_mx_t *mx, jfs_mx_write_t *write, jfs_err_t *err) {
+    mx_stream_t *stream = mx_lookup(mx, write->stream_id);
+    VOID_FAIL_IF(stream == NULL || stream->end_queued, JFS_ERR_ARG);
+    VOID_FAIL_IF(write->type != JFS_WP_META && write->type != JFS_WP_DATA && write->type != JFS_WP_END, JFS_ERR_ARG);
+    VOID_FAIL_IF(write->type == JFS_WP_META && write->size > JFS_WP_META_CAPACITY, JFS_ERR_ARG);
+    VOID_FAIL_IF(write->type == JFS_WP_END && write->size != 0, JFS_ERR_ARG);
+
+    write->sent = 0;
+    write->next = NULL;
+    if (stream->write_back == NULL) {
+        stream->write_front = write;
+    } else {
+        stream->write_back->next = write;
+    }
+    stream->write_back = write;
+    if (write->type == JFS_WP_END) stream->end_queued = true;
+
+    mx_mark_ready(mx, stream);
+}
+
+void jfs_mx_consume(jfs_mx_t *mx, uint32_t stream_id, size_t size) {
+    mx_stream_t *stream = mx_lookup(mx, stream_id);
+    if (stream == NULL || stream->end_recv) return;
+
+    // credit goes back in chunks of half a window, so WINDOW frames stay rare
+    stream->grant += (uint32_t) size;
+    if (stream->grant >= mx->conf.window / 2 && !stream->granting) {
+        stream->granting = true;
+        mx_ring_push(&mx->grants, stream->id % mx->slot_count, mx->slot_count);
+    }
+}
+
+void jfs_mx_flush(jfs_mx_t *mx, const jfs_ns_socket_t *sock, jfs_err_t *err) {
+    for (;;) {
+        if (mx->batch_pending) {
+            jfs_ns_write_cursor_send(sock, &mx->write_cursor, 0, err);
+            if (*err == JFS_ERR_AGAIN) return;
+            VOID_CHECK_ERR;
+
+            mx->batch_pending = false;
+            mx_batch_done(mx);
+        }
+
+        mx_batch_build(mx);
+        if (mx->batch_frames == 0) return;
+
+        jfs_ns_write_cursor_init(&mx->write_cursor, mx->batch_iov_array, mx->batch_iov_count);
+        mx->batch_pending = true;
+    }
+}
+
+void jfs_mx_recv(jfs_mx_t *mx, const jfs_ns_socket_t *sock, jfs_err_t *err) {
+    for (;;) {
+        jfs_ns_read_cursor_recv(sock, &mx->read_cursor, err);
+        if (*err == JFS_ERR_AGAIN) return;
+        VOID_CHECK_ERR;
+
+        if (!mx->in_body) {
+            jfs_wp_header_unpack(&mx->header, mx->header_buf, err);
+            VOID_CHECK_ERR;
+
+            // the peer picks its own frame size, only the protocol bound is enforced
+            VOID_FAIL_IF(mx->header.length > JFS_MX_FRAME_MAX && mx->header.length > JFS_WP_META_CAPACITY, JFS_ERR_WP_BAD_FRAME);
+            if (mx->header.length > mx->body_capacity) {
+                uint8_t *new_body = jfs_realloc(mx->body, mx->header.length, err);
+                VOID_CHECK_ERR;
+                mx->body = new_body;
+                mx->body_capacity = mx->header.length;
+            }
+
+            mx->in_body = true;
+            jfs_ns_read_cursor_init(&mx->read_cursor, mx->body, mx->header.length);
+            continue;
+        }
+
+        mx->in_body = false;
+        jfs_ns_read_cursor_init(&mx->read_cursor, mx->header_buf, JFS_WP_HEADER_SIZE);
+
+        mx_handle_frame(mx, err);
+        VOID_CHECK_ERR;
+    }
+}
+
+size_t jfs_mx_stream_count(const jfs_mx_t *mx) {
+    return mx->open_count;
+}
+
+static mx_stream_t *mx_lookup(jfs_mx_t *mx, uint32_t stream_id) {
+    mx_stream_t *stream = &mx->stream_array[stream_id % mx->slot_count];
+    if (!stream->open || stream->id != stream_id) return NULL;
+    return stream;
+}
+
+static bool mx_local_slot(const jfs_mx_t *mx, uint32_t slot) {
+    return (slot < mx->conf.max_streams) == mx->conf.client;
+}
+
+static bool mx_sendable(const mx_stream_t *stream) {
+    const jfs_mx_write_t *write = stream->write_front;
+    if (write == NULL) return false;
+    return write->type != JFS_WP_DATA || stream->send_credit > 0 || write->size == 0;
+}
+
+static void mx_stream_init(jfs_mx_t *mx, mx_stream_t *stream, uint32_t stream_id) {
+    // ring membership outlives the old stream, the rings check open when they pop the slot
+    const mx_stream_t old = *stream;
+    memset(stream, 0, sizeof(*stream));
+    stream->generation = old.generation;
+    stream->ready = old.ready;
+    stream->granting = old.granting;
+    stream->id = stream_id;
+    stream->open = true;
+    stream->send_credit = mx->conf.window;
+    stream->recv_window = mx->conf.window;
+    mx->open_count += 1;
+}
+
+static void mx_maybe_close(jfs_mx_t *mx, mx_stream_t *stream) {
+    if (!stream->end_sent || !stream->end_recv) return;
+
+    // ready and grant rings skip closed slots when they pop them
+    stream->open = false;
+    stream->generation += 1;
+    mx->open_count -= 1;
+}
+
+static void mx_mark_ready(jfs_mx_t *mx, mx_stream_t *stream) {
+    if (stream->ready || !mx_sendable(stream)) return;
+    stream->ready = true;
+    mx_ring_push(&mx->ready, stream->id % mx->slot_count, mx->slot_count);
+}
+
+static void mx_ring_push(mx_ring_t *ring, uint32_t slot, uint32_t capacity) {
+    ring->slot_array[(ring->head + ring->count) % capacity] = slot;
+    ring->count += 1;
+}
+
+static uint32_t mx_ring_pop(mx_ring_t *ring, uint32_t capacity) {
+    const uint32_t slot = ring->slot_array[ring->head];
+    ring->head = (ring->head + 1) % capacity;
+    ring->count -= 1;
+    return slot;
+}
+
+static void mx_batch_frame(jfs_mx_t *mx, jfs_wp_type_t type, uint32_t stream_id, const void *body, size_t len) {
+    const jfs_wp_header_t header = {
+        .version = JFS_WP_VERSION,
+        .type = (uint8_t) type,
+        .flags = 0,
+        .stream_id = stream_id,
+        .length = (uint32_t) len,
+    };
+    uint8_t *header_buf = mx->batch_header_array[mx->batch_frames];
+    jfs_wp_header_pack(&header, header_buf);
+
+    mx->batch_iov_array[mx->batch_iov_count++] = (struct iovec) {.iov_base = header_buf, .iov_len = JFS_WP_HEADER_SIZE};
+    if (len > 0) mx->batch_iov_array[mx->batch_iov_count++] = (struct iovec) {.iov_base = (void *) body, .iov_len = len};
+    mx->batch_frames += 1;
+}
+
+static void mx_batch_build(jfs_mx_t *mx) {
+    mx->batch_frames = 0;
+    mx->batch_iov_count = 0;
+    mx->batch_done_count = 0;
+
+    while (mx->batch_frames < MX_BATCH_FRAMES) {
+        // credit updates go first, a peer stalled on credit costs more than any queued data
+        if (mx->grants.count > 0) {
+            mx_stream_t *stream = &mx->stream_array[mx_ring_pop(&mx->grants, mx->slot_count)];
+            stream->granting = false;
+            if (!stream->open || stream->end_recv || stream->grant == 0) continue;
+
+            uint8_t     *grant_buf = mx->batch_grant_array[mx->batch_frames];
+            const size_t grant_len = jfs_wp_varint_put(grant_buf, stream->grant);
+            stream->recv_window += stream->grant;
+            stream->grant = 0;
+            mx_batch_frame(mx, JFS_WP_WINDOW, stream->id, grant_buf, grant_len);
+            continue;
+        }
+        if (mx->ready.count == 0) return;
+
+        // one frame per stream per turn, so a big file can not starve the small ones behind it
+        mx_stream_t *stream = &mx->stream_array[mx_ring_pop(&mx->ready, mx->slot_count)];
+        stream->ready = false;
+        if (!stream->open || !mx_sendable(stream)) continue;
+
+        jfs_mx_write_t *write = stream->write_front;
+        size_t          len = write->size - write->sent;
+        if (write->type == JFS_WP_DATA) {
+            if (len > mx->conf.frame_size) len = mx->conf.frame_size;
+            if (len > stream->send_credit) len = (size_t) stream->send_credit;
+            stream->send_credit -= len;
+        }
+        mx_batch_frame(mx, write->type, stream->id, (const uint8_t *) write->buf + write->sent, len);
+        write->sent += len;
+
+        if (write->sent == write->size) {
+            stream->write_front = write->next;
+            if (stream->write_front == NULL) stream->write_back = NULL;
+            mx->batch_done_array[mx->batch_done_count++] = write;
+
+            // the END frame is already ahead of anything a reused slot could send
+            if (write->type == JFS_WP_END) {
+                stream->end_sent = true;
+                mx_maybe_close(mx, stream);
+                continue;
+            }
+        }
+        mx_mark_ready(mx, stream);
+    }
+}
+
+static void mx_batch_done(jfs_mx_t *mx) {
+    const size_t done_count = mx->batch_done_count;
+    mx->batch_done_count = 0;
+    if (mx->conf.on_done == NULL) return;
+
+    for (size_t i = 0; i < done_count; i++) {
+        mx->conf.on_done(mx, mx->batch_done_array[i], mx->conf.ctx);
+    }
+}
+
+static void mx_handle_frame(jfs_mx_t *mx, jfs_err_t *err) {
+    const jfs_wp_header_t *header = &mx->header;
+    const uint32_t         slot = header->stream_id % mx->slot_count;
+    mx_stream_t           *stream = &mx->stream_array[slot];
+    const bool             known = stream->open && stream->id == header->stream_id;
+
+    if (header->type == JFS_WP_HELLO) {
+        mx->conf.on_frame(mx, header->stream_id, JFS_WP_HELLO, mx->body, header->length, mx->conf.ctx);
+        return;
+    }
+
+    if (header->type == JFS_WP_WINDOW) {
+        uint64_t     increment = 0;
+        const size_t used = jfs_wp_varint_get(mx->body, header->length, &increment, err);
+        VOID_CHECK_ERR;
+        VOID_FAIL_IF(used != header->length, JFS_ERR_WP_BAD_FRAME);
+
+        // a grant can trail the END of a stream that has since closed, it is dropped
+        if (!known) return;
+        stream->send_credit += increment;
+        mx_mark_ready(mx, stream);
+        return;
+    }
+
+    if (!known) {
+        // a frame for a slot we do not hold opens a peer stream, anything else breaks the protocol
+        VOID_FAIL_IF(stream->open || mx_local_slot(mx, slot), JFS_ERR_WP_BAD_FRAME);
+        mx_stream_init(mx, stream, header->stream_id);
+    }
+    VOID_FAIL_IF(stream->end_recv, JFS_ERR_WP_BAD_FRAME);
+
+    if (header->type == JFS_WP_DATA) {
+        VOID_FAIL_IF(header->length > stream->recv_window, JFS_ERR_WP_BAD_FRAME);
+        stream->recv_window -= header->length;
+    }
+
+    mx->conf.on_frame(mx, header->stream_id, (jfs_wp_type_t) header->type, mx->body, header->length, mx->conf.ctx);
+
+    if (header->type == JFS_WP_END) {
+        stream->end_recv = true;
+        mx_maybe_close(mx, stream);
+    }
+}
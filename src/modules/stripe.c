@@ -0,0 +1,368 @@
+#include "stripe.h"
+#include "error.h"
+#include "net_socket.h"
+#include "wire_protocol.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define ST_DEFAULT_MIN_CONNS  2
+#define ST_DEFAULT_MAX_CONNS  16
+#define ST_DEFAULT_CHUNK_SIZE (8 * 1024 * 1024)
+#define ST_DEFAULT_SAMPLE_MS  250
+#define ST_PIECE_SIZE         (256 * 1024) // a chunk goes out in frames this big, so progress shows up mid chunk
+#define ST_OFFSET_SIZE        8
+#define ST_SAMPLE_RTTS        4   // a window spans at least this many round trips
+#define ST_GAIN_PERCENT       110 // a change has to buy this much to keep going the same way
+#define ST_LOSS_PERCENT       90  // a window this far down undoes the last change or drops a connection
+#define ST_PROBE_WINDOWS      8   // flat windows before trying one more connection again
+#define ST_POLL_MS            10
+#define ST_US_PER_MS          1000
+#define ST_NS_PER_MS          1000000
+#define ST_NS_PER_SEC         1000000000
+
+typedef struct st_sender st_sender_t;
+
+struct st_sender {
+    jfs_st_conf_t         conf;
+    atomic_uint_least64_t next_offset; // next unclaimed range
+    atomic_uint_least64_t sent;        // advances per piece, not per chunk
+    atomic_uint_least32_t rtt_us;      // latest smoothed rtt from any connection
+    atomic_bool           failed;
+    pthread_mutex_t       lock;   // guards err, target and active_count
+    pthread_cond_t        resume; // parked connections wait here for the target to grow
+    jfs_err_t             err;
+    uint32_t              target;       // connections that should be sending
+    uint32_t              active_count; // connections not parked
+    uint32_t              thread_count; // connections opened, only touched by the controller
+    pthread_t            *thread_array;
+};
+
+static void    *st_send_conn(void *arg);
+static void     st_send_ranges(st_sender_t *sender, const jfs_ns_socket_t *sock, jfs_err_t *err);
+static void     st_set_target(st_sender_t *sender, uint32_t target, jfs_err_t *err);
+static int32_t  st_next_step(uint64_t rate, uint64_t last_rate, int32_t step, uint32_t *hold_count) WUR;
+static bool     st_take_turn(st_sender_t *sender) WUR;
+static bool     st_done(st_sender_t *sender) WUR;
+static void     st_fail(st_sender_t *sender, jfs_err_t err);
+static uint64_t st_now_ns(void) WUR;
+static void     st_sleep_ms(uint32_t ms);
+static void     st_put_u64(uint8_t *ptr, uint64_t val);
+static uint64_t st_get_u64(const uint8_t *ptr) WUR;
+
+void jfs_st_send(const jfs_st_conf_t *conf, jfs_st_stats_t *stats_out, jfs_err_t *err) {
+    st_sender_t sender = {0};
+    sender.conf = *conf;
+    if (sender.conf.min_conns == 0) sender.conf.min_conns = ST_DEFAULT_MIN_CONNS;
+    if (sender.conf.max_conns == 0) sender.conf.max_conns = ST_DEFAULT_MAX_CONNS;
+    if (sender.conf.chunk_size == 0) sender.conf.chunk_size = ST_DEFAULT_CHUNK_SIZE;
+    if (sender.conf.sample_ms == 0) sender.conf.sample_ms = ST_DEFAULT_SAMPLE_MS;
+    VOID_FAIL_IF(sender.conf.min_conns > sender.conf.max_conns, JFS_ERR_BAD_CONF);
+    VOID_FAIL_IF(sender.conf.chunk_size > UINT32_MAX - ST_OFFSET_SIZE, JFS_ERR_BAD_CONF);
+
+    atomic_init(&sender.next_offset, 0);
+    atomic_init(&sender.sent, 0);
+    atomic_init(&sender.rtt_us, 0);
+    atomic_init(&sender.failed, false);
+    sender.err = JFS_OK;
+
+    sender.thread_array = jfs_malloc(sizeof(*sender.thread_array) * sender.conf.max_conns, err);
+    VOID_CHECK_ERR;
+    jfs_mutex_init(&sender.lock, NULL, err);
+    GOTO_IF_ERR(cleanup_threads);
+    jfs_cond_init(&sender.resume, NULL, err);
+    GOTO_IF_ERR(cleanup_lock);
+
+    const uint64_t start_ns = st_now_ns();
+    for (uint32_t i = 0; i < sender.conf.min_conns && !st_done(&sender); i++) {
+        st_set_target(&sender, i + 1, err);
+        if (*err != JFS_OK) RES_ERR;
+    }
+
+    // every connection pulls the next chunk when it is free, so fast paths take more of the file
+    uint64_t window_ns = st_now_ns();
+    uint64_t window_sent = 0;
+    uint64_t last_rate = 0; // bytes per ms, zero until a window has been measured
+    int32_t  step = 0;      // direction of the last change, zero once it was undone
+    uint32_t hold_count = 0;
+    bool     settling = false;
+    while (!st_done(&sender)) {
+        // a window shorter than a few round trips mostly measures slow start and ack timing
+        const uint64_t rtt_ms = atomic_load(&sender.rtt_us) / ST_US_PER_MS;
+        const uint64_t window_ms = rtt_ms * ST_SAMPLE_RTTS > sender.conf.sample_ms ? rtt_ms * ST_SAMPLE_RTTS : sender.conf.sample_ms;
+        while (!st_done(&sender) && st_now_ns() - window_ns < window_ms * ST_NS_PER_MS) {
+            st_sleep_ms(ST_POLL_MS);
+        }
+
+        const uint64_t now_ns = st_now_ns();
+        const uint64_t now_sent = atomic_load(&sender.sent);
+        const uint64_t elapsed_ms = (now_ns - window_ns) / ST_NS_PER_MS;
+        const uint64_t rate = (now_sent - window_sent) / (elapsed_ms > 0 ? elapsed_ms : 1);
+        window_ns = now_ns;
+        window_sent = now_sent;
+
+        // the window right after a change still has the new connection ramping up, an empty one says nothing
+        if (settling || rate == 0) {
+            settling = false;
+            continue;
+        }
+
+        const int32_t next = st_next_step(rate, last_rate, step, &hold_count);
+        last_rate = rate;
+        if (next == 0) continue;
+
+        const int64_t  wanted = (int64_t) sender.target + next;
+        const uint32_t target = wanted < sender.conf.min_conns ? sender.conf.min_conns : wanted > sender.conf.max_conns ? sender.conf.max_conns : (uint32_t) wanted;
+        if (target == sender.target) continue;
+
+        st_set_target(&sender, target, err);
+        if (*err != JFS_OK) RES_ERR;
+        // an undone change is not followed up, the count holds until the next probe
+        step = next == -step ? 0 : next;
+        settling = true;
+    }
+
+    // parked connections still have to send their END
+    pthread_mutex_lock(&sender.lock);
+    pthread_cond_broadcast(&sender.resume);
+    pthread_mutex_unlock(&sender.lock);
+    for (uint32_t i = 0; i < sender.thread_count; i++) {
+        pthread_join(sender.thread_array[i], NULL);
+    }
+
+    if (stats_out != NULL) {
+        *stats_out = (jfs_st_stats_t) {
+            .conn_count = sender.thread_count,
+            .sent = atomic_load(&sender.sent),
+            .elapsed_ns = st_now_ns() - start_ns,
+        };
+    }
+
+    *err = sender.err;
+    pthread_cond_destroy(&sender.resume);
+cleanup_lock:
+    pthread_mutex_destroy(&sender.lock);
+cleanup_threads:
+    free(sender.thread_array);
+    VOID_CHECK_ERR;
+}
+
+void jfs_st_recv_hello(const jfs_ns_socket_t *sock, jfs_st_hello_t *hello_out, jfs_err_t *err) {
+    jfs_wp_header_t      header;
+    jfs_wp_meta_reader_t reader;
+    uint8_t              body[JFS_WP_META_CAPACITY];
+
+    jfs_wp_recv_header(sock, &header, err);
+    VOID_CHECK_ERR;
+    VOID_FAIL_IF(header.type != JFS_WP_HELLO || header.length > sizeof(body), JFS_ERR_WP_BAD_FRAME);
+
+    (void) jfs_ns_socket_recv(sock, body, header.length, err);
+    VOID_CHECK_ERR;
+
+    jfs_wp_meta_reader_init(&reader, body, header.length);
+    const uint64_t size = jfs_wp_meta_get_uint(&reader, err);
+    VOID_CHECK_ERR;
+
+    hello_out->transfer_id = header.stream_id;
+    hello_out->size = size;
+}
+
+size_t jfs_st_recv_ranges(const jfs_ns_socket_t *sock, jfs_ns_splice_t *splice, int file_fd, uint64_t size, jfs_err_t *err) {
+    size_t total_received = 0;
+
+    for (;;) {
+        jfs_wp_header_t header;
+        jfs_wp_recv_header(sock, &header, err);
+        VAL_CHECK_ERR(total_received);
+        if (header.type == JFS_WP_END) break;
+        VAL_FAIL_IF(header.type != JFS_WP_DATA || header.length < ST_OFFSET_SIZE, JFS_ERR_WP_BAD_FRAME, total_received);
+
+        uint8_t offset_buf[ST_OFFSET_SIZE];
+        (void) jfs_ns_socket_recv(sock, offset_buf, sizeof(offset_buf), err);
+        VAL_CHECK_ERR(total_received);
+
+        // ranges land at their own offset, so connections finish in any order
+        const uint64_t offset = st_get_u64(offset_buf);
+        const size_t   range_size = header.length - ST_OFFSET_SIZE;
+        VAL_FAIL_IF(offset > size || range_size > size - offset, JFS_ERR_WP_BAD_FRAME, total_received);
+
+        total_received += jfs_ns_socket_recv_file(sock, splice, file_fd, (off_t) offset, range_size, err);
+        VAL_CHECK_ERR(total_received);
+    }
+
+    return total_received;
+}
+
+static void *st_send_conn(void *arg) {
+    st_sender_t *sender = (st_sender_t *) arg;
+    jfs_err_t    err_val = JFS_OK;
+    jfs_err_t   *err = &err_val;
+
+    jfs_ns_socket_t *sock = jfs_ns_socket_create(err);
+    GOTO_IF_ERR(cleanup);
+
+    jfs_ns_socket_set_ip(sock, sender->conf.server_port, sender->conf.server_ip, err);
+    GOTO_IF_ERR(cleanup);
+
+    jfs_ns_socket_open(sock, err);
+    GOTO_IF_ERR(cleanup);
+
+    jfs_ns_socket_connect(sock, err);
+    GOTO_IF_ERR(cleanup);
+
+    st_send_ranges(sender, sock, err);
+    GOTO_IF_ERR(cleanup);
+
+    jfs_ns_socket_destroy(&sock);
+    return NULL;
+cleanup:
+    st_fail(sender, *err);
+    jfs_ns_socket_destroy(&sock);
+    return NULL;
+}
+
+static void st_send_ranges(st_sender_t *sender, const jfs_ns_socket_t *sock, jfs_err_t *err) {
+    jfs_wp_meta_t  meta;
+    jfs_wp_frame_t frame;
+    jfs_ns_tune_t  tune;
+
+    jfs_ns_tune_init(&tune, 0);
+    jfs_ns_socket_set_phase(sock, JFS_NS_PHASE_META, err);
+    VOID_CHECK_ERR;
+
+    jfs_wp_meta_init(&meta);
+    jfs_wp_meta_put_uint(&meta, sender->conf.size, err);
+    VOID_CHECK_ERR;
+    jfs_wp_frame_init(&frame, JFS_WP_HELLO, sender->conf.transfer_id, 0);
+    jfs_wp_frame_add(&frame, meta.buf, meta.len, err);
+    VOID_CHECK_ERR;
+    jfs_wp_frame_send(&frame, sock, err);
+    VOID_CHECK_ERR;
+
+    jfs_ns_socket_set_phase(sock, JFS_NS_PHASE_BULK, err);
+    VOID_CHECK_ERR;
+    while (st_take_turn(sender)) {
+        const uint64_t offset = atomic_fetch_add(&sender->next_offset, sender->conf.chunk_size);
+        if (offset >= sender->conf.size) break;
+
+        const uint64_t range_end = sender->conf.size - offset < sender->conf.chunk_size ? sender->conf.size : offset + sender->conf.chunk_size;
+        for (uint64_t piece = offset; piece < range_end; piece += ST_PIECE_SIZE) {
+            const uint64_t piece_size = range_end - piece < ST_PIECE_SIZE ? range_end - piece : ST_PIECE_SIZE;
+            uint8_t        offset_buf[ST_OFFSET_SIZE];
+            st_put_u64(offset_buf, piece);
+
+            jfs_wp_frame_init(&frame, JFS_WP_DATA, sender->conf.transfer_id, 0);
+            jfs_wp_frame_add(&frame, offset_buf, sizeof(offset_buf), err);
+            VOID_CHECK_ERR;
+            jfs_wp_frame_send_file(&frame, sock, sender->conf.file_fd, (off_t) piece, (size_t) piece_size, err);
+            VOID_CHECK_ERR;
+
+            atomic_fetch_add(&sender->sent, piece_size);
+        }
+
+        jfs_ns_socket_tune(sock, &tune, err);
+        VOID_CHECK_ERR;
+        if (tune.info.rtt_us != 0) atomic_store(&sender->rtt_us, tune.info.rtt_us);
+    }
+
+    jfs_ns_socket_set_phase(sock, JFS_NS_PHASE_META, err);
+    VOID_CHECK_ERR;
+    jfs_wp_frame_init(&frame, JFS_WP_END, sender->conf.transfer_id, 0);
+    jfs_wp_frame_send(&frame, sock, err);
+    VOID_CHECK_ERR;
+    jfs_ns_socket_shutdown(sock, err);
+    VOID_CHECK_ERR;
+
+    // the receiver closes once its last range is in the file, that is the only acknowledgement
+    jfs_ns_socket_wait_close(sock, err);
+    VOID_CHECK_ERR;
+}
+
+static void st_set_target(st_sender_t *sender, uint32_t target, jfs_err_t *err) {
+    pthread_mutex_lock(&sender->lock);
+    sender->target = target;
+    // parked connections are woken first, a new one is only opened once none is left
+    const bool open_conn = target > sender->thread_count;
+    if (open_conn) sender->active_count += 1;
+    pthread_cond_broadcast(&sender->resume);
+    pthread_mutex_unlock(&sender->lock);
+    if (!open_conn) return;
+
+    jfs_pthread_create(&sender->thread_array[sender->thread_count], NULL, st_send_conn, sender, err);
+    if (*err != JFS_OK) {
+        st_fail(sender, *err);
+        VOID_RETURN_ERR;
+    }
+    sender->thread_count += 1;
+}
+
+static int32_t st_next_step(uint64_t rate, uint64_t last_rate, int32_t step, uint32_t *hold_count) {
+    if (last_rate == 0) return 1;
+
+    // climb while each change pays, back off when throughput drops, probe upward again after a flat stretch
+    if (rate * 100 >= last_rate * ST_GAIN_PERCENT) {
+        *hold_count = 0;
+        return step;
+    }
+    if (rate * 100 < last_rate * ST_LOSS_PERCENT) {
+        *hold_count = 0;
+        return step != 0 ? -step : -1;
+    }
+    if (++*hold_count < ST_PROBE_WINDOWS) return 0;
+    *hold_count = 0;
+    return 1;
+}
+
+static bool st_take_turn(st_sender_t *sender) {
+    // connections past the target park between chunks, still connected for when the count grows again
+    pthread_mutex_lock(&sender->lock);
+    while (sender->active_count > sender->target && !st_done(sender)) {
+        sender->active_count -= 1;
+        pthread_cond_wait(&sender->resume, &sender->lock);
+        sender->active_count += 1;
+    }
+    pthread_mutex_unlock(&sender->lock);
+    return !st_done(sender);
+}
+
+static bool st_done(st_sender_t *sender) {
+    return atomic_load(&sender->failed) || atomic_load(&sender->next_offset) >= sender->conf.size;
+}
+
+static void st_fail(st_sender_t *sender, jfs_err_t err) {
+    pthread_mutex_lock(&sender->lock);
+    if (sender->err == JFS_OK) sender->err = err;
+    pthread_mutex_unlock(&sender->lock);
+    atomic_store(&sender->failed, true);
+}
+
+static uint64_t st_now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * ST_NS_PER_SEC + (uint64_t) now.tv_nsec;
+}
+
+static void st_sleep_ms(uint32_t ms) {
+    struct timespec delay = {
+        .tv_sec = ms / 1000,                          // NOLINT
+        .tv_nsec = (long) (ms % 1000) * ST_NS_PER_MS, // NOLINT
+    };
+    while (nanosleep(&delay, &delay) == -1 && errno == EINTR) {}
+}
+
+static void st_put_u64(uint8_t *ptr, uint64_t val) {
+    for (size_t i = 0; i < 8; i++) {
+        ptr[i] = (uint8_t) (val >> (i * 8)); // NOLINT
+    }
+}
+
+static uint64_t st_get_u64(const uint8_t *ptr) {
+    uint64_t val = 0;
+    for (size_t i = 0; i < 8; i++) {
+        val |= (uint64_t) ptr[i] << (i * 8); // NOLINT
+    }
+    return val;
+}
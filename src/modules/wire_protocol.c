@@ -0,0 +1,200 @@
+#include "wire_protocol.h"
+#include "error.h"
+#include "net_socket.h"
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#define WP_VARINT_MASK 0x7FU
+#define WP_VARINT_MORE 0x80U
+
+static void     wp_put_u16(uint8_t *ptr, uint16_t val);
+static void     wp_put_u32(uint8_t *ptr, uint32_t val);
+static uint16_t wp_get_u16(const uint8_t *ptr) WUR;
+static uint32_t wp_get_u32(const uint8_t *ptr) WUR;
+
+void jfs_wp_header_pack(const jfs_wp_header_t *header, uint8_t *buf) {
+    buf[0] = header->version;
+    buf[1] = header->type;
+    wp_put_u16(buf + 2, header->flags);
+    wp_put_u32(buf + 4, header->stream_id); // NOLINT
+    wp_put_u32(buf + 8, header->length);    // NOLINT
+}
+
+void jfs_wp_header_unpack(jfs_wp_header_t *header_out, const uint8_t *buf, jfs_err_t *err) {
+    VOID_FAIL_IF(buf[0] != JFS_WP_VERSION, JFS_ERR_WP_BAD_FRAME);
+    VOID_FAIL_IF(buf[1] < JFS_WP_HELLO || buf[1] > JFS_WP_WINDOW, JFS_ERR_WP_BAD_FRAME);
+
+    header_out->version = buf[0];
+    header_out->type = buf[1];
+    header_out->flags = wp_get_u16(buf + 2);
+    header_out->stream_id = wp_get_u32(buf + 4); // NOLINT
+    header_out->length = wp_get_u32(buf + 8);    // NOLINT
+}
+
+void jfs_wp_recv_header(const jfs_ns_socket_t *sock, jfs_wp_header_t *header_out, jfs_err_t *err) {
+    uint8_t buf[JFS_WP_HEADER_SIZE];
+    (void) jfs_ns_socket_recv(sock, buf, sizeof(buf), err);
+    VOID_CHECK_ERR;
+
+    jfs_wp_header_unpack(header_out, buf, err);
+    VOID_CHECK_ERR;
+}
+
+void jfs_wp_frame_init(jfs_wp_frame_t *frame_init, jfs_wp_type_t type, uint32_t stream_id, uint16_t flags) {
+    frame_init->header = (jfs_wp_header_t) {
+        .version = JFS_WP_VERSION,
+        .type = (uint8_t) type,
+        .flags = flags,
+        .stream_id = stream_id,
+        .length = 0,
+    };
+    frame_init->iov_array[0].iov_base = frame_init->header_buf;
+    frame_init->iov_array[0].iov_len = JFS_WP_HEADER_SIZE;
+    frame_init->iov_count = 1;
+}
+
+void jfs_wp_frame_add(jfs_wp_frame_t *frame, const void *buf, size_t size, jfs_err_t *err) {
+    VOID_FAIL_IF(frame->iov_count > JFS_WP_MAX_IOV, JFS_ERR_FULL);
+    VOID_FAIL_IF(size > UINT32_MAX - frame->header.length, JFS_ERR_ARG);
+    if (size == 0) return;
+
+    // the iovec only borrows buf, sendmsg gathers it straight from caller memory
+    frame->iov_array[frame->iov_count].iov_base = (void *) buf;
+    frame->iov_array[frame->iov_count].iov_len = size;
+    frame->iov_count += 1;
+    frame->header.length += (uint32_t) size;
+}
+
+void jfs_wp_frame_send(jfs_wp_frame_t *frame, const jfs_ns_socket_t *sock, jfs_err_t *err) {
+    jfs_wp_header_pack(&frame->header, frame->header_buf);
+
+    (void) jfs_ns_socket_sendv(sock, frame->iov_array, frame->iov_count, 0, err);
+    VOID_CHECK_ERR;
+}
+
+void jfs_wp_frame_send_file(jfs_wp_frame_t *frame, const jfs_ns_socket_t *sock, int file_fd, off_t offset, size_t size, jfs_err_t *err) {
+    VOID_FAIL_IF(size > UINT32_MAX - frame->header.length, JFS_ERR_ARG);
+    frame->header.length += (uint32_t) size;
+    jfs_wp_header_pack(&frame->header, frame->header_buf);
+
+    // MSG_MORE holds the header back so it leaves in the same segments as the start of the file data
+    (void) jfs_ns_socket_sendv(sock, frame->iov_array, frame->iov_count, MSG_MORE, err);
+    VOID_CHECK_ERR;
+
+    (void) jfs_ns_socket_sendfile(sock, file_fd, offset, size, err);
+    VOID_CHECK_ERR;
+}
+
+void jfs_wp_frame_cursor(jfs_wp_frame_t *frame, jfs_ns_write_cursor_t *cursor_init) {
+    jfs_wp_header_pack(&frame->header, frame->header_buf);
+    jfs_ns_write_cursor_init(cursor_init, frame->iov_array, frame->iov_count);
+}
+
+size_t jfs_wp_varint_put(uint8_t *buf, uint64_t val) {
+    size_t len = 0;
+    while (val > WP_VARINT_MASK) {
+        buf[len++] = (uint8_t) ((val & WP_VARINT_MASK) | WP_VARINT_MORE);
+        val >>= 7; // NOLINT
+    }
+    buf[len++] = (uint8_t) val;
+    return len;
+}
+
+size_t jfs_wp_varint_get(const uint8_t *buf, size_t len, uint64_t *val_out, jfs_err_t *err) {
+    uint64_t val = 0;
+
+    for (size_t i = 0; i < len && i < JFS_WP_VARINT_MAX; i++) {
+        // the tenth byte only has room for bit 63, anything more would be shifted out
+        VAL_FAIL_IF(i == JFS_WP_VARINT_MAX - 1 && buf[i] > 1, JFS_ERR_WP_BAD_FRAME, 0);
+        val |= (uint64_t) (buf[i] & WP_VARINT_MASK) << (i * 7); // NOLINT
+        if ((buf[i] & WP_VARINT_MORE) == 0) {
+            *val_out = val;
+            return i + 1;
+        }
+    }
+
+    // ran out of bytes or past ten continuation bytes
+    *err = JFS_ERR_WP_BAD_FRAME;
+    VAL_RETURN_ERR(0);
+}
+
+void jfs_wp_meta_init(jfs_wp_meta_t *meta_init) {
+    meta_init->len = 0;
+}
+
+void jfs_wp_meta_put_uint(jfs_wp_meta_t *meta, uint64_t val, jfs_err_t *err) {
+    VOID_FAIL_IF(JFS_WP_META_CAPACITY - meta->len < JFS_WP_VARINT_MAX, JFS_ERR_FULL);
+    meta->len += jfs_wp_varint_put(meta->buf + meta->len, val);
+}
+
+void jfs_wp_meta_put_int(jfs_wp_meta_t *meta, int64_t val, jfs_err_t *err) {
+    // zigzag keeps small negative values short
+    const uint64_t zigzag = ((uint64_t) val << 1) ^ (uint64_t) (val >> 63); // NOLINT
+    jfs_wp_meta_put_uint(meta, zigzag, err);
+    VOID_CHECK_ERR;
+}
+
+void jfs_wp_meta_put_bytes(jfs_wp_meta_t *meta, const void *buf, size_t size, jfs_err_t *err) {
+    VOID_FAIL_IF(size > JFS_WP_META_CAPACITY || JFS_WP_META_CAPACITY - meta->len < JFS_WP_VARINT_MAX + size, JFS_ERR_FULL);
+
+    meta->len += jfs_wp_varint_put(meta->buf + meta->len, size);
+    memcpy(meta->buf + meta->len, buf, size);
+    meta->len += size;
+}
+
+void jfs_wp_meta_reader_init(jfs_wp_meta_reader_t *reader_init, const uint8_t *buf, size_t len) {
+    reader_init->buf = buf;
+    reader_init->len = len;
+    reader_init->cursor = 0;
+}
+
+uint64_t jfs_wp_meta_get_uint(jfs_wp_meta_reader_t *reader, jfs_err_t *err) {
+    uint64_t     val = 0;
+    const size_t read = jfs_wp_varint_get(reader->buf + reader->cursor, reader->len - reader->cursor, &val, err);
+    VAL_CHECK_ERR(0);
+
+    reader->cursor += read;
+    return val;
+}
+
+int64_t jfs_wp_meta_get_int(jfs_wp_meta_reader_t *reader, jfs_err_t *err) {
+    const uint64_t zigzag = jfs_wp_meta_get_uint(reader, err);
+    VAL_CHECK_ERR(0);
+
+    return (int64_t) (zigzag >> 1) ^ -(int64_t) (zigzag & 1);
+}
+
+const uint8_t *jfs_wp_meta_get_bytes(jfs_wp_meta_reader_t *reader, size_t *size_out, jfs_err_t *err) {
+    const uint64_t size = jfs_wp_meta_get_uint(reader, err);
+    NULL_CHECK_ERR;
+    NULL_FAIL_IF(size > reader->len - reader->cursor, JFS_ERR_WP_BAD_FRAME);
+
+    const uint8_t *bytes = reader->buf + reader->cursor;
+    reader->cursor += (size_t) size;
+    *size_out = (size_t) size;
+    return bytes;
+}
+
+static void wp_put_u16(uint8_t *ptr, uint16_t val) {
+    ptr[0] = (uint8_t) val;
+    ptr[1] = (uint8_t) (val >> 8); // NOLINT
+}
+
+static void wp_put_u32(uint8_t *ptr, uint32_t val) {
+    for (size_t i = 0; i < 4; i++) {
+        ptr[i] = (uint8_t) (val >> (i * 8)); // NOLINT
+    }
+}
+
+static uint16_t wp_get_u16(const uint8_t *ptr) {
+    return (uint16_t) (ptr[0] | (ptr[1] << 8)); // NOLINT
+}
+
+static uint32_t wp_get_u32(const uint8_t *ptr) {
+    uint32_t val = 0;
+    for (size_t i = 0; i < 4; i++) {
+        val |= (uint32_t) ptr[i] << (i * 8); // NOLINT
+    }
+    return val;
+}
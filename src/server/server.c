@@ -1,11 +1,59 @@
 #include "error.h"
 #include "net_socket.h"
+#include "wire_protocol.h"
 #include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
-#define SERV_PORT 20727
+#define SERV_PORT         20727
+#define SERV_LOCAL_PATH   "@jfs-server" // abstract unix socket, nothing to clean up on exit
+#define SERV_THREAD_COUNT 4
+#define SERV_IDLE_MS      30000
+#define SERV_BACKOFF_MS   100 // accept retry after running out of fds or buffers
+#define SERV_FREE_MAX     64  // closed sessions kept per worker for reuse
+
+typedef struct session session_t;
+typedef struct worker  worker_t;
+
+// one per connection, only ever touched by the worker that accepted it
+struct session {
+    jfs_ns_socket_t      *sock;
+    worker_t             *worker;
+    session_t            *prev;
+    session_t            *next;
+    uint64_t              idle_timer;
+    bool                  replied;
+    bool                  sending;
+    bool                  in_body;
+    jfs_ns_read_cursor_t  read_cursor;
+    jfs_ns_write_cursor_t write_cursor;
+    jfs_wp_header_t       header;
+    uint8_t               header_buf[JFS_WP_HEADER_SIZE];
+    uint8_t               body[JFS_WP_META_CAPACITY];
+    jfs_wp_meta_t         reply_meta;
+    jfs_wp_frame_t        reply_frame;
+};
+
+// one reactor, listener and session free list per thread, nothing is shared between workers
+struct worker {
+    pthread_t         thread;
+    jfs_ns_reactor_t *reactor;
+    jfs_ns_socket_t  *listener;
+    jfs_ns_socket_t  *local_listener; // first worker only, same-host clients skip the TCP stack
+    int               spare_fd;       // given up to accept and drop a connection once fds run out
+    uint64_t          backoff_timer;
+    session_t        *session_list;
+    size_t            session_count;
+    session_t        *free_list;
+    size_t            free_count;
+};
+
+void listener_on_backoff(jfs_ns_reactor_t *reactor, void *ctx);
 
 struct test_data {
     int  a;
@@ -23,9 +71,107 @@ void print_test_data(const struct test_data *data) {
     printf("}\n");
 }
 
-void run(jfs_err_t *err) { // NOLINT
-    jfs_ns_socket_t *client;
-    jfs_ns_socket_t *server;
+void build_test_data(jfs_wp_meta_t *meta, jfs_wp_frame_t *frame, const struct test_data *data, jfs_err_t *err) {
+    jfs_wp_meta_init(meta);
+    jfs_wp_meta_put_int(meta, data->a, err);
+    VOID_CHECK_ERR;
+    jfs_wp_meta_put_int(meta, data->b, err);
+    VOID_CHECK_ERR;
+    jfs_wp_meta_put_int(meta, data->c, err);
+    VOID_CHECK_ERR;
+    jfs_wp_meta_put_bytes(meta, data->str, strnlen(data->str, sizeof(data->str)), err);
+    VOID_CHECK_ERR;
+
+    jfs_wp_frame_init(frame, JFS_WP_META, 0, 0);
+    jfs_wp_frame_add(frame, meta->buf, meta->len, err);
+    VOID_CHECK_ERR;
+}
+
+void parse_test_data(const uint8_t *body, size_t len, struct test_data *data_out, jfs_err_t *err) {
+    jfs_wp_meta_reader_t reader;
+    size_t               str_len = 0;
+
+    jfs_wp_meta_reader_init(&reader, body, len);
+    data_out->a = (int) jfs_wp_meta_get_int(&reader, err);
+    VOID_CHECK_ERR;
+    data_out->b = (int) jfs_wp_meta_get_int(&reader, err);
+    VOID_CHECK_ERR;
+    data_out->c = (int) jfs_wp_meta_get_int(&reader, err);
+    VOID_CHECK_ERR;
+    const uint8_t *str = jfs_wp_meta_get_bytes(&reader, &str_len, err);
+    VOID_CHECK_ERR;
+    VOID_FAIL_IF(str_len >= sizeof(data_out->str), JFS_ERR_WP_BAD_FRAME);
+
+    memcpy(data_out->str, str, str_len);
+    data_out->str[str_len] = '\0';
+}
+
+session_t *session_alloc(worker_t *worker, jfs_err_t *err) {
+    session_t *session = worker->free_list;
+    if (session != NULL) {
+        worker->free_list = session->next;
+        worker->free_count -= 1;
+        return session;
+    }
+
+    session = jfs_malloc(sizeof(*session), err);
+    NULL_CHECK_ERR;
+    return session;
+}
+
+void session_release(worker_t *worker, session_t *session) {
+    if (worker->free_count == SERV_FREE_MAX) {
+        free(session);
+        return;
+    }
+    session->next = worker->free_list;
+    worker->free_list = session;
+    worker->free_count += 1;
+}
+
+void session_close(session_t *session) {
+    worker_t *worker = session->worker;
+    jfs_err_t err_val = JFS_OK;
+    jfs_err_t *err = &err_val;
+
+    jfs_ns_reactor_timer_cancel(worker->reactor, session->idle_timer);
+    jfs_ns_reactor_remove(worker->reactor, session->sock, err);
+    if (*err != JFS_OK) RES_ERR;
+    jfs_ns_socket_destroy(&session->sock);
+
+    if (session->prev == NULL) {
+        worker->session_list = session->next;
+    } else {
+        session->prev->next = session->next;
+    }
+    if (session->next != NULL) session->next->prev = session->prev;
+    worker->session_count -= 1;
+
+    session_release(worker, session);
+}
+
+void session_on_idle(jfs_ns_reactor_t *reactor, void *ctx) {
+    (void) reactor;
+    session_t *session = (session_t *) ctx;
+
+    printf("idle shutdown\n");
+    session->idle_timer = 0;
+    session_close(session);
+}
+
+void session_write(session_t *session, jfs_err_t *err) {
+    if (!session->sending) return;
+
+    jfs_ns_write_cursor_send(session->sock, &session->write_cursor, 0, err);
+    if (*err == JFS_ERR_AGAIN) return;
+    VOID_CHECK_ERR;
+
+    session->sending = false;
+    jfs_ns_socket_shutdown(session->sock, err);
+    VOID_CHECK_ERR;
+}
+
+void session_on_frame(session_t *session, jfs_err_t *err) {
     struct test_data recv_data = {0};
     struct test_data send_data = {
         .a = 85, // NOLINT
@@ -34,59 +180,298 @@ void run(jfs_err_t *err) { // NOLINT
         .str = "uma musume: pretty derby",
     };
 
-    server = jfs_ns_socket_create(err);
-    GOTO_IF_ERR(cleanup);
+    parse_test_data(session->body, session->header.length, &recv_data, err);
+    VOID_CHECK_ERR;
+    print_test_data(&recv_data);
 
-    jfs_ns_socket_open(server, err);
-    GOTO_IF_ERR(cleanup);
+    if (!session->replied) {
+        build_test_data(&session->reply_meta, &session->reply_frame, &send_data, err);
+        VOID_CHECK_ERR;
+        jfs_wp_frame_cursor(&session->reply_frame, &session->write_cursor);
+        session->sending = true;
+        session->replied = true;
 
-    jfs_ns_socket_set_ip(server, SERV_PORT, "0.0.0.0", err);
-    GOTO_IF_ERR(cleanup);
+        // a full send buffer leaves the rest to the next write event, reading carries on meanwhile
+        session_write(session, err);
+        if (*err == JFS_ERR_AGAIN) IGNORE_ERR;
+        VOID_CHECK_ERR;
+    }
 
-    jfs_ns_socket_bind(server, err);
-    GOTO_IF_ERR(cleanup);
+    worker_t *worker = session->worker;
+    jfs_ns_reactor_timer_cancel(worker->reactor, session->idle_timer);
+    session->idle_timer = jfs_ns_reactor_timer_add(worker->reactor, SERV_IDLE_MS, session_on_idle, session, err);
+    VOID_CHECK_ERR;
+}
 
-    jfs_ns_socket_listen(server, err);
-    GOTO_IF_ERR(cleanup);
+void session_read(session_t *session, jfs_err_t *err) {
+    // edge triggered, so keep reading frames until the socket runs dry
+    for (;;) {
+        jfs_ns_read_cursor_recv(session->sock, &session->read_cursor, err);
+        if (*err == JFS_ERR_AGAIN) return;
+        VOID_CHECK_ERR;
 
-    client = jfs_ns_socket_accept(server, err);
-    GOTO_IF_ERR(cleanup);
+        if (!session->in_body) {
+            jfs_wp_header_unpack(&session->header, session->header_buf, err);
+            VOID_CHECK_ERR;
+            VOID_FAIL_IF(session->header.type != JFS_WP_META || session->header.length > sizeof(session->body),
+                         JFS_ERR_WP_BAD_FRAME);
 
-    jfs_ns_socket_recv(client, &recv_data, sizeof(recv_data), err);
-    GOTO_IF_ERR(cleanup);
+            session->in_body = true;
+            jfs_ns_read_cursor_init(&session->read_cursor, session->body, session->header.length);
+            continue;
+        }
 
-    print_test_data(&recv_data);
+        session_on_frame(session, err);
+        VOID_CHECK_ERR;
 
-    jfs_ns_socket_send(client, &send_data, sizeof(send_data), 0, err);
-    GOTO_IF_ERR(cleanup);
+        session->in_body = false;
+        jfs_ns_read_cursor_init(&session->read_cursor, session->header_buf, JFS_WP_HEADER_SIZE);
+    }
+}
 
-    jfs_ns_socket_shutdown(client, err);
-    GOTO_IF_ERR(cleanup);
+void session_on_event(jfs_ns_reactor_t *reactor, jfs_ns_socket_t *sock, uint32_t events, void *ctx) {
+    (void) reactor;
+    (void) sock;
+    session_t *session = (session_t *) ctx;
+    jfs_err_t  err_val = JFS_OK;
+    jfs_err_t *err = &err_val;
+
+    if ((events & JFS_NS_EV_WRITE) != 0) {
+        session_write(session, err);
+        if (*err == JFS_ERR_AGAIN) IGNORE_ERR;
+        GOTO_IF_ERR(shutdown);
+    }
+
+    if ((events & (JFS_NS_EV_READ | JFS_NS_EV_HANGUP | JFS_NS_EV_ERROR)) == 0) return;
+
+    session_read(session, err);
+    if (*err == JFS_ERR_AGAIN) return;
+
+shutdown:
+    if (*err == JFS_ERR_NS_CONNECTION_CLOSE && !session->in_body && session->read_cursor.received == 0) {
+        printf("safe shutdown\n");
+    } else {
+        printf("unsafe shutdown\n");
+    }
+    session_close(session);
+}
+
+void listener_shed(worker_t *worker, const jfs_ns_socket_t *sock, jfs_err_t *err) {
+    if (worker->spare_fd == -1) return;
+
+    // a dropped client sees a close instead of waiting in the queue until it times out
+    close(worker->spare_fd);
+    worker->spare_fd = -1;
+    jfs_ns_socket_t *client = jfs_ns_socket_accept(sock, err);
+    if (*err == JFS_OK) jfs_ns_socket_destroy(&client);
+    IGNORE_ERR;
+
+    worker->spare_fd = jfs_open("/dev/null", O_RDONLY | O_CLOEXEC, 0, err);
+    VOID_CHECK_ERR;
+}
+
+void listener_accept(worker_t *worker, const jfs_ns_socket_t *sock) {
+    jfs_err_t  err_val = JFS_OK;
+    jfs_err_t *err = &err_val;
+
+    for (;;) {
+        jfs_ns_socket_t *client = jfs_ns_socket_accept(sock, err);
+        if (*err == JFS_ERR_AGAIN) return;
+        // these already took the failed connection off the queue
+        if (*err == JFS_ERR_CONNECTION_ABORT || *err == JFS_ERR_NS_BAD_ACCEPT) {
+            RES_ERR;
+            continue;
+        }
+        if (*err != JFS_OK) {
+            // the connection stays queued, retrying now would spin until an fd or buffer frees up
+            const bool full = *err == JFS_ERR_FULL;
+            RES_ERR;
+            if (full) listener_shed(worker, sock, err);
+            if (*err != JFS_OK) RES_ERR;
+            if (worker->backoff_timer == 0) {
+                worker->backoff_timer = jfs_ns_reactor_timer_add(worker->reactor, SERV_BACKOFF_MS, listener_on_backoff, worker, err);
+                if (*err != JFS_OK) RES_ERR;
+            }
+            return;
+        }
 
-    while (1) {
-        jfs_ns_socket_recv(client, &recv_data, sizeof(recv_data), err);
-        if (*err == JFS_ERR_NS_CONNECTION_CLOSE) {
-            printf("safe shutdown\n");
+        session_t *session = session_alloc(worker, err);
+        if (*err != JFS_OK) {
             RES_ERR;
-            break;
+            jfs_ns_socket_destroy(&client);
+            continue;
         }
+        memset(session, 0, sizeof(*session));
+        session->sock = client;
+        session->worker = worker;
+        jfs_ns_read_cursor_init(&session->read_cursor, session->header_buf, JFS_WP_HEADER_SIZE);
 
+        jfs_ns_reactor_add(worker->reactor, client, session_on_event, session, err);
         if (*err != JFS_OK) {
-            printf("unsafe shutdown\n");
-            GOTO_IF_ERR(cleanup);
+            RES_ERR;
+            jfs_ns_socket_destroy(&client);
+            session_release(worker, session);
+            continue;
         }
-        print_test_data(&recv_data);
+
+        session->next = worker->session_list;
+        if (session->next != NULL) session->next->prev = session;
+        worker->session_list = session;
+        worker->session_count += 1;
+
+        session->idle_timer = jfs_ns_reactor_timer_add(worker->reactor, SERV_IDLE_MS, session_on_idle, session, err);
+        if (*err != JFS_OK) RES_ERR;
     }
+}
+
+void listener_on_backoff(jfs_ns_reactor_t *reactor, void *ctx) {
+    (void) reactor;
+    worker_t *worker = (worker_t *) ctx;
+
+    // edge triggered, so the queued connections never raise another event on their own
+    worker->backoff_timer = 0;
+    listener_accept(worker, worker->listener);
+    if (worker->local_listener != NULL) listener_accept(worker, worker->local_listener);
+}
+
+void listener_on_event(jfs_ns_reactor_t *reactor, jfs_ns_socket_t *sock, uint32_t events, void *ctx) {
+    (void) reactor;
+    worker_t *worker = (worker_t *) ctx;
+
+    if ((events & JFS_NS_EV_READ) == 0) return;
+    if (worker->backoff_timer != 0) return; // the timer retries every listener
+    listener_accept(worker, sock);
+}
 
-    jfs_ns_socket_close(client, err);
+void *worker_run(void *arg) {
+    worker_t  *worker = (worker_t *) arg;
+    jfs_err_t  err_val = JFS_OK;
+    jfs_err_t *err = &err_val;
+
+    jfs_ns_reactor_run(worker->reactor, err);
     if (*err != JFS_OK) RES_ERR;
-    jfs_ns_socket_destroy(&client);
-    jfs_ns_socket_destroy(&server);
+
+    while (worker->session_list != NULL) {
+        session_close(worker->session_list);
+    }
+    while (worker->free_list != NULL) {
+        session_t *session = worker->free_list;
+        worker->free_list = session->next;
+        free(session);
+    }
+    worker->free_count = 0;
+
+    return NULL;
+}
+
+jfs_ns_socket_t *listener_open(bool local, jfs_err_t *err) {
+    jfs_ns_socket_t *listener = jfs_ns_socket_create(err);
+    NULL_CHECK_ERR;
+
+    // "::" with dual stack takes IPv4 clients as well
+    if (local) {
+        jfs_ns_socket_set_unix(listener, SERV_LOCAL_PATH, err);
+    } else {
+        jfs_ns_socket_set_ip(listener, SERV_PORT, "::", err);
+    }
+    GOTO_IF_ERR(cleanup);
+
+    jfs_ns_socket_open(listener, err);
+    GOTO_IF_ERR(cleanup);
+
+    jfs_ns_socket_set_reuse_port(listener, err);
+    GOTO_IF_ERR(cleanup);
+
+    jfs_ns_socket_bind(listener, err);
+    GOTO_IF_ERR(cleanup);
+
+    jfs_ns_socket_listen(listener, err);
+    GOTO_IF_ERR(cleanup);
+
+    return listener;
+cleanup:
+    jfs_ns_socket_destroy(&listener);
+    NULL_RETURN_ERR;
+}
+
+void worker_open(worker_t *worker_init, bool local, jfs_err_t *err) {
+    worker_t worker = {.spare_fd = -1};
+
+    worker.spare_fd = jfs_open("/dev/null", O_RDONLY | O_CLOEXEC, 0, err);
+    VOID_CHECK_ERR;
+
+    worker.listener = listener_open(false, err);
+    GOTO_IF_ERR(cleanup_listener);
+
+    if (local) {
+        worker.local_listener = listener_open(true, err);
+        GOTO_IF_ERR(cleanup_listener);
+    }
+
+    worker.reactor = jfs_ns_reactor_create(err);
+    GOTO_IF_ERR(cleanup_listener);
+
+    *worker_init = worker;
+
+    // the callback context has to be the caller's copy, not the local one
+    jfs_ns_reactor_add(worker_init->reactor, worker_init->listener, listener_on_event, worker_init, err);
+    GOTO_IF_ERR(cleanup_reactor);
+
+    if (local) {
+        jfs_ns_reactor_add(worker_init->reactor, worker_init->local_listener, listener_on_event, worker_init, err);
+        GOTO_IF_ERR(cleanup_reactor);
+    }
+
+    return;
+cleanup_reactor:
+    jfs_ns_reactor_destroy(worker.reactor);
+cleanup_listener:
+    jfs_ns_socket_destroy(&worker.local_listener);
+    jfs_ns_socket_destroy(&worker.listener);
+    close(worker.spare_fd);
+    VOID_RETURN_ERR;
+}
+
+void worker_close(worker_t *worker_free) {
+    jfs_ns_reactor_destroy(worker_free->reactor);
+    jfs_ns_socket_destroy(&worker_free->local_listener);
+    jfs_ns_socket_destroy(&worker_free->listener);
+    if (worker_free->spare_fd != -1) close(worker_free->spare_fd);
+}
+
+void run(jfs_err_t *err) { // NOLINT
+    worker_t worker_array[SERV_THREAD_COUNT];
+    size_t   worker_count = 0;
+    size_t   started_count = 0;
+
+    for (; worker_count < SERV_THREAD_COUNT; worker_count++) {
+        worker_open(&worker_array[worker_count], worker_count == 0, err);
+        GOTO_IF_ERR(cleanup);
+    }
+
+    for (; started_count < worker_count; started_count++) {
+        worker_t *worker = &worker_array[started_count];
+        jfs_pthread_create(&worker->thread, NULL, worker_run, worker, err);
+        GOTO_IF_ERR(cleanup);
+    }
+    printf("listening with %d threads\n", SERV_THREAD_COUNT);
+
+    for (size_t i = 0; i < started_count; i++) {
+        pthread_join(worker_array[i].thread, NULL);
+    }
+    for (size_t i = 0; i < worker_count; i++) {
+        worker_close(&worker_array[i]);
+    }
 
     return;
 cleanup:
-    jfs_ns_socket_destroy(&server);
-    jfs_ns_socket_destroy(&client);
+    for (size_t i = 0; i < started_count; i++) {
+        jfs_ns_reactor_stop(worker_array[i].reactor);
+        pthread_join(worker_array[i].thread, NULL);
+    }
+    for (size_t i = 0; i < worker_count; i++) {
+        worker_close(&worker_array[i]);
+    }
     VOID_RETURN_ERR;
 }
 
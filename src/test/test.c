@@ -1,14 +1,26 @@
+#include "block_compress.h"
 #include "error.h"
+#include "file_io.h"
 #include "file_walk.h"
-#include "thread_safe_slab.h"
+#include "net_socket.h"
+#include "read_ahead.h"
+#include "stream_mux.h"
+#include "stripe.h"
+#include "wire_protocol.h"
 #include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <inttypes.h>
+#include <pthread.h>
 #include <stdalign.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
+#include <unistd.h>
 
 struct test_times {
     struct timespec start;
@@ -19,8 +31,17 @@ void start_time(struct test_times *times);
 void stop_time(struct test_times *times);
 void print_time(const struct test_times *times);
 void print_status(const char *test_name, jfs_err_t *err);
+jfs_ns_socket_t *test_listener(const char *unix_name, uint16_t port, jfs_err_t *err);
+void             test_socket_pair(const char *unix_name, uint16_t port, jfs_ns_socket_t **client_out, jfs_ns_socket_t **server_out, jfs_err_t *err);
 
 void file_walk_test(int verbose_flag, jfs_err_t *err);
+void block_compress_test(jfs_err_t *err);
+void block_compress_recv_test(jfs_err_t *err);
+void wire_protocol_test(jfs_err_t *err);
+void stream_mux_test(jfs_err_t *err);
+void zerocopy_test(jfs_err_t *err);
+void stripe_test(jfs_err_t *err);
+void read_ahead_destroy_test(jfs_err_t *err);
 
 void start_time(struct test_times *times) {
     clock_gettime(CLOCK_MONOTONIC, &times->start);
@@ -46,101 +67,63 @@ void print_status(const char *test_name, jfs_err_t *err) {
     }
 }
 
-#define NUMBER_OF_THING   1000000
-#define NUMBER_OF_THREADS 10
+// unix listener in the abstract namespace when unix_name is set, IPv4 loopback on port otherwise
+jfs_ns_socket_t *test_listener(const char *unix_name, uint16_t port, jfs_err_t *err) {
+    jfs_ns_socket_t *listener = jfs_ns_socket_create(err);
+    NULL_CHECK_ERR;
 
-struct thing {
-    pthread_t pt;
-};
-
-void *tss_test_thread_malloc(void *arg) {
-    (void) arg;
-    struct thing *array[NUMBER_OF_THING];
-    pthread_t     pt = pthread_self();
-    jfs_err_t     err = JFS_OK;
-
-    for (uint32_t i = 0; i < NUMBER_OF_THING; i++) {
-        array[i] = jfs_malloc(sizeof(struct thing), &err);
-        if (err != JFS_OK) {
-            printf("ERROR IN THREAD");
-            return NULL;
-        }
-        array[i]->pt = pt + i;
-    }
-
-    bool not_correct = false;
-    for (uint32_t i = 0; i < NUMBER_OF_THING; i++) {
-        not_correct = not_correct || !(array[i]->pt == pt + i);
-        free(array[i]);
-    }
-    if (not_correct) printf("the array was messed up ig\n");
-
-    return NULL;
-}
-
-void *tss_test_thread(void *arg) {
-    jfs_tss_cache_t cache = {0};
-    jfs_tss_cache_init(&cache, arg);
-    struct thing *array[NUMBER_OF_THING];
-
-    pthread_t pt = pthread_self();
-    jfs_err_t err = JFS_OK;
-
-    for (uint32_t i = 0; i < NUMBER_OF_THING; i++) {
-        array[i] = jfs_tss_alloc(&cache, &err);
-        if (err != JFS_OK) {
-            printf("ERROR IN THREAD");
-            return NULL;
-        }
-
-        array[i]->pt = pt + i;
+    if (unix_name != NULL) {
+        jfs_ns_socket_set_unix(listener, unix_name, err);
+    } else {
+        jfs_ns_socket_set_ip(listener, port, "127.0.0.1", err);
     }
-
-    bool not_correct = false;
-    for (uint32_t i = 0; i < NUMBER_OF_THING; i++) {
-        not_correct = not_correct || !(array[i]->pt == pt + i);
-        jfs_tss_free(&cache, array[i]);
+    GOTO_IF_ERR(cleanup);
+    jfs_ns_socket_open(listener, err);
+    GOTO_IF_ERR(cleanup);
+    if (unix_name == NULL) {
+        jfs_ns_socket_set_reuse_port(listener, err);
+        GOTO_IF_ERR(cleanup);
     }
-    if (not_correct) printf("the array was messed up ig\n");
-    jfs_tss_cache_full_release(&cache);
-
-    return NULL;
+    jfs_ns_socket_bind(listener, err);
+    GOTO_IF_ERR(cleanup);
+    jfs_ns_socket_listen(listener, err);
+    GOTO_IF_ERR(cleanup);
+    return listener;
+cleanup:
+    jfs_ns_socket_destroy(&listener);
+    NULL_RETURN_ERR;
 }
 
-void tss_test(jfs_err_t *err) {
-    struct test_times time = {0};
-
-    start_time(&time);
+// connected stream pair, the listener is gone once both ends exist
+void test_socket_pair(const char *unix_name, uint16_t port, jfs_ns_socket_t **client_out, jfs_ns_socket_t **server_out, jfs_err_t *err) {
+    jfs_ns_socket_t *listener = NULL;
+    jfs_ns_socket_t *client = NULL;
 
-    jfs_tss_allocator_config_t config = {
-        .cache_cap = 1028,                   // NOLINT
-        .cache_acquire_amount = 1028,               // NOLINT
-        .cache_release_amount = 1028,               // NOLINT
-        .obj_align = alignof(struct thing), // NOLINT
-        .obj_size = sizeof(struct thing),   // NOLINT
-        .pages_per_slab = 64,               // NOLINT
-        .retire_threshold = 8,              // NOLINT
-    };
-
-    jfs_tss_allocator_t *alloc = jfs_tss_allocator_create(&config, err);
+    listener = test_listener(unix_name, port, err);
     VOID_CHECK_ERR;
-    pthread_t threads[NUMBER_OF_THREADS];
-    for (uint32_t i = 0; i < NUMBER_OF_THREADS; i++) {
-        pthread_create(&threads[i], NULL, tss_test_thread, alloc);
-    }
 
-    for (uint32_t i = 0; i < NUMBER_OF_THREADS; i++) {
-        void *nothing = NULL;
-        pthread_join(threads[i], &nothing);
+    client = jfs_ns_socket_create(err);
+    GOTO_IF_ERR(cleanup);
+    if (unix_name != NULL) {
+        jfs_ns_socket_set_unix(client, unix_name, err);
+    } else {
+        jfs_ns_socket_set_ip(client, port, "127.0.0.1", err);
     }
+    GOTO_IF_ERR(cleanup);
+    jfs_ns_socket_open(client, err);
+    GOTO_IF_ERR(cleanup);
+    jfs_ns_socket_connect(client, err);
+    GOTO_IF_ERR(cleanup);
+    *server_out = jfs_ns_socket_accept(listener, err);
+    GOTO_IF_ERR(cleanup);
 
-    jfs_tss_allocator_explicit_retire(alloc);
-    jfs_tss_allocator_destroy(alloc);
-
-    stop_time(&time);
-    printf("Total time:\n");
-    print_time(&time);
-    puts("\n");
+    *client_out = client;
+    jfs_ns_socket_destroy(&listener);
+    return;
+cleanup:
+    jfs_ns_socket_destroy(&client);
+    jfs_ns_socket_destroy(&listener);
+    VOID_RETURN_ERR;
 }
 
 void file_walk_test(int verbose_flag, jfs_err_t *err) { // NOLINT
@@ -171,9 +154,12 @@ void file_walk_test(int verbose_flag, jfs_err_t *err) { // NOLINT
     stop_time(&times);
 
     if (verbose_flag) {
-        size_t total_files = 0;
+        jfs_fio_path_buf_t path_buf = {0};
+        size_t             total_files = 0;
         for (size_t i = 0; i < record.dir_count; i++) {
-            printf("%s\n", record.dir_array[i].path.str);
+            jfs_pt_path_buf(&record.paths, record.dir_array[i].path_id, &path_buf, err);
+            GOTO_IF_ERR(cleanup);
+            printf("%s\n", path_buf.data);
             for (size_t j = 0; j < record.dir_array[i].file_count; j++) {
                 printf("    %s\n", record.dir_array[i].files[j].name.str);
             }
@@ -194,6 +180,725 @@ cleanup:
     VOID_RETURN_ERR;
 }
 
+#define BC_TEST_BLOCK 65536
+
+bool bc_round_trip(jfs_bc_ctx_t *ctx, const uint8_t *src, size_t size, uint8_t *dest, jfs_err_t *err) {
+    jfs_bc_block_t block = {0};
+    jfs_bc_encode(ctx, src, size, &block, err);
+    VAL_CHECK_ERR(false);
+
+    const size_t out = jfs_bc_decode(&block, dest, BC_TEST_BLOCK, err);
+    VAL_CHECK_ERR(false);
+    return out == size && memcmp(src, dest, size) == 0;
+}
+
+// the decoder has to turn every one of these down without touching memory past dest
+bool bc_rejects(const uint8_t *data, size_t size, uint32_t raw_size, uint8_t *dest) {
+    jfs_err_t      err = JFS_OK;
+    jfs_bc_block_t block = {.kind = JFS_BC_LZ, .raw_size = raw_size, .size = (uint32_t) size, .data = data};
+    (void) jfs_bc_decode(&block, dest, raw_size, &err);
+    return err == JFS_ERR_BC_CORRUPT;
+}
+
+void block_compress_test(jfs_err_t *err) { // NOLINT
+    jfs_bc_ctx_t ctx = {0};
+    uint8_t     *src = NULL;
+    uint8_t     *dest = NULL;
+    uint8_t     *packed = NULL;
+
+    jfs_bc_ctx_init(&ctx, BC_TEST_BLOCK, err);
+    VOID_CHECK_ERR;
+    src = jfs_malloc(BC_TEST_BLOCK, err);
+    GOTO_IF_ERR(cleanup);
+    dest = jfs_malloc(BC_TEST_BLOCK, err);
+    GOTO_IF_ERR(cleanup);
+    packed = jfs_malloc(jfs_bc_bound(BC_TEST_BLOCK), err);
+    GOTO_IF_ERR(cleanup);
+
+    // zeros, repeating text, noise, a tail shorter than a match and noise with repeats mixed in
+    const size_t size_array[] = {BC_TEST_BLOCK, BC_TEST_BLOCK, BC_TEST_BLOCK, 11, BC_TEST_BLOCK - 7}; // NOLINT
+    uint32_t     seed = 727;                                                                          // NOLINT
+    for (size_t kind = 0; kind < sizeof(size_array) / sizeof(size_array[0]); kind++) {
+        for (size_t i = 0; i < size_array[kind]; i++) {
+            seed = (seed * 1103515245U) + 12345U; // NOLINT
+            switch (kind) {
+                case 0:  src[i] = 0; break;
+                case 1:  src[i] = (uint8_t) "the quick brown fox "[i % 20]; break; // NOLINT
+                case 4:  src[i] = (i / 64) % 2 == 0 ? (uint8_t) (seed >> 24) : src[i % 64]; break; // NOLINT
+                default: src[i] = (uint8_t) (seed >> 24); break;                                   // NOLINT
+            }
+        }
+        const bool same = bc_round_trip(&ctx, src, size_array[kind], dest, err);
+        GOTO_IF_ERR(cleanup);
+        if (!same) GOTO_WITH_ERR(cleanup, JFS_ERR_BC_CORRUPT);
+    }
+
+    // a real compressed block to cut short
+    for (size_t i = 0; i < BC_TEST_BLOCK; i++) {
+        src[i] = (uint8_t) "the quick brown fox "[i % 20]; // NOLINT
+    }
+    jfs_bc_block_t block = {0};
+    jfs_bc_encode(&ctx, src, BC_TEST_BLOCK, &block, err);
+    GOTO_IF_ERR(cleanup);
+    if (block.kind != JFS_BC_LZ) GOTO_WITH_ERR(cleanup, JFS_ERR_BC_CORRUPT);
+    memcpy(packed, block.data, block.size);
+    for (size_t cut = 1; cut < block.size; cut++) {
+        if (!bc_rejects(packed, block.size - cut, BC_TEST_BLOCK, dest)) GOTO_WITH_ERR(cleanup, JFS_ERR_BC_CORRUPT);
+    }
+
+    // literal run longer than the input holds
+    const uint8_t long_literal[] = {0xF0, 255, 255, 255, 10, 'a', 'b'}; // NOLINT
+    if (!bc_rejects(long_literal, sizeof(long_literal), BC_TEST_BLOCK, dest)) GOTO_WITH_ERR(cleanup, JFS_ERR_BC_CORRUPT);
+
+    // match run longer than the output holds
+    const uint8_t long_match[] = {0x1F, 'a', 1, 0, 255, 255, 255, 255, 0}; // NOLINT
+    if (!bc_rejects(long_match, sizeof(long_match), 64, dest)) GOTO_WITH_ERR(cleanup, JFS_ERR_BC_CORRUPT); // NOLINT
+
+    // offset of zero, and an offset reaching back before the start of the output
+    const uint8_t zero_offset[] = {0x10, 'a', 0, 0, 0x00}; // NOLINT
+    if (!bc_rejects(zero_offset, sizeof(zero_offset), 64, dest)) GOTO_WITH_ERR(cleanup, JFS_ERR_BC_CORRUPT); // NOLINT
+    const uint8_t far_offset[] = {0x10, 'a', 2, 0, 0x00}; // NOLINT
+    if (!bc_rejects(far_offset, sizeof(far_offset), 64, dest)) GOTO_WITH_ERR(cleanup, JFS_ERR_BC_CORRUPT); // NOLINT
+
+    // length extension cut off by the end of the input
+    const uint8_t open_length[] = {0xF0, 255}; // NOLINT
+    if (!bc_rejects(open_length, sizeof(open_length), BC_TEST_BLOCK, dest)) GOTO_WITH_ERR(cleanup, JFS_ERR_BC_CORRUPT);
+
+cleanup:
+    free(packed);
+    free(dest);
+    free(src);
+    jfs_bc_ctx_free(&ctx);
+    VOID_CHECK_ERR;
+}
+
+void block_compress_recv_test(jfs_err_t *err) {
+    jfs_bc_ctx_t     ctx = {0};
+    jfs_ns_socket_t *client = NULL;
+    jfs_ns_socket_t *server = NULL;
+    uint8_t         *dest = NULL;
+    uint8_t         *payload = NULL;
+    uint8_t         *small = NULL;
+
+    jfs_bc_ctx_init(&ctx, BC_TEST_BLOCK, err);
+    VOID_CHECK_ERR;
+    test_socket_pair("@jfs-test-bc", 0, &client, &server, err);
+    GOTO_IF_ERR(cleanup);
+    dest = jfs_malloc(BC_TEST_BLOCK, err);
+    GOTO_IF_ERR(cleanup);
+    payload = jfs_malloc(4000, err); // NOLINT
+    GOTO_IF_ERR(cleanup);
+    memset(payload, 'x', 4000); // NOLINT
+    small = jfs_malloc(16, err);    // NOLINT
+    GOTO_IF_ERR(cleanup);
+
+    // a block that round trips over the socket first
+    jfs_bc_send_block(client, &ctx, payload, 4000, err); // NOLINT
+    GOTO_IF_ERR(cleanup);
+    const size_t out = jfs_bc_recv_block(server, &ctx, dest, BC_TEST_BLOCK, err);
+    GOTO_IF_ERR(cleanup);
+    if (out != 4000 || memcmp(dest, payload, out) != 0) GOTO_WITH_ERR(cleanup, JFS_ERR_BC_CORRUPT); // NOLINT
+
+    // a raw block claiming a payload far larger than its raw size has to be turned down before it is received into dest
+    uint8_t              header[JFS_BC_HEADER_SIZE];
+    const jfs_bc_block_t forged = {.kind = JFS_BC_RAW, .raw_size = 16, .size = 4000}; // NOLINT
+    jfs_bc_header_pack(&forged, header);
+    jfs_ns_socket_send(client, header, sizeof(header), MSG_MORE, err);
+    GOTO_IF_ERR(cleanup);
+    jfs_ns_socket_send(client, payload, forged.size, 0, err);
+    GOTO_IF_ERR(cleanup);
+
+    jfs_err_t bad_err = JFS_OK;
+    (void) jfs_bc_recv_block(server, &ctx, small, forged.raw_size, &bad_err);
+    if (bad_err != JFS_ERR_BC_CORRUPT) GOTO_WITH_ERR(cleanup, JFS_ERR_BC_CORRUPT);
+
+cleanup:
+    free(small);
+    free(payload);
+    free(dest);
+    jfs_ns_socket_destroy(&server);
+    jfs_ns_socket_destroy(&client);
+    jfs_bc_ctx_free(&ctx);
+    VOID_CHECK_ERR;
+}
+
+bool wp_varint_rejects(const uint8_t *buf, size_t len) {
+    jfs_err_t err = JFS_OK;
+    uint64_t  val = 0;
+    (void) jfs_wp_varint_get(buf, len, &val, &err);
+    return err == JFS_ERR_WP_BAD_FRAME;
+}
+
+void wire_protocol_test(jfs_err_t *err) { // NOLINT
+    uint8_t buf[JFS_WP_VARINT_MAX + 1];
+
+    // every length boundary, both ends of the range
+    const uint64_t val_array[] = {0, 1, 127, 128, 300, 16383, 16384, (uint64_t) 1 << 35, (uint64_t) 1 << 63, UINT64_MAX - 1, UINT64_MAX}; // NOLINT
+    for (size_t i = 0; i < sizeof(val_array) / sizeof(val_array[0]); i++) {
+        uint64_t     val = 0;
+        const size_t len = jfs_wp_varint_put(buf, val_array[i]);
+        const size_t read = jfs_wp_varint_get(buf, len, &val, err);
+        VOID_CHECK_ERR;
+        VOID_FAIL_IF(read != len || val != val_array[i], JFS_ERR_WP_BAD_FRAME);
+        VOID_FAIL_IF(!wp_varint_rejects(buf, len - 1), JFS_ERR_WP_BAD_FRAME);
+    }
+
+    // a tenth byte above one, and an eleventh byte
+    memset(buf, 0xFF, sizeof(buf)); // NOLINT
+    buf[JFS_WP_VARINT_MAX - 1] = 2;
+    VOID_FAIL_IF(!wp_varint_rejects(buf, JFS_WP_VARINT_MAX), JFS_ERR_WP_BAD_FRAME);
+    buf[JFS_WP_VARINT_MAX - 1] = 0x81; // NOLINT
+    buf[JFS_WP_VARINT_MAX] = 0;
+    VOID_FAIL_IF(!wp_varint_rejects(buf, sizeof(buf)), JFS_ERR_WP_BAD_FRAME);
+
+    // header round trip, then a bad version and a bad type
+    uint8_t               header_buf[JFS_WP_HEADER_SIZE];
+    const jfs_wp_header_t header = {.version = JFS_WP_VERSION, .type = JFS_WP_DATA, .flags = 0xBEEF, .stream_id = 0x01020304, .length = 0xFFFFFFFF}; // NOLINT
+    jfs_wp_header_t       header_out = {0};
+    jfs_wp_header_pack(&header, header_buf);
+    jfs_wp_header_unpack(&header_out, header_buf, err);
+    VOID_CHECK_ERR;
+    VOID_FAIL_IF(memcmp(&header, &header_out, sizeof(header)) != 0, JFS_ERR_WP_BAD_FRAME);
+
+    jfs_err_t bad_err = JFS_OK;
+    header_buf[0] = JFS_WP_VERSION + 1;
+    jfs_wp_header_unpack(&header_out, header_buf, &bad_err);
+    VOID_FAIL_IF(bad_err != JFS_ERR_WP_BAD_FRAME, JFS_ERR_WP_BAD_FRAME);
+    bad_err = JFS_OK;
+    header_buf[0] = JFS_WP_VERSION;
+    header_buf[1] = JFS_WP_WINDOW + 1;
+    jfs_wp_header_unpack(&header_out, header_buf, &bad_err);
+    VOID_FAIL_IF(bad_err != JFS_ERR_WP_BAD_FRAME, JFS_ERR_WP_BAD_FRAME);
+
+    // metadata round trip, then reads past the end and a bytes length past the end
+    jfs_wp_meta_t        meta;
+    jfs_wp_meta_reader_t reader;
+    size_t               size = 0;
+    jfs_wp_meta_init(&meta);
+    jfs_wp_meta_put_uint(&meta, UINT64_MAX, err);
+    VOID_CHECK_ERR;
+    jfs_wp_meta_put_int(&meta, INT64_MIN, err);
+    VOID_CHECK_ERR;
+    jfs_wp_meta_put_int(&meta, -1, err);
+    VOID_CHECK_ERR;
+    jfs_wp_meta_put_int(&meta, INT64_MAX, err);
+    VOID_CHECK_ERR;
+    jfs_wp_meta_put_bytes(&meta, "name", 4, err);
+    VOID_CHECK_ERR;
+
+    jfs_wp_meta_reader_init(&reader, meta.buf, meta.len);
+    VOID_FAIL_IF(jfs_wp_meta_get_uint(&reader, err) != UINT64_MAX, JFS_ERR_WP_BAD_FRAME);
+    VOID_CHECK_ERR;
+    VOID_FAIL_IF(jfs_wp_meta_get_int(&reader, err) != INT64_MIN, JFS_ERR_WP_BAD_FRAME);
+    VOID_CHECK_ERR;
+    VOID_FAIL_IF(jfs_wp_meta_get_int(&reader, err) != -1, JFS_ERR_WP_BAD_FRAME);
+    VOID_CHECK_ERR;
+    VOID_FAIL_IF(jfs_wp_meta_get_int(&reader, err) != INT64_MAX, JFS_ERR_WP_BAD_FRAME);
+    VOID_CHECK_ERR;
+    const uint8_t *bytes = jfs_wp_meta_get_bytes(&reader, &size, err);
+    VOID_CHECK_ERR;
+    VOID_FAIL_IF(size != 4 || memcmp(bytes, "name", 4) != 0 || reader.cursor != meta.len, JFS_ERR_WP_BAD_FRAME);
+
+    bad_err = JFS_OK;
+    (void) jfs_wp_meta_get_uint(&reader, &bad_err);
+    VOID_FAIL_IF(bad_err != JFS_ERR_WP_BAD_FRAME, JFS_ERR_WP_BAD_FRAME);
+    bad_err = JFS_OK;
+    jfs_wp_meta_reader_init(&reader, meta.buf + meta.len - 5, 4); // length prefix says 4, only 3 follow
+    (void) jfs_wp_meta_get_bytes(&reader, &size, &bad_err);
+    VOID_FAIL_IF(bad_err != JFS_ERR_WP_BAD_FRAME, JFS_ERR_WP_BAD_FRAME);
+}
+
+#define MX_TEST_STREAMS  48 // three times max_streams, so every slot is reused
+#define MX_TEST_MAX_OPEN 12
+#define MX_TEST_SIZE     100000
+#define MX_TEST_REPLY    40000
+#define MX_TEST_ROUNDS   100000
+
+typedef struct mx_test mx_test_t;
+
+// the client sends each stream a prefix of src and the server answers every END with MX_TEST_REPLY bytes of it
+struct mx_test {
+    uint8_t       *src;
+    size_t         opened;
+    size_t         ended; // replies the client got in full
+    size_t         done_count;
+    uint32_t       id_array[MX_TEST_STREAMS];
+    size_t         got_array[MX_TEST_STREAMS];
+    size_t         reply_array[MX_TEST_STREAMS];
+    jfs_mx_write_t data_array[MX_TEST_STREAMS];
+    jfs_mx_write_t end_array[MX_TEST_STREAMS];
+    jfs_mx_write_t reply_data_array[MX_TEST_STREAMS];
+    jfs_mx_write_t reply_end_array[MX_TEST_STREAMS];
+    jfs_err_t      err; // first failure seen inside a callback
+};
+
+size_t mx_test_size(size_t index) {
+    return index * 7919 % MX_TEST_SIZE; // NOLINT
+}
+
+size_t mx_test_index(const mx_test_t *test, uint32_t stream_id) {
+    for (size_t i = 0; i < test->opened; i++) {
+        if (test->id_array[i] == stream_id) return i;
+    }
+    return MX_TEST_STREAMS;
+}
+
+// the body has to continue src from where the stream left off
+bool mx_test_check(mx_test_t *test, uint32_t stream_id, const uint8_t *body, size_t len, size_t *got_array) {
+    const size_t index = mx_test_index(test, stream_id);
+    if (index == MX_TEST_STREAMS || got_array[index] + len > MX_TEST_SIZE || memcmp(body, test->src + got_array[index], len) != 0) {
+        if (test->err == JFS_OK) test->err = JFS_ERR_WP_BAD_FRAME;
+        return false;
+    }
+    got_array[index] += len;
+    return true;
+}
+
+void mx_test_server_frame(jfs_mx_t *mx, uint32_t stream_id, jfs_wp_type_t type, const uint8_t *body, size_t len, void *ctx) {
+    mx_test_t *test = (mx_test_t *) ctx;
+    jfs_err_t  err = JFS_OK;
+
+    if (type == JFS_WP_DATA) {
+        if (mx_test_check(test, stream_id, body, len, test->got_array)) jfs_mx_consume(mx, stream_id, len);
+        return;
+    }
+    if (type != JFS_WP_END) return;
+
+    const size_t index = mx_test_index(test, stream_id);
+    if (index == MX_TEST_STREAMS || test->got_array[index] != mx_test_size(index)) {
+        if (test->err == JFS_OK) test->err = JFS_ERR_WP_BAD_FRAME;
+        return;
+    }
+    test->reply_data_array[index] = (jfs_mx_write_t) {.stream_id = stream_id, .type = JFS_WP_DATA, .buf = test->src, .size = MX_TEST_REPLY};
+    test->reply_end_array[index] = (jfs_mx_write_t) {.stream_id = stream_id, .type = JFS_WP_END};
+    jfs_mx_write(mx, &test->reply_data_array[index], &err);
+    if (err == JFS_OK) jfs_mx_write(mx, &test->reply_end_array[index], &err);
+    if (err != JFS_OK && test->err == JFS_OK) test->err = err;
+}
+
+void mx_test_client_frame(jfs_mx_t *mx, uint32_t stream_id, jfs_wp_type_t type, const uint8_t *body, size_t len, void *ctx) {
+    mx_test_t *test = (mx_test_t *) ctx;
+
+    if (type == JFS_WP_DATA) {
+        if (mx_test_check(test, stream_id, body, len, test->reply_array)) jfs_mx_consume(mx, stream_id, len);
+        return;
+    }
+    if (type != JFS_WP_END) return;
+
+    const size_t index = mx_test_index(test, stream_id);
+    if (index == MX_TEST_STREAMS || test->reply_array[index] != MX_TEST_REPLY) {
+        if (test->err == JFS_OK) test->err = JFS_ERR_WP_BAD_FRAME;
+        return;
+    }
+    test->ended += 1;
+}
+
+void mx_test_done(jfs_mx_t *mx, jfs_mx_write_t *write, void *ctx) {
+    (void) mx;
+    (void) write;
+    mx_test_t *test = (mx_test_t *) ctx;
+    test->done_count += 1;
+}
+
+void mx_test_open(mx_test_t *test, jfs_mx_t *client, jfs_err_t *err) {
+    const size_t   index = test->opened;
+    const uint32_t stream_id = jfs_mx_open(client, err);
+    VOID_CHECK_ERR;
+
+    test->id_array[index] = stream_id;
+    test->opened += 1;
+    test->data_array[index] = (jfs_mx_write_t) {.stream_id = stream_id, .type = JFS_WP_DATA, .buf = test->src, .size = mx_test_size(index)};
+    test->end_array[index] = (jfs_mx_write_t) {.stream_id = stream_id, .type = JFS_WP_END};
+    jfs_mx_write(client, &test->data_array[index], err);
+    VOID_CHECK_ERR;
+    jfs_mx_write(client, &test->end_array[index], err);
+    VOID_CHECK_ERR;
+}
+
+void mx_test_pump(jfs_mx_t *mx, const jfs_ns_socket_t *sock, jfs_err_t *err) {
+    jfs_mx_flush(mx, sock, err);
+    if (*err == JFS_ERR_AGAIN) IGNORE_ERR;
+    VOID_CHECK_ERR;
+    jfs_mx_recv(mx, sock, err);
+    if (*err == JFS_ERR_AGAIN) IGNORE_ERR;
+    VOID_CHECK_ERR;
+}
+
+void stream_mux_test(jfs_err_t *err) { // NOLINT
+    mx_test_t       *test = NULL;
+    jfs_mx_t        *client = NULL;
+    jfs_mx_t        *server = NULL;
+    jfs_ns_socket_t *client_sock = NULL;
+    jfs_ns_socket_t *server_sock = NULL;
+
+    test = jfs_malloc(sizeof(*test), err);
+    VOID_CHECK_ERR;
+    memset(test, 0, sizeof(*test));
+    test->src = jfs_malloc(MX_TEST_SIZE, err);
+    GOTO_IF_ERR(cleanup);
+    uint32_t seed = 4242; // NOLINT
+    for (size_t i = 0; i < MX_TEST_SIZE; i++) {
+        seed = (seed * 1103515245U) + 12345U; // NOLINT
+        test->src[i] = (uint8_t) (seed >> 24); // NOLINT
+    }
+
+    test_socket_pair("@jfs-test-mx", 0, &client_sock, &server_sock, err);
+    GOTO_IF_ERR(cleanup);
+    jfs_ns_socket_set_nonblock(client_sock, err);
+    GOTO_IF_ERR(cleanup);
+    jfs_ns_socket_set_nonblock(server_sock, err);
+    GOTO_IF_ERR(cleanup);
+
+    // windows smaller than a stream so credit has to come back, and frame sizes that differ between the ends
+    const jfs_mx_conf_t client_conf = {
+        .client = true, .max_streams = 16, .window = 16384, .frame_size = 4096, .on_frame = mx_test_client_frame, .on_done = mx_test_done, .ctx = test}; // NOLINT
+    const jfs_mx_conf_t server_conf = {.client = false, .max_streams = 16, .window = 16384, .frame_size = 65536, .on_frame = mx_test_server_frame, .ctx = test}; // NOLINT
+    client = jfs_mx_create(&client_conf, err);
+    GOTO_IF_ERR(cleanup);
+    server = jfs_mx_create(&server_conf, err);
+    GOTO_IF_ERR(cleanup);
+
+    for (size_t round = 0; round < MX_TEST_ROUNDS; round++) {
+        while (test->opened < MX_TEST_STREAMS && jfs_mx_stream_count(client) < MX_TEST_MAX_OPEN) {
+            mx_test_open(test, client, err);
+            GOTO_IF_ERR(cleanup);
+        }
+        mx_test_pump(client, client_sock, err);
+        GOTO_IF_ERR(cleanup);
+        mx_test_pump(server, server_sock, err);
+        GOTO_IF_ERR(cleanup);
+        if (test->err != JFS_OK) GOTO_WITH_ERR(cleanup, test->err);
+
+        if (test->ended == MX_TEST_STREAMS && jfs_mx_stream_count(client) == 0 && jfs_mx_stream_count(server) == 0) break;
+    }
+    if (test->ended != MX_TEST_STREAMS || test->done_count != 2 * MX_TEST_STREAMS) GOTO_WITH_ERR(cleanup, JFS_ERR_WP_BAD_FRAME);
+    if (jfs_mx_stream_count(client) != 0 || jfs_mx_stream_count(server) != 0) GOTO_WITH_ERR(cleanup, JFS_ERR_WP_BAD_FRAME);
+
+cleanup:
+    jfs_mx_destroy(server);
+    jfs_mx_destroy(client);
+    jfs_ns_socket_destroy(&server_sock);
+    jfs_ns_socket_destroy(&client_sock);
+    if (test != NULL) free(test->src);
+    free(test);
+    VOID_CHECK_ERR;
+}
+
+#define ZC_TEST_PORT     20741
+#define ZC_TEST_SENDS    100
+#define ZC_TEST_CAPACITY 8 // small enough that the ring wraps and fills
+#define ZC_TEST_SIZE     (64 * 1024)
+
+typedef struct zc_test zc_test_t;
+
+struct zc_test {
+    const jfs_ns_socket_t *sock;
+    const uint8_t         *src;
+    size_t                 done_count;
+    jfs_err_t              err; // of the drain thread
+};
+
+// every other send is below JFS_NS_ZC_MIN_SIZE and takes the copying path
+size_t zc_test_size(size_t index) {
+    return index % 2 == 0 ? ZC_TEST_SIZE : 1000 + index; // NOLINT
+}
+
+void *zc_test_drain(void *arg) {
+    zc_test_t *test = (zc_test_t *) arg;
+    jfs_err_t *err = &test->err;
+    uint8_t   *buf = jfs_malloc(ZC_TEST_SIZE, err);
+    NULL_CHECK_ERR;
+
+    for (size_t i = 0; i < ZC_TEST_SENDS; i++) {
+        jfs_ns_socket_recv(test->sock, buf, zc_test_size(i), err);
+        if (*err != JFS_OK) break;
+        if (memcmp(buf, test->src, zc_test_size(i)) != 0) {
+            *err = JFS_ERR_WP_BAD_FRAME;
+            break;
+        }
+    }
+    free(buf);
+    return NULL;
+}
+
+void zc_test_done(void *ctx) {
+    zc_test_t *test = (zc_test_t *) ctx;
+    test->done_count += 1;
+}
+
+void zerocopy_test(jfs_err_t *err) { // NOLINT
+    zc_test_t        test = {0};
+    jfs_ns_zc_t      zc = {0};
+    jfs_ns_socket_t *client = NULL;
+    jfs_ns_socket_t *server = NULL;
+    uint8_t         *src = NULL;
+    pthread_t        drain;
+    bool             draining = false;
+
+    src = jfs_malloc(ZC_TEST_SIZE, err);
+    VOID_CHECK_ERR;
+    for (size_t i = 0; i < ZC_TEST_SIZE; i++) {
+        src[i] = (uint8_t) (i * 131 >> 3); // NOLINT
+    }
+    test_socket_pair(NULL, ZC_TEST_PORT, &client, &server, err);
+    GOTO_IF_ERR(cleanup);
+    jfs_ns_zc_init(&zc, ZC_TEST_CAPACITY, err);
+    GOTO_IF_ERR(cleanup);
+
+    // without SO_ZEROCOPY every send is copied, done still has to run for each
+    jfs_ns_socket_set_zerocopy(client, &zc, err);
+    if (*err != JFS_OK) IGNORE_ERR;
+
+    test.sock = server;
+    test.src = src;
+    jfs_pthread_create(&drain, NULL, zc_test_drain, &test, err);
+    GOTO_IF_ERR(cleanup);
+    draining = true;
+
+    for (size_t i = 0; i < ZC_TEST_SENDS; i++) {
+        jfs_ns_zc_reap(client, &zc, err);
+        GOTO_IF_ERR(cleanup);
+        if (zc.count == zc.capacity) {
+            jfs_ns_zc_wait(client, &zc, err);
+            GOTO_IF_ERR(cleanup);
+        }
+        const size_t sent = jfs_ns_socket_send_zc(client, &zc, src, zc_test_size(i), zc_test_done, &test, err);
+        GOTO_IF_ERR(cleanup);
+        if (sent != zc_test_size(i)) GOTO_WITH_ERR(cleanup, JFS_ERR_WP_BAD_FRAME);
+    }
+    jfs_ns_zc_wait(client, &zc, err);
+    GOTO_IF_ERR(cleanup);
+
+    pthread_join(drain, NULL);
+    draining = false;
+    if (test.err != JFS_OK) GOTO_WITH_ERR(cleanup, test.err);
+    if (test.done_count != ZC_TEST_SENDS || zc.count != 0) GOTO_WITH_ERR(cleanup, JFS_ERR_WP_BAD_FRAME);
+
+cleanup:
+    // closing the client ends a drain that is still waiting
+    jfs_ns_socket_destroy(&client);
+    if (draining) pthread_join(drain, NULL);
+    jfs_ns_socket_destroy(&server);
+    jfs_ns_zc_free(&zc);
+    free(src);
+    VOID_CHECK_ERR;
+}
+
+#define ST_TEST_PORT      20743
+#define ST_TEST_MAX_CONNS 6
+#define ST_TEST_CHUNK     (1024 * 1024)
+#define ST_TEST_SIZE      ((uint64_t) 48 * 1024 * 1024 + 12345) // not a whole number of chunks
+#define ST_TEST_ID        77
+
+typedef struct st_test      st_test_t;
+typedef struct st_test_conn st_test_conn_t;
+
+struct st_test_conn {
+    st_test_t       *test;
+    jfs_ns_socket_t *sock;
+    pthread_t        thread;
+    jfs_err_t        err;
+};
+
+struct st_test {
+    jfs_ns_socket_t *listener;
+    int              out_fd;
+    atomic_bool      stop;
+    size_t           conn_count;
+    st_test_conn_t   conn_array[ST_TEST_MAX_CONNS];
+    jfs_err_t        err; // of the accept thread
+};
+
+uint8_t st_test_byte(uint64_t offset) {
+    return (uint8_t) ((offset * 2654435761U) >> 13); // NOLINT
+}
+
+void *st_test_recv(void *arg) {
+    st_test_conn_t *conn = (st_test_conn_t *) arg;
+    jfs_err_t      *err = &conn->err;
+    jfs_st_hello_t  hello;
+    jfs_ns_splice_t splice;
+
+    jfs_st_recv_hello(conn->sock, &hello, err);
+    NULL_CHECK_ERR;
+    NULL_FAIL_IF(hello.transfer_id != ST_TEST_ID || hello.size != ST_TEST_SIZE, JFS_ERR_WP_BAD_FRAME);
+    jfs_ns_splice_init(&splice, err);
+    NULL_CHECK_ERR;
+    (void) jfs_st_recv_ranges(conn->sock, &splice, conn->test->out_fd, hello.size, err);
+    jfs_ns_splice_free(&splice);
+    NULL_CHECK_ERR;
+
+    // the sender waits for this end to close before it counts the range as delivered
+    jfs_ns_socket_shutdown(conn->sock, err);
+    NULL_CHECK_ERR;
+    return NULL;
+}
+
+void *st_test_accept(void *arg) {
+    st_test_t *test = (st_test_t *) arg;
+    jfs_err_t *err = &test->err;
+
+    // the listener is nonblocking so the thread notices stop once the transfer is over
+    while (!atomic_load(&test->stop)) {
+        jfs_ns_socket_t *sock = jfs_ns_socket_accept(test->listener, err);
+        if (*err == JFS_ERR_AGAIN) {
+            IGNORE_ERR;
+            struct timespec delay = {.tv_sec = 0, .tv_nsec = 10 * 1000 * 1000}; // NOLINT
+            while (nanosleep(&delay, &delay) == -1 && errno == EINTR) {}
+            continue;
+        }
+        NULL_CHECK_ERR;
+        if (test->conn_count == ST_TEST_MAX_CONNS) {
+            jfs_ns_socket_destroy(&sock);
+            NULL_FAIL_IF(true, JFS_ERR_FULL);
+        }
+
+        st_test_conn_t *conn = &test->conn_array[test->conn_count];
+        *conn = (st_test_conn_t) {.test = test, .sock = sock, .err = JFS_OK};
+        jfs_pthread_create(&conn->thread, NULL, st_test_recv, conn, err);
+        if (*err != JFS_OK) {
+            jfs_ns_socket_destroy(&conn->sock);
+            NULL_RETURN_ERR;
+        }
+        test->conn_count += 1;
+    }
+    return NULL;
+}
+
+void stripe_test(jfs_err_t *err) { // NOLINT
+    st_test_t      test = {.out_fd = -1};
+    jfs_st_stats_t stats = {0};
+    uint8_t       *buf = NULL;
+    uint8_t       *out_buf = NULL;
+    int            in_fd = -1;
+    pthread_t      acceptor;
+    bool           accepting = false;
+
+    atomic_init(&test.stop, false);
+    buf = jfs_malloc(ST_TEST_CHUNK, err);
+    VOID_CHECK_ERR;
+    out_buf = jfs_malloc(ST_TEST_CHUNK, err);
+    GOTO_IF_ERR(cleanup);
+
+    // unnamed files in /tmp, nothing to clean up afterwards
+    in_fd = jfs_open("/tmp", O_TMPFILE | O_RDWR | O_CLOEXEC, 0600, err); // NOLINT
+    GOTO_IF_ERR(cleanup);
+    test.out_fd = jfs_open("/tmp", O_TMPFILE | O_RDWR | O_CLOEXEC, 0600, err); // NOLINT
+    GOTO_IF_ERR(cleanup);
+    for (uint64_t off = 0; off < ST_TEST_SIZE; off += ST_TEST_CHUNK) {
+        const size_t len = ST_TEST_SIZE - off < ST_TEST_CHUNK ? (size_t) (ST_TEST_SIZE - off) : ST_TEST_CHUNK;
+        for (size_t i = 0; i < len; i++) {
+            buf[i] = st_test_byte(off + i);
+        }
+        (void) jfs_fio_pwrite(in_fd, buf, len, (off_t) off, err);
+        GOTO_IF_ERR(cleanup);
+    }
+
+    test.listener = test_listener(NULL, ST_TEST_PORT, err);
+    GOTO_IF_ERR(cleanup);
+    jfs_ns_socket_set_nonblock(test.listener, err);
+    GOTO_IF_ERR(cleanup);
+    jfs_pthread_create(&acceptor, NULL, st_test_accept, &test, err);
+    GOTO_IF_ERR(cleanup);
+    accepting = true;
+
+    // short samples so the connection count moves within the transfer
+    const jfs_st_conf_t conf = {
+        .server_ip = "127.0.0.1",
+        .server_port = ST_TEST_PORT,
+        .file_fd = in_fd,
+        .size = ST_TEST_SIZE,
+        .transfer_id = ST_TEST_ID,
+        .min_conns = 2,
+        .max_conns = ST_TEST_MAX_CONNS,
+        .chunk_size = ST_TEST_CHUNK,
+        .sample_ms = 20, // NOLINT
+    };
+    jfs_st_send(&conf, &stats, err);
+    GOTO_IF_ERR(cleanup);
+
+    atomic_store(&test.stop, true);
+    pthread_join(acceptor, NULL);
+    accepting = false;
+    if (test.err != JFS_OK) GOTO_WITH_ERR(cleanup, test.err);
+    for (size_t i = 0; i < test.conn_count; i++) {
+        pthread_join(test.conn_array[i].thread, NULL);
+        jfs_ns_socket_destroy(&test.conn_array[i].sock);
+        if (test.conn_array[i].err != JFS_OK) GOTO_WITH_ERR(cleanup, test.conn_array[i].err);
+    }
+    test.conn_count = 0;
+    if (stats.sent != ST_TEST_SIZE || stats.conn_count < conf.min_conns || stats.conn_count > conf.max_conns) GOTO_WITH_ERR(cleanup, JFS_ERR_WP_BAD_FRAME);
+
+    for (uint64_t off = 0; off < ST_TEST_SIZE; off += ST_TEST_CHUNK) {
+        const size_t len = ST_TEST_SIZE - off < ST_TEST_CHUNK ? (size_t) (ST_TEST_SIZE - off) : ST_TEST_CHUNK;
+        (void) jfs_fio_pread(in_fd, buf, len, (off_t) off, err);
+        GOTO_IF_ERR(cleanup);
+        (void) jfs_fio_pread(test.out_fd, out_buf, len, (off_t) off, err);
+        GOTO_IF_ERR(cleanup);
+        if (memcmp(buf, out_buf, len) != 0) GOTO_WITH_ERR(cleanup, JFS_ERR_WP_BAD_FRAME);
+    }
+
+cleanup:
+    atomic_store(&test.stop, true);
+    if (accepting) pthread_join(acceptor, NULL);
+    // the sender has closed its ends by now, every receiver is past its last recv
+    for (size_t i = 0; i < test.conn_count; i++) {
+        pthread_join(test.conn_array[i].thread, NULL);
+        jfs_ns_socket_destroy(&test.conn_array[i].sock);
+    }
+    jfs_ns_socket_destroy(&test.listener);
+    if (test.out_fd != -1) close(test.out_fd);
+    if (in_fd != -1) close(in_fd);
+    free(out_buf);
+    free(buf);
+    VOID_CHECK_ERR;
+}
+
+#define RA_TEST_CHUNK 4096
+#define RA_TEST_SIZE  (16 * RA_TEST_CHUNK)
+
+// the consumer holds every pool buffer while the ring is empty, destroy must not wait for one to come back
+void read_ahead_destroy_test(jfs_err_t *err) {
+    jfs_bp_t     *pool = NULL;
+    jfs_ra_t     *ra = NULL;
+    jfs_bp_buf_t *held_array[2] = {NULL, NULL};
+    uint8_t      *buf = NULL;
+    int           fd = -1;
+
+    buf = jfs_malloc(RA_TEST_SIZE, err);
+    VOID_CHECK_ERR;
+    memset(buf, 'r', RA_TEST_SIZE);
+    fd = jfs_open("/tmp", O_TMPFILE | O_RDWR | O_CLOEXEC, 0600, err); // NOLINT
+    GOTO_IF_ERR(cleanup);
+    (void) jfs_fio_pwrite(fd, buf, RA_TEST_SIZE, 0, err);
+    GOTO_IF_ERR(cleanup);
+
+    const jfs_bp_conf_t pool_conf = {.class_count = 1, .size_array = {RA_TEST_CHUNK}, .count_array = {2}};
+    pool = jfs_bp_create(&pool_conf, err);
+    GOTO_IF_ERR(cleanup);
+    const jfs_ra_conf_t ra_conf = {.fd = fd, .offset = 0, .size = RA_TEST_SIZE, .chunk_size = RA_TEST_CHUNK, .depth = 4, .pool = pool}; // NOLINT
+    ra = jfs_ra_create(&ra_conf, err);
+    GOTO_IF_ERR(cleanup);
+
+    for (size_t i = 0; i < 2; i++) {
+        held_array[i] = jfs_ra_next(ra, NULL, err);
+        GOTO_IF_ERR(cleanup);
+    }
+    // give the producer time to block on the empty pool
+    struct timespec delay = {.tv_sec = 0, .tv_nsec = 50 * 1000 * 1000}; // NOLINT
+    while (nanosleep(&delay, &delay) == -1 && errno == EINTR) {}
+
+cleanup:
+    if (ra != NULL) jfs_ra_destroy(ra);
+    for (size_t i = 0; i < 2; i++) {
+        if (held_array[i] != NULL) jfs_bp_release(held_array[i]);
+    }
+    if (pool != NULL) jfs_bp_destroy(pool);
+    if (fd != -1) close(fd);
+    free(buf);
+    VOID_CHECK_ERR;
+}
+
 int main() {
     jfs_err_t err = JFS_OK;
 
@@ -201,8 +906,32 @@ int main() {
     // print_status("file walk", &err);
     // err = JFS_OK;
 
-    tss_test(&err);
-    print_status("tss", &err);
+    block_compress_test(&err);
+    print_status("block compress", &err);
+    err = JFS_OK;
+
+    block_compress_recv_test(&err);
+    print_status("block compress recv", &err);
+    err = JFS_OK;
+
+    wire_protocol_test(&err);
+    print_status("wire protocol", &err);
+    err = JFS_OK;
+
+    stream_mux_test(&err);
+    print_status("stream mux", &err);
+    err = JFS_OK;
+
+    zerocopy_test(&err);
+    print_status("zerocopy", &err);
+    err = JFS_OK;
+
+    stripe_test(&err);
+    print_status("stripe", &err);
+    err = JFS_OK;
+
+    read_ahead_destroy_test(&err);
+    print_status("read ahead destroy", &err);
     err = JFS_OK;
 
     return 0;